@@ -22,6 +22,7 @@ int numberOfPins=PIN_COUNT;
 
 LogicAnalyzer logicAnalyzer;
 Capture capture(MAX_FREQ, MAX_FREQ_THRESHOLD);
+TriggerInterruptGPIO trigger_interrupt;
 TaskHandle_t task;
 
 // when the status is changed to armed we start the capture
@@ -54,6 +55,10 @@ void setup() {
 
     logicAnalyzer.setDescription(DESCRIPTION);
     logicAnalyzer.setCaptureOnArm(false); 
+    // sleep while we wait for a single pin trigger, so that the core is available for WiFi
+    capture.setTriggerInterrupt(trigger_interrupt);
+    // optional: mask the interrupts while sampling, they are re-enabled briefly every ISOLATION_BURST_US
+    // capture.setIsolationPolicy(ISOLATION_BURSTS);
     logicAnalyzer.begin(Serial, &capture, MAX_CAPTURE_SIZE, pinStart, numberOfPins);
 
     // launch the capture handler on core 1
@@ -15,7 +15,7 @@ int numberOfPins=PIN_COUNT;
 LogicAnalyzer logicAnalyzer;
 PicoCapturePIO capture;
 
-// Use Event handler to cancel capturing
+// Use synchronous Event handler to cancel capturing
 void onEvent(Event event) {
     if (event == logic_analyzer::STATUS) {
         switch (logicAnalyzer.status()) {
@@ -32,7 +32,7 @@ void onEvent(Event event) {
 
 /// Generates a test PWM signal
 void activateTestSignal(int testPin, float dutyCyclePercent) {
-    log("Starting PWM test signal with duty %f %", dutyCyclePercent);
+    logDebug("Starting PWM test signal with duty %f %", dutyCyclePercent);
     pinMode(testPin, OUTPUT);
     int value = dutyCyclePercent / 100.0 * 255.0;
     analogWrite(testPin, value);
@@ -50,7 +50,7 @@ void setup() {
 
     //activateTestSignal(pinStart, 90.0);
     logicAnalyzer.setDescription("Raspberry-Pico-PIO");
-    logicAnalyzer.setEventHandler(&onEvent);
+    logicAnalyzer.setSyncEventHandler(&onEvent);
 
     logicAnalyzer.begin(Serial, &capture, MAX_CAPTURE_SIZE, pinStart, numberOfPins);
 }
@@ -46,6 +46,8 @@ void setup() {
 
     logicAnalyzer.setDescription(DESCRIPTION);
     logicAnalyzer.setCaptureOnArm(false);
+    // optional: core 1 only captures, so we could mask the interrupts for the whole capture (at most ISOLATION_MAX_CRITICAL_US)
+    // capture.setIsolationPolicy(ISOLATION_CRITICAL);
     logicAnalyzer.begin(Serial, &capture, MAX_CAPTURE_SIZE, pinStart, numberOfPins);
 
     // launch the capture handler on core 1
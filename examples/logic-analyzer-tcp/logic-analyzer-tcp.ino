@@ -0,0 +1,59 @@
+/**
+ * @file logic-analyzer-tcp.ino
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Arduino Sketch for the sigrok LogicAnalyzer for the ESP32 or ESP8266 which is using the SUMP protocol over TCP:
+ * connect with pulseview --driver=ols:conn=tcp-raw/ip-address/5555
+ */
+
+#if !defined(ESP32) && !defined(ESP8266)
+#error "This sketch is only for the ESP32 or ESP8266"
+#endif
+
+#include "Arduino.h"
+#ifdef ESP32
+#include "WiFi.h"
+#else
+#include "ESP8266WiFi.h"
+#endif
+#include "logic_analyzer.h"
+#include "transport_tcp.h"
+
+using namespace logic_analyzer;  
+
+const char* ssid = "your-ssid";
+const char* password = "your-password";
+int pinStart=START_PIN;
+int numberOfPins=PIN_COUNT;
+
+LogicAnalyzer logicAnalyzer;
+Capture capture(MAX_FREQ, MAX_FREQ_THRESHOLD);
+TCPServerTransport tcp;
+
+void setup() {
+    // setup logger
+    Serial.begin(115200);
+    logicAnalyzer.setLogger(Serial);
+
+    // connect to WiFi
+    WiFi.begin(ssid, password);
+    while (WiFi.status() != WL_CONNECTED){
+        delay(500);
+        Serial.print(".");
+    }
+    Serial.println();
+    Serial.print("Connect to ");
+    Serial.print(WiFi.localIP());
+    Serial.print(":");
+    Serial.println(TRANSPORT_TCP_PORT);
+
+    // start the TCP server
+    tcp.begin(TRANSPORT_TCP_PORT);
+
+    logicAnalyzer.setDescription(DESCRIPTION);
+    logicAnalyzer.begin(tcp, &capture, MAX_CAPTURE_SIZE, pinStart, numberOfPins);
+}
+
+void loop() {
+    logicAnalyzer.processCommand();
+}
@@ -8,13 +8,19 @@
 
 #include "Arduino.h"
 #include "logic_analyzer.h"
+#include "capture_cooperative.h"
 
 using namespace logic_analyzer;  
 
 int pinStart=START_PIN;
 int numberOfPins=PIN_COUNT;
 LogicAnalyzer logicAnalyzer;
+#if defined(AVR) || defined(ESP8266)
+// single core: a RESET is also processed while we wait for the trigger
+CooperativeCapture capture(MAX_FREQ, MAX_FREQ_THRESHOLD);
+#else
 Capture capture(MAX_FREQ, MAX_FREQ_THRESHOLD);
+#endif
 
 // Use Event handler to control the LED
 void onEvent(Event event) {
@@ -0,0 +1,141 @@
+/**
+ * @file atomic_ops.h
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Atomic operations which are shared between the cores (or the interrupts). The RP2040 (Cortex-M0+), the AVR
+ * and the ESP8266 do not have atomic read-modify-write instructions, so the compiler would call the libatomic
+ * functions which are not available (or not safe between the cores): there we use a hardware spinlock or mask the
+ * interrupts.
+ */
+#pragma once
+
+#include "Arduino.h"
+
+#if defined(ARDUINO_ARCH_RP2040)
+#include "hardware/sync.h"
+
+// Hardware spinlock which protects the atomic operations: the striped spinlocks are reserved for short critical sections
+#ifndef ATOMIC_SPINLOCK_ID
+#define ATOMIC_SPINLOCK_ID PICO_SPINLOCK_ID_STRIPED_FIRST
+#endif
+#endif
+
+#if defined(ARDUINO_ARCH_RP2040) || defined(AVR) || defined(ESP8266)
+#define ATOMIC_USE_GUARD 1
+#else
+#define ATOMIC_USE_GUARD 0
+#endif
+
+namespace logic_analyzer {
+
+#if ATOMIC_USE_GUARD
+/**
+ * @brief Critical section for the processors w/o atomic instructions: on the RP2040 we take the hardware spinlock
+ * (which also masks the interrupts of the actual core), otherwise we mask the interrupts.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class AtomicGuard {
+    public:
+#if defined(ARDUINO_ARCH_RP2040)
+        AtomicGuard() {
+            save = spin_lock_blocking(spin_lock_instance(ATOMIC_SPINLOCK_ID));
+        }
+
+        ~AtomicGuard() {
+            spin_unlock(spin_lock_instance(ATOMIC_SPINLOCK_ID), save);
+        }
+
+    protected:
+        uint32_t save;
+#elif defined(AVR)
+        AtomicGuard() {
+            save = SREG;
+            cli();
+        }
+
+        ~AtomicGuard() {
+            SREG = save;
+        }
+
+    protected:
+        uint8_t save;
+#else
+        AtomicGuard() {
+            save = xt_rsil(15);
+        }
+
+        ~AtomicGuard() {
+            xt_wsr_ps(save);
+        }
+
+    protected:
+        uint32_t save;
+#endif
+};
+#endif
+
+/// Reads the value with acquire semantics
+template <typename T>
+inline T atomicLoad(volatile T *ptr) {
+#if ATOMIC_USE_GUARD
+    AtomicGuard guard;
+    return *ptr;
+#else
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+#endif
+}
+
+/// Writes the value with release semantics
+template <typename T>
+inline void atomicStore(volatile T *ptr, T value) {
+#if ATOMIC_USE_GUARD
+    AtomicGuard guard;
+    *ptr = value;
+#else
+    __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+#endif
+}
+
+/// Replaces the value only if it is still the expected one: otherwise expected is updated with the actual value and we return false
+template <typename T>
+inline bool atomicCompareExchange(volatile T *ptr, T &expected, T desired) {
+#if ATOMIC_USE_GUARD
+    AtomicGuard guard;
+    if (*ptr != expected){
+        expected = *ptr;
+        return false;
+    }
+    *ptr = desired;
+    return true;
+#else
+    return __atomic_compare_exchange_n(ptr, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#endif
+}
+
+/// Adds the value and provides the result
+template <typename T>
+inline T atomicAddFetch(volatile T *ptr, T value) {
+#if ATOMIC_USE_GUARD
+    AtomicGuard guard;
+    *ptr = *ptr + value;
+    return *ptr;
+#else
+    return __atomic_add_fetch(ptr, value, __ATOMIC_ACQ_REL);
+#endif
+}
+
+/// Replaces the value and provides the old value
+template <typename T>
+inline T atomicExchange(volatile T *ptr, T value) {
+#if ATOMIC_USE_GUARD
+    AtomicGuard guard;
+    T result = *ptr;
+    *ptr = value;
+    return result;
+#else
+    return __atomic_exchange_n(ptr, value, __ATOMIC_ACQ_REL);
+#endif
+}
+
+} // namespace
@@ -0,0 +1,418 @@
+/**
+ * @file benchmark.h
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Benchmark harness which measures the capturing strategies and the dump throughput with warmup and repeats and
+ * reports the mean and standard deviation as CSV or JSON, so that the results can be compared by a host script.
+ */
+#pragma once
+
+#include "logic_analyzer.h"
+#include <math.h>
+
+// Number of runs which are not measured
+#ifndef BENCHMARK_WARMUP
+#define BENCHMARK_WARMUP 1
+#endif
+
+// Number of measured runs
+#ifndef BENCHMARK_REPEATS
+#define BENCHMARK_REPEATS 5
+#endif
+
+namespace logic_analyzer {
+
+/// Output format of the benchmark results: CSV with a header line or one JSON object per line
+enum BenchmarkFormat : uint8_t {BENCHMARK_CSV, BENCHMARK_JSON};
+
+/**
+ * @brief Mean, standard deviation, min and max of a series of values (Welford's algorithm)
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class RunningStatistics {
+    public:
+        /// Removes all values
+        void clear() {
+            n = 0;
+            mean_value = 0;
+            m2 = 0;
+        }
+
+        /// Adds a value
+        void add(float value) {
+            n++;
+            float delta = value - mean_value;
+            mean_value += delta / n;
+            m2 += delta * (value - mean_value);
+            if (n == 1 || value < min_value) min_value = value;
+            if (n == 1 || value > max_value) max_value = value;
+        }
+
+        /// Number of values
+        uint32_t count() {
+            return n;
+        }
+
+        /// Mean value
+        float mean() {
+            return mean_value;
+        }
+
+        /// Sample standard deviation
+        float stddev() {
+            return n < 2 ? 0.0 : sqrt(m2 / (n - 1));
+        }
+
+        /// Smallest value
+        float min() {
+            return min_value;
+        }
+
+        /// Biggest value
+        float max() {
+            return max_value;
+        }
+
+    protected:
+        uint32_t n = 0;
+        float mean_value = 0;
+        float m2 = 0;
+        float min_value = 0;
+        float max_value = 0;
+};
+
+/**
+ * @brief Result of a single benchmark
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct BenchmarkResult {
+    const char *name = "";
+    uint32_t frequency = 0;
+    uint16_t pins = 0;
+    uint32_t samples = 0;
+    const char *unit = "hz";
+    RunningStatistics values;
+};
+
+/**
+ * @brief Stream which is used as SUMP stream during the benchmarks: it counts the bytes, stops the capturing when the
+ * limit has been reached and optionally forwards the data to an output (e.g. to measure a real link).
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class BenchmarkSink : public Stream {
+    public:
+        /// Forwards the written data to the indicated output: use nullptr to discard the data
+        void setOutput(Print *out) {
+            out_ptr = out;
+        }
+
+        /// Resets the byte count and stops the LogicAnalyzer after the indicated number of bytes (0 = no limit)
+        void begin(uint32_t limit=0, LogicAnalyzer *la=nullptr) {
+            byte_count = 0;
+            byte_limit = limit;
+            la_ptr = la;
+        }
+
+        /// Number of written bytes
+        uint32_t count() {
+            return byte_count;
+        }
+
+        size_t write(uint8_t value) {
+            return write(&value, 1);
+        }
+
+        size_t write(const uint8_t *data, size_t len) {
+            if (out_ptr != nullptr) len = out_ptr->write(data, len);
+            byte_count += len;
+            if (byte_limit > 0 && byte_count >= byte_limit && la_ptr != nullptr){
+                la_ptr->setStatus(STOPPED);
+                byte_limit = 0;
+            }
+            return len;
+        }
+
+        int availableForWrite() {
+            return out_ptr == nullptr ? 1024 : out_ptr->availableForWrite();
+        }
+
+        int available() {
+            return 0;
+        }
+
+        int read() {
+            return -1;
+        }
+
+        int peek() {
+            return -1;
+        }
+
+    protected:
+        Print *out_ptr = nullptr;
+        LogicAnalyzer *la_ptr = nullptr;
+        uint32_t byte_count = 0;
+        uint32_t byte_limit = 0;
+};
+
+/**
+ * @brief Benchmark harness: each benchmark is executed BENCHMARK_WARMUP times w/o measurement and then BENCHMARK_REPEATS
+ * times. The results are written to the output as CSV or JSON. The LogicAnalyzer is started with a BenchmarkSink as
+ * SUMP stream, so the results are not mixed up with the SUMP data.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class Benchmark {
+    public:
+        /// Default Constructor
+        Benchmark(LogicAnalyzer &la, Print &out, BenchmarkFormat format=BENCHMARK_CSV) {
+            la_ptr = &la;
+            out_ptr = &out;
+            this->format = format;
+        }
+
+        /// Defines the number of warmup and measured runs
+        void setRepeats(int warmup, int repeats) {
+            this->warmup = warmup;
+            this->repeats = repeats;
+        }
+
+        /// Defines the label which is reported with the results (e.g. to distinguish the captures)
+        void setLabel(const char *label) {
+            this->label = label;
+        }
+
+        /// Provides the sink which is used as SUMP stream
+        BenchmarkSink &sink() {
+            return benchmark_sink;
+        }
+
+        /// Starts the LogicAnalyzer with the BenchmarkSink and prints the CSV header the first time
+        void begin(AbstractCapture &capture, uint32_t bufferSize, uint8_t pinStart=0, uint8_t numberOfPins=8) {
+            la_ptr->begin(benchmark_sink, &capture, bufferSize, pinStart, numberOfPins);
+            if (format == BENCHMARK_CSV && !is_header_printed){
+                out_ptr->println("label,benchmark,frequency,pins,samples,repeats,mean,stddev,min,max,unit");
+                is_header_printed = true;
+            }
+        }
+
+        /// Measures the effective sampling rate of captureAll() at the requested frequency: this is supported by all captures e.g. also the PicoCapturePIO
+        BenchmarkResult captureAll(AbstractCapture &capture, uint32_t frequency, uint32_t samples) {
+            BenchmarkResult result = create("captureAll", frequency, samples, "hz");
+            for (int j=0; j<warmup+repeats; j++){
+                prepare(frequency, samples);
+                uint32_t start = micros();
+                capture.captureAll();
+                addRate(result, j, la_ptr->available(), micros() - start);
+            }
+            report(result);
+            return result;
+        }
+
+        /// Measures the sampling rate of captureAllMaxSpeed()
+        BenchmarkResult captureAllMaxSpeed(Capture &capture, uint32_t samples) {
+            BenchmarkResult result = create("captureAllMaxSpeed", 0, samples, "hz");
+            for (int j=0; j<warmup+repeats; j++){
+                prepare(la_ptr->captureFrequency(), samples);
+                uint32_t start = micros();
+                capture.captureAllMaxSpeed();
+                addRate(result, j, la_ptr->available(), micros() - start);
+            }
+            report(result);
+            return result;
+        }
+
+        /// Measures the sampling rate of the continuous capture which writes the samples to the sink: use a frequency of 0 for the max speed
+        BenchmarkResult continuous(Capture &capture, uint32_t frequency, uint32_t samples) {
+            BenchmarkResult result = create("continuous", frequency, samples, "hz");
+            la_ptr->setContinuousCapture(true);
+            for (int j=0; j<warmup+repeats; j++){
+                if (frequency > 0) la_ptr->setCaptureFrequency(frequency);
+                la_ptr->setStatus(TRIGGERED);
+                // the encoder has been updated by the status change
+                uint8_t bytes_per_sample = capture.state().sampleEncoder().bytesPerSample();
+                benchmark_sink.begin(samples * bytes_per_sample, la_ptr);
+                uint32_t start = micros();
+                if (frequency > 0){
+                    capture.captureAllContinous();
+                } else {
+                    capture.captureAllContinousMaxSpeed();
+                }
+                addRate(result, j, benchmark_sink.count() / bytes_per_sample, micros() - start);
+            }
+            la_ptr->setContinuousCapture(false);
+            la_ptr->setStatus(STOPPED);
+            report(result);
+            return result;
+        }
+
+        /// Measures the dump throughput in bytes per second for the indicated number of pins: the buffer is filled at max speed
+        BenchmarkResult dump(Capture &capture, uint16_t pins, uint32_t samples) {
+            BenchmarkResult result = create("dump", 0, samples, "bytes/s");
+            result.pins = pins;
+            uint8_t old_groups = la_ptr->channelGroups();
+            la_ptr->setChannelGroups(((1 << ((pins + 7) / 8)) - 1) & 0x0F);
+            for (int j=0; j<warmup+repeats; j++){
+                prepare(la_ptr->captureFrequency(), samples);
+                capture.captureAllMaxSpeed();
+                benchmark_sink.begin();
+                uint32_t start = micros();
+                capture.dump();
+                addRate(result, j, benchmark_sink.count(), micros() - start);
+            }
+            la_ptr->setChannelGroups(old_groups);
+            la_ptr->setStatus(STOPPED);
+            report(result);
+            return result;
+        }
+
+        /// Measures the throughput of the BlockCodec in samples per second for the indicated number of pins: the buffer is
+        /// filled at max speed (e.g. with a test pattern) and only the encoding of the blocks is measured w/o any output
+        BenchmarkResult compression(Capture &capture, BlockCodec &codec, uint16_t pins, uint32_t samples) {
+            BenchmarkResult result = create("compression", 0, samples, "samples/s");
+            result.pins = pins;
+            uint8_t groups = ((1 << ((pins + 7) / 8)) - 1) & 0x0F;
+            for (int j=0; j<warmup+repeats; j++){
+                prepare(la_ptr->captureFrequency(), samples);
+                capture.captureAllMaxSpeed();
+                size_t len = la_ptr->available();
+                const PinBitArray *data = la_ptr->buffer().readPtr(len);
+                size_t pos = 0;
+                size_t block_len;
+                uint32_t start = micros();
+                codec.begin(groups);
+                while (pos < len){
+                    pos += codec.add(data + pos, len - pos);
+                    if (codec.isFull()) codec.encodeBlock(block_len);
+                }
+                if (codec.pending() > 0) codec.encodeBlock(block_len);
+                addRate(result, j, len, micros() - start);
+            }
+            la_ptr->setStatus(STOPPED);
+            report(result);
+            return result;
+        }
+
+        /// Measures the longest interval between the samples of captureAll() in ns and the number of gaps (intervals of at
+        /// least twice the median) for each IsolationPolicy: the gaps of the masked interrupts disappear. We profile every
+        /// sample, so that no gap is missed. The JitterProfiler is removed from the capture at the end
+        void isolation(Capture &capture, JitterProfiler &profiler, uint32_t frequency, uint32_t samples) {
+            static const char *names[] = {"isolation-none", "isolation-bursts", "isolation-critical"};
+            static const char *gap_names[] = {"isolation-none-gaps", "isolation-bursts-gaps", "isolation-critical-gaps"};
+            IsolationPolicy old_policy = capture.isolationPolicy();
+            uint16_t old_stride = profiler.stride();
+            profiler.setStride(1);
+            capture.setJitterProfiler(profiler);
+            for (int policy=ISOLATION_NONE; policy<=ISOLATION_CRITICAL; policy++){
+                BenchmarkResult result = create(names[policy], frequency, samples, "ns");
+                BenchmarkResult gaps = create(gap_names[policy], frequency, samples, "gaps");
+                capture.setIsolationPolicy((IsolationPolicy)policy);
+                for (int j=0; j<warmup+repeats; j++){
+                    prepare(frequency, samples);
+                    capture.captureAll();
+                    if (j < warmup) continue;
+                    result.values.add(JitterProfiler::toNs(profiler.max()));
+                    gaps.values.add(profiler.countAbove(2 * profiler.percentile(50)));
+                }
+                report(result);
+                report(gaps);
+            }
+            capture.clearJitterProfiler();
+            profiler.setStride(old_stride);
+            capture.setIsolationPolicy(old_policy);
+            la_ptr->setStatus(STOPPED);
+        }
+
+        /// Writes the result to the output
+        void report(BenchmarkResult &result) {
+            RunningStatistics &values = result.values;
+            if (format == BENCHMARK_JSON){
+                out_ptr->print("{\"label\":\"");
+                out_ptr->print(label);
+                out_ptr->print("\",\"benchmark\":\"");
+                out_ptr->print(result.name);
+                out_ptr->print("\",\"frequency\":");
+                out_ptr->print((unsigned long)result.frequency);
+                out_ptr->print(",\"pins\":");
+                out_ptr->print((unsigned long)result.pins);
+                out_ptr->print(",\"samples\":");
+                out_ptr->print((unsigned long)result.samples);
+                out_ptr->print(",\"repeats\":");
+                out_ptr->print((unsigned long)values.count());
+                out_ptr->print(",\"mean\":");
+                out_ptr->print(values.mean(), 1);
+                out_ptr->print(",\"stddev\":");
+                out_ptr->print(values.stddev(), 1);
+                out_ptr->print(",\"min\":");
+                out_ptr->print(values.min(), 1);
+                out_ptr->print(",\"max\":");
+                out_ptr->print(values.max(), 1);
+                out_ptr->print(",\"unit\":\"");
+                out_ptr->print(result.unit);
+                out_ptr->println("\"}");
+            } else {
+                out_ptr->print(label);
+                out_ptr->print(",");
+                out_ptr->print(result.name);
+                out_ptr->print(",");
+                out_ptr->print((unsigned long)result.frequency);
+                out_ptr->print(",");
+                out_ptr->print((unsigned long)result.pins);
+                out_ptr->print(",");
+                out_ptr->print((unsigned long)result.samples);
+                out_ptr->print(",");
+                out_ptr->print((unsigned long)values.count());
+                out_ptr->print(",");
+                out_ptr->print(values.mean(), 1);
+                out_ptr->print(",");
+                out_ptr->print(values.stddev(), 1);
+                out_ptr->print(",");
+                out_ptr->print(values.min(), 1);
+                out_ptr->print(",");
+                out_ptr->print(values.max(), 1);
+                out_ptr->print(",");
+                out_ptr->println(result.unit);
+            }
+        }
+
+    protected:
+        LogicAnalyzer *la_ptr = nullptr;
+        Print *out_ptr = nullptr;
+        BenchmarkFormat format = BENCHMARK_CSV;
+        BenchmarkSink benchmark_sink;
+        int warmup = BENCHMARK_WARMUP;
+        int repeats = BENCHMARK_REPEATS;
+        const char *label = "default";
+        bool is_header_printed = false;
+
+        BenchmarkResult create(const char *name, uint32_t frequency, uint32_t samples, const char *unit) {
+            BenchmarkResult result;
+            result.name = name;
+            result.frequency = frequency;
+            result.pins = la_ptr->numberOfPins();
+            result.samples = samples;
+            result.unit = unit;
+            return result;
+        }
+
+        /// clears the buffer and publishes the parameters
+        void prepare(uint32_t frequency, uint32_t samples) {
+            la_ptr->clear();
+            if (frequency > 0) la_ptr->setCaptureFrequency(frequency);
+            la_ptr->setReadCount(samples);
+            la_ptr->setStatus(TRIGGERED);
+        }
+
+        /// records count per second if the run is not a warmup
+        void addRate(BenchmarkResult &result, int run, uint32_t count, uint32_t time_us) {
+            if (run < warmup) return;
+            // very short runs are below the resolution of micros()
+            if (time_us == 0) time_us = 1;
+            result.values.add(1000000.0 * count / time_us);
+        }
+};
+
+} // namespace
@@ -0,0 +1,551 @@
+/**
+ * @file block_codec.h
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Lossless block compression of the samples for streamed and stored captures: each channel is handled as
+ * bit-plane of transitions (XOR of consecutive samples) and the distances between the transitions are Rice coded.
+ * On busy buses each channel toggles at its own rate, so this compresses much better than a run length encoding of
+ * the whole sample.
+ */
+#pragma once
+
+#include "Arduino.h"
+#include "config.h"
+#include "logger.h"
+#include "atomic_ops.h"
+
+// Max number of samples in a block: the encoded block must fit into 64 KB
+#ifndef BLOCK_CODEC_SAMPLES
+#define BLOCK_CODEC_SAMPLES 1024
+#endif
+
+// First byte of each block
+#define BLOCK_CODEC_MAGIC 0xCB
+// magic, channel groups, sample count and payload length
+#define BLOCK_CODEC_HEADER_SIZE 6
+// The channels which are covered by the PinBitArray need at most 2 bits more than the raw bits: the other ones 2 bits
+#define BLOCK_CODEC_MAX_SIZE (BLOCK_CODEC_HEADER_SIZE + 4 + ((BLOCK_CODEC_SAMPLES + 2) * sizeof(PinBitArray) * 8 + 2 * 32 + 7) / 8)
+
+namespace logic_analyzer {
+
+/// Coding of the transitions of a channel in a block
+enum BlockPlaneMode : uint8_t {PLANE_CONST=0, PLANE_RAW=1, PLANE_GAPS=2, PLANE_DELTAS=3};
+
+/// State of the block which has been handed off by the capturing: FULL can be taken by any core, BUSY is being sent
+enum BlockHandOff : uint8_t {HANDOFF_FREE, HANDOFF_FULL, HANDOFF_BUSY};
+
+/**
+ * @brief Writes bit fields (MSB first) into a byte array
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class BitWriter {
+    public:
+        BitWriter(uint8_t *data) {
+            this->data = data;
+        }
+
+        /// Writes the lowest bits (max 16) of the value
+        inline void write(uint32_t value, uint8_t bits) {
+            acc = acc << bits | (value & ((1ul << bits) - 1));
+            acc_bits += bits;
+            while (acc_bits >= 8){
+                acc_bits -= 8;
+                data[byte_pos++] = acc >> acc_bits;
+            }
+        }
+
+        /// Writes value 1 bits followed by a 0 bit
+        inline void writeUnary(uint32_t value) {
+            while (value >= 16){
+                write(0xFFFF, 16);
+                value -= 16;
+            }
+            write(((1ul << value) - 1) << 1, value + 1);
+        }
+
+        /// Rice code: the quotient is written unary followed by the k lowest bits
+        inline void writeRice(uint32_t value, uint8_t k) {
+            writeUnary(value >> k);
+            write(value, k);
+        }
+
+        /// Elias gamma code for values >= 1
+        void writeGamma(uint32_t value) {
+            uint8_t bits = 32 - __builtin_clz(value);
+            write(0, bits - 1);
+            write(value, bits);
+        }
+
+        /// Writes the open bits: returns the number of bytes which have been used
+        size_t size() {
+            if (acc_bits > 0){
+                write(0, 8 - acc_bits);
+            }
+            return byte_pos;
+        }
+
+    protected:
+        uint8_t *data;
+        size_t byte_pos = 0;
+        uint32_t acc = 0;
+        uint8_t acc_bits = 0;
+};
+
+/**
+ * @brief Reads bit fields (MSB first) from a byte array: reading beyond the end provides 0 bits and sets the error flag
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class BitReader {
+    public:
+        BitReader(const uint8_t *data=nullptr, size_t len=0, size_t bitPos=0) {
+            this->data = data;
+            this->bit_len = len * 8;
+            this->bit_pos = bitPos;
+        }
+
+        inline uint32_t read(uint8_t bits) {
+            uint32_t result = 0;
+            while (bits-- > 0){
+                result = result << 1 | bit();
+            }
+            return result;
+        }
+
+        inline uint8_t bit() {
+            if (bit_pos >= bit_len){
+                is_error = true;
+                return 0;
+            }
+            uint8_t result = (data[bit_pos >> 3] >> (7 - (bit_pos & 7))) & 1;
+            bit_pos++;
+            return result;
+        }
+
+        inline uint32_t readRice(uint8_t k) {
+            uint32_t q = 0;
+            while (bit() && !is_error) q++;
+            return q << k | read(k);
+        }
+
+        uint32_t readGamma() {
+            uint8_t zeros = 0;
+            while (!bit() && !is_error && zeros < 32) zeros++;
+            return (1ul << zeros) | read(zeros);
+        }
+
+        void skip(size_t bits) {
+            bit_pos += bits;
+            if (bit_pos > bit_len) is_error = true;
+        }
+
+        size_t position() {
+            return bit_pos;
+        }
+
+        bool isError() {
+            return is_error;
+        }
+
+    protected:
+        const uint8_t *data;
+        size_t bit_len = 0;
+        size_t bit_pos = 0;
+        bool is_error = false;
+};
+
+/**
+ * @brief Block encoder: the samples are collected into blocks of BLOCK_CODEC_SAMPLES. Each block consists of the magic
+ * byte, the channel groups, the 16 bit sample count, the 16 bit payload length (big endian) and the payload: the first
+ * sample in the SUMP wire format followed by the bit stream of each channel (in wire order). A channel starts with 2
+ * mode bits: CONST has no transitions, RAW provides one transition bit per sample, GAPS provides the 4 bit Rice
+ * parameter, the gamma coded number of transitions and the Rice coded number of samples between the transitions and
+ * DELTAS the differences of these numbers, which is very efficient for clocks. We select the shortest coding for each
+ * channel, so a block is never much bigger than the raw data. A block with 0 samples marks the end of the stream.
+ * The samples are collected in a double buffer: handOff() passes a full block to the core which calls claimPending(),
+ * encodePending() and releasePending(), while the capturing fills the other buffer.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class BlockCodec {
+    public:
+        /// Starts a new stream for the enabled channel groups (see SampleEncoder)
+        void begin(uint8_t groups) {
+            groups_value = (groups & 0x0F) == 0 ? 1 : groups & 0x0F;
+            bytes_per_sample = __builtin_popcount(groups_value);
+            plane_count = 0;
+            for (int g=0; g<4; g++){
+                if ((groups_value >> g) & 1){
+                    for (int b=0; b<8; b++){
+                        plane_bits[plane_count++] = g * 8 + b;
+                    }
+                }
+            }
+            block = blocks[0];
+            pending_block = blocks[1];
+            pending_len = 0;
+            handoff_state = HANDOFF_FREE;
+            block_pos = 0;
+            sample_count = 0;
+            byte_count = 0;
+            stall_count = 0;
+        }
+
+        /// Adds a sample to the actual block: returns true if the block is full
+        inline bool add(PinBitArray sample) {
+            block[block_pos++] = sample;
+            return block_pos == BLOCK_CODEC_SAMPLES;
+        }
+
+        /// Adds up to count samples to the actual block: returns the number of added samples
+        size_t add(const PinBitArray *samples, size_t count) {
+            size_t len = BLOCK_CODEC_SAMPLES - block_pos;
+            if (len > count) len = count;
+            memcpy(block + block_pos, samples, len * sizeof(PinBitArray));
+            block_pos += len;
+            return len;
+        }
+
+        /// Returns true if the actual block is full
+        bool isFull() {
+            return block_pos == BLOCK_CODEC_SAMPLES;
+        }
+
+        /// Number of samples in the actual block
+        size_t pending() {
+            return block_pos;
+        }
+
+        /// Encodes the actual block and starts a new one: an empty block is the end marker
+        const uint8_t *encodeBlock(size_t &len) {
+            len = encode(block, block_pos, out);
+            sample_count += block_pos;
+            byte_count += len;
+            block_pos = 0;
+            return out;
+        }
+
+        /// Passes the actual block to the other buffer, which is encoded by encodePending(): returns false w/o any change 
+        /// if the previous block is still pending
+        bool handOff() {
+            if (atomicLoad(&handoff_state) != HANDOFF_FREE) return false;
+            PinBitArray *full = block;
+            block = pending_block;
+            pending_block = full;
+            pending_len = block_pos;
+            block_pos = 0;
+            atomicStore(&handoff_state, (uint8_t) HANDOFF_FULL);
+            return true;
+        }
+
+        /// Takes the pending block for encodePending(): returns false if there is none or if it has already been taken
+        bool claimPending() {
+            uint8_t expected = HANDOFF_FULL;
+            return atomicCompareExchange(&handoff_state, expected, (uint8_t) HANDOFF_BUSY);
+        }
+
+        /// Encodes the claimed block
+        const uint8_t *encodePending(size_t &len) {
+            len = encode(pending_block, pending_len, out);
+            sample_count += pending_len;
+            byte_count += len;
+            return out;
+        }
+
+        /// Frees the claimed block after the encoded data has been sent
+        void releasePending() {
+            atomicStore(&handoff_state, (uint8_t) HANDOFF_FREE);
+        }
+
+        /// Returns true if a block has been handed off and not released yet
+        bool isPending() {
+            return atomicLoad(&handoff_state) != HANDOFF_FREE;
+        }
+
+        /// Records that the capturing had to encode or wait for a pending block
+        void addStall() {
+            stall_count++;
+        }
+
+        /// Number of blocks for which the capturing had to encode or wait for the pending block since begin()
+        uint32_t stallCount() {
+            return stall_count;
+        }
+
+        /// Encodes up to BLOCK_CODEC_SAMPLES samples into result which must provide BLOCK_CODEC_MAX_SIZE bytes: returns the number of bytes
+        size_t encode(const PinBitArray *samples, size_t count, uint8_t *result) {
+            result[0] = BLOCK_CODEC_MAGIC;
+            result[1] = groups_value;
+            result[2] = count >> 8;
+            result[3] = count & 0xFF;
+            size_t len = BLOCK_CODEC_HEADER_SIZE;
+            if (count > 0){
+                uint32_t first = samples[0];
+                for (int g=0; g<4; g++){
+                    if ((groups_value >> g) & 1) result[len++] = first >> (g * 8);
+                }
+                // only the channels with transitions need to be analyzed
+                PinBitArray changed = 0;
+                for (size_t j=1; j<count; j++){
+                    changed |= samples[j] ^ samples[j-1];
+                }
+                BitWriter writer(result + len);
+                for (int p=0; p<plane_count; p++){
+                    uint8_t bit = plane_bits[p];
+                    if (bit >= sizeof(PinBitArray) * 8 || ((changed >> bit) & 1) == 0){
+                        writer.write(PLANE_CONST, 2);
+                    } else {
+                        encodePlane(writer, samples, count, bit);
+                    }
+                }
+                len += writer.size();
+            }
+            uint16_t payload = len - BLOCK_CODEC_HEADER_SIZE;
+            result[4] = payload >> 8;
+            result[5] = payload & 0xFF;
+            return len;
+        }
+
+        /// Enabled channel groups
+        uint8_t groups() {
+            return groups_value;
+        }
+
+        /// Number of bytes of a sample in the SUMP wire format
+        uint8_t bytesPerSample() {
+            return bytes_per_sample;
+        }
+
+        /// Number of encoded samples since begin()
+        uint32_t sampleCount() {
+            return sample_count;
+        }
+
+        /// Number of encoded bytes since begin()
+        uint32_t byteCount() {
+            return byte_count;
+        }
+
+        /// Size of the SUMP wire format divided by the encoded size
+        float ratio() {
+            return byte_count == 0 ? 0.0 : (float) sample_count * bytes_per_sample / byte_count;
+        }
+
+        /// Prints the result to the logger
+        void logResult() {
+            logInfo("block codec: %lu samples / %lu bytes / ratio %.2f", (unsigned long) sample_count, (unsigned long) byte_count, ratio());
+            if (stall_count > 0){
+                logWarning("block codec: the capturing stalled for %lu blocks", (unsigned long) stall_count);
+            }
+        }
+
+    protected:
+        PinBitArray blocks[2][BLOCK_CODEC_SAMPLES];
+        PinBitArray *block = blocks[0];
+        PinBitArray *pending_block = blocks[1];
+        size_t pending_len = 0;
+        volatile uint8_t handoff_state = HANDOFF_FREE;
+        uint32_t stall_count = 0;
+        uint16_t gaps[BLOCK_CODEC_SAMPLES];
+        uint8_t out[BLOCK_CODEC_MAX_SIZE];
+        uint8_t plane_bits[32];
+        uint8_t plane_count = 8;
+        uint8_t groups_value = 1;
+        uint8_t bytes_per_sample = 1;
+        size_t block_pos = 0;
+        uint32_t sample_count = 0;
+        uint32_t byte_count = 0;
+
+        /// selects the shortest coding for the transitions of the channel at the indicated bit
+        void encodePlane(BitWriter &writer, const PinBitArray *samples, size_t count, uint8_t bit) {
+            // number of samples between the transitions
+            size_t n = 0;
+            size_t last = 0;
+            uint32_t sum_gaps = 0;
+            uint32_t sum_deltas = 0;
+            uint16_t prev = 0;
+            for (size_t j=1; j<count; j++){
+                if (((samples[j] ^ samples[j-1]) >> bit) & 1){
+                    uint16_t gap = j - last - 1;
+                    gaps[n++] = gap;
+                    sum_gaps += gap;
+                    sum_deltas += zigzag(gap - prev);
+                    prev = gap;
+                    last = j;
+                }
+            }
+            uint8_t k_gaps = 0, k_deltas = 0;
+            uint32_t cost_gaps = bestRice(n, sum_gaps, false, k_gaps);
+            uint32_t cost_deltas = bestRice(n, sum_deltas, true, k_deltas);
+            uint32_t cost_header = 4 + 2 * (32 - __builtin_clz(n)) - 1;
+            uint32_t cost_raw = count - 1;
+            if (cost_raw <= cost_header + cost_gaps && cost_raw <= cost_header + cost_deltas){
+                writer.write(PLANE_RAW, 2);
+                for (size_t j=1; j<count; j++){
+                    writer.write(((samples[j] ^ samples[j-1]) >> bit) & 1, 1);
+                }
+                return;
+            }
+            bool is_delta = cost_deltas < cost_gaps;
+            uint8_t k = is_delta ? k_deltas : k_gaps;
+            writer.write(is_delta ? PLANE_DELTAS : PLANE_GAPS, 2);
+            writer.write(k, 4);
+            writer.writeGamma(n);
+            prev = 0;
+            for (size_t j=0; j<n; j++){
+                writer.writeRice(is_delta ? zigzag(gaps[j] - prev) : gaps[j], k);
+                prev = gaps[j];
+            }
+        }
+
+        /// determines the bits for the Rice coding of the n values with the best k near the log2 of the mean
+        uint32_t bestRice(size_t n, uint32_t sum, bool isDelta, uint8_t &bestK) {
+            int k0 = 0;
+            while (k0 < 15 && ((uint32_t) n << (k0 + 1)) <= sum) k0++;
+            uint32_t result = 0xFFFFFFFF;
+            for (int k = k0 > 0 ? k0 - 1 : 0; k <= k0 + 1 && k <= 15; k++){
+                uint32_t cost = n * (1 + k);
+                uint16_t prev = 0;
+                for (size_t j=0; j<n && cost<result; j++){
+                    cost += (isDelta ? zigzag(gaps[j] - prev) : gaps[j]) >> k;
+                    prev = gaps[j];
+                }
+                if (cost < result){
+                    result = cost;
+                    bestK = k;
+                }
+            }
+            return result;
+        }
+
+        /// maps the signed difference to an unsigned value: 0, -1, 1, -2, 2 ...
+        static inline uint32_t zigzag(int32_t value) {
+            return value < 0 ? -2 * value - 1 : 2 * value;
+        }
+};
+
+/**
+ * @brief Decodes a block of the BlockCodec into the SUMP wire format: the channels are decoded in parallel, so we
+ * only need the encoded block and a small state for each channel.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class BlockDecoder {
+    public:
+        /// Starts the decoding of the block (header and payload): returns false if it is not valid
+        bool begin(const uint8_t *data, size_t len) {
+            if (len < BLOCK_CODEC_HEADER_SIZE || data[0] != BLOCK_CODEC_MAGIC) return false;
+            uint8_t groups = data[1] & 0x0F;
+            sample_count = data[2] << 8 | data[3];
+            size_t payload = data[4] << 8 | data[5];
+            if (groups == 0 || len < BLOCK_CODEC_HEADER_SIZE + payload) return false;
+            bytes_per_sample = __builtin_popcount(groups);
+            sample_pos = 0;
+            value = 0;
+            if (sample_count == 0) return true;
+            const uint8_t *start = data + BLOCK_CODEC_HEADER_SIZE;
+            for (int b=0; b<bytes_per_sample; b++){
+                value |= (uint32_t) start[b] << (b * 8);
+            }
+            BitReader reader(start, payload, bytes_per_sample * 8);
+            // determine the start of each channel
+            for (int p=0; p<bytes_per_sample * 8; p++){
+                Plane &plane = planes[p];
+                plane.mode = (BlockPlaneMode) reader.read(2);
+                plane.last = 0;
+                plane.prev = 0;
+                plane.remaining = 0;
+                if (plane.mode == PLANE_GAPS || plane.mode == PLANE_DELTAS){
+                    plane.k = reader.read(4);
+                    plane.remaining = reader.readGamma();
+                    if (plane.remaining >= sample_count) return false;
+                }
+                plane.reader = reader;
+                if (plane.mode == PLANE_RAW){
+                    reader.skip(sample_count - 1);
+                } else {
+                    for (uint32_t j=0; j<plane.remaining; j++) reader.readRice(plane.k);
+                }
+                plane.next = nextTransition(plane);
+            }
+            return !reader.isError();
+        }
+
+        /// Number of samples in the block
+        uint16_t sampleCount() {
+            return sample_count;
+        }
+
+        /// Number of bytes of a sample in the SUMP wire format
+        uint8_t bytesPerSample() {
+            return bytes_per_sample;
+        }
+
+        /// Provides the next samples in the SUMP wire format: out must provide samples * bytesPerSample() bytes.
+        /// Returns the number of samples.
+        size_t read(uint8_t *out, size_t samples) {
+            size_t result = 0;
+            while (result < samples && sample_pos < sample_count){
+                for (int p=0; p<bytes_per_sample * 8; p++){
+                    Plane &plane = planes[p];
+                    if (plane.next == sample_pos){
+                        value ^= 1ul << p;
+                        plane.next = nextTransition(plane);
+                    }
+                }
+                for (int b=0; b<bytes_per_sample; b++){
+                    *out++ = value >> (b * 8);
+                }
+                sample_pos++;
+                result++;
+            }
+            return result;
+        }
+
+    protected:
+        struct Plane {
+            BitReader reader;
+            BlockPlaneMode mode = PLANE_CONST;
+            uint8_t k = 0;
+            uint32_t remaining = 0;
+            uint32_t last = 0;
+            uint32_t prev = 0;
+            uint32_t next = 0;
+        };
+        Plane planes[32];
+        uint32_t sample_count = 0;
+        uint32_t sample_pos = 0;
+        uint32_t value = 0;
+        uint8_t bytes_per_sample = 1;
+
+        /// provides the sample index of the next transition or 0xFFFFFFFF
+        uint32_t nextTransition(Plane &plane) {
+            switch(plane.mode){
+                case PLANE_RAW:
+                    while (++plane.last < sample_count){
+                        if (plane.reader.bit()) return plane.last;
+                    }
+                    break;
+                case PLANE_GAPS:
+                case PLANE_DELTAS:
+                    if (plane.remaining > 0){
+                        plane.remaining--;
+                        uint32_t v = plane.reader.readRice(plane.k);
+                        if (plane.mode == PLANE_DELTAS){
+                            // inverse of the zigzag mapping
+                            v = plane.prev + ((v & 1) ? -(int32_t)((v + 1) >> 1) : (int32_t)(v >> 1));
+                        }
+                        plane.prev = v;
+                        plane.last += v + 1;
+                        return plane.last;
+                    }
+                    break;
+                default:
+                    break;
+            }
+            return 0xFFFFFFFF;
+        }
+};
+
+} // namespace
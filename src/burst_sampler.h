@@ -0,0 +1,194 @@
+/**
+ * @file burst_sampler.h
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Cycle exact capturing for fixed sample periods: the samples are captured by fully unrolled blocks where each
+ * sample is padded with the same number of nop instructions, so that we can sample at rates which can't be reached
+ * with delayMicroseconds() and w/o the jitter of the loop overhead.
+ */
+#pragma once
+
+#include "Arduino.h"
+#include "config.h"
+#include "logger.h"
+#include <math.h>
+
+// Number of samples in an unrolled block: the loop branch is executed only once per block
+#ifndef BURST_BLOCK_SIZE
+#define BURST_BLOCK_SIZE 64
+#endif
+
+// Max number of nop instructions per sample: each value generates its own unrolled block
+#ifndef BURST_MAX_PADDING
+#define BURST_MAX_PADDING 15
+#endif
+
+// Number of samples which are used to measure the cycles per sample
+#ifndef BURST_CALIBRATION_SAMPLES
+#define BURST_CALIBRATION_SAMPLES 16384
+#endif
+
+// Max deviation of the effective from the requested frequency in percent
+#ifndef BURST_MAX_DEVIATION_PERCENT
+#define BURST_MAX_DEVIATION_PERCENT 2
+#endif
+
+namespace logic_analyzer {
+
+/// Inserts N nop instructions
+template <int N>
+struct BurstPadding {
+    static inline __attribute__((always_inline)) void run() {
+        __asm__ __volatile__ ("nop");
+        BurstPadding<N - 1>::run();
+    }
+};
+
+template <>
+struct BurstPadding<0> {
+    static inline __attribute__((always_inline)) void run() {}
+};
+
+/// Captures N samples w/o any branch: each sample is followed by PAD nop instructions
+template <int N, int PAD>
+struct BurstBlock {
+    static inline __attribute__((always_inline)) void run(PinReader &reader, PinBitArray *out) {
+        *out = reader.readAll();
+        BurstPadding<PAD>::run();
+        BurstBlock<N - 1, PAD>::run(reader, out + 1);
+    }
+};
+
+template <int PAD>
+struct BurstBlock<0, PAD> {
+    static inline __attribute__((always_inline)) void run(PinReader &, PinBitArray *) {}
+};
+
+/// Captures the indicated number of blocks of BURST_BLOCK_SIZE samples with PAD nop instructions per sample
+template <int PAD>
+void burstCapture(PinReader &reader, PinBitArray *out, size_t blocks) {
+    for (size_t j=0; j<blocks; j++){
+        BurstBlock<BURST_BLOCK_SIZE, PAD>::run(reader, out);
+        out += BURST_BLOCK_SIZE;
+    }
+}
+
+typedef void (*BurstFunction)(PinReader &reader, PinBitArray *out, size_t blocks);
+
+/// Fills the table with the burstCapture functions for the padding of 0 to PAD nop instructions
+template <int PAD>
+struct BurstFunctions {
+    static void fill(BurstFunction *table) {
+        table[PAD] = burstCapture<PAD>;
+        BurstFunctions<PAD - 1>::fill(table);
+    }
+};
+
+template <>
+struct BurstFunctions<0> {
+    static void fill(BurstFunction *table) {
+        table[0] = burstCapture<0>;
+    }
+};
+
+/**
+ * @brief Captures at a fixed number of CPU cycles per sample. The duration of a sample w/o padding and of a single
+ * nop is measured once with the help of cycleCount(), so that we can select the padding which gives the requested
+ * frequency. Only the sample after each block of BURST_BLOCK_SIZE samples is delayed by the loop branch.
+ * The unrolled blocks need some program memory: reduce BURST_MAX_PADDING or BURST_BLOCK_SIZE on small processors.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class BurstSampler {
+    public:
+        /// Default Constructor
+        BurstSampler() {
+            BurstFunctions<BURST_MAX_PADDING>::fill(functions);
+        }
+
+        /// Selects the padding for the requested frequency: returns false if we can't reach it with the max deviation.
+        /// The memory is used for the calibration on the first call.
+        bool begin(PinReader &reader, PinBitArray *memory, size_t size, uint64_t frequency) {
+            if (frequency == 0 || size < BURST_BLOCK_SIZE) return false;
+            if (!is_calibrated) calibrate(reader, memory, size);
+            float period = (float) cycleFrequency() / frequency;
+            int pad = nop_ticks > 0.0 ? (int)((period - sample_ticks) / nop_ticks + 0.5) : 0;
+            if (pad < 0 || pad > BURST_MAX_PADDING) return false;
+            float effective = cycleFrequency() / (sample_ticks + pad * nop_ticks);
+            if (fabs(effective - (float)frequency) > frequency * BURST_MAX_DEVIATION_PERCENT / 100.0) return false;
+            padding_value = pad;
+            frequency_value = effective;
+            logDebug("BurstSampler padding: %d / frequency: %lu", pad, (unsigned long) frequency_value);
+            return true;
+        }
+
+        /// Captures the indicated number of samples with the selected padding: the memory must hold the samples
+        virtual void capture(PinReader &reader, PinBitArray *out, size_t samples) {
+            size_t blocks = samples / BURST_BLOCK_SIZE;
+            size_t rest = samples % BURST_BLOCK_SIZE;
+            functions[padding_value](reader, out, blocks);
+            if (rest > 0){
+                // the last partial block is also captured with the exact timing
+                PinBitArray tmp[BURST_BLOCK_SIZE];
+                functions[padding_value](reader, tmp, 1);
+                memcpy(out + blocks * BURST_BLOCK_SIZE, tmp, rest * sizeof(PinBitArray));
+            }
+        }
+
+        /// Measures the cycleCount() ticks of a sample w/o padding and of a single nop
+        void calibrate(PinReader &reader, PinBitArray *memory, size_t size) {
+            size_t blocks = size / BURST_BLOCK_SIZE;
+            if (blocks == 0) return;
+            size_t repeats = BURST_CALIBRATION_SAMPLES / (blocks * BURST_BLOCK_SIZE) + 1;
+            float samples = (float) repeats * blocks * BURST_BLOCK_SIZE;
+            sample_ticks = measure(functions[0], reader, memory, blocks, repeats) / samples;
+            float padded_ticks = measure(functions[BURST_MAX_PADDING], reader, memory, blocks, repeats) / samples;
+            nop_ticks = (padded_ticks - sample_ticks) / BURST_MAX_PADDING;
+            is_calibrated = true;
+            logDebug("BurstSampler ticks per sample: %f / per nop: %f", sample_ticks, nop_ticks);
+        }
+
+        /// Selected number of nop instructions per sample
+        int padding() {
+            return padding_value;
+        }
+
+        /// Effective sampling frequency in hz
+        uint64_t frequency() {
+            return frequency_value;
+        }
+
+        /// Measured cycleCount() ticks of a sample w/o padding
+        float sampleTicks() {
+            return sample_ticks;
+        }
+
+        /// Measured cycleCount() ticks of a nop
+        float nopTicks() {
+            return nop_ticks;
+        }
+
+    protected:
+        BurstFunction functions[BURST_MAX_PADDING + 1];
+        bool is_calibrated = false;
+        float sample_ticks = 0;
+        float nop_ticks = 0;
+        int padding_value = 0;
+        uint64_t frequency_value = 0;
+
+        /// the fastest of 3 runs, so that we ignore the runs which have been interrupted
+        uint32_t measure(BurstFunction function, PinReader &reader, PinBitArray *memory, size_t blocks, size_t repeats) {
+            uint32_t result = 0xFFFFFFFF;
+            for (int run=0; run<3; run++){
+                uint32_t start = cycleCount();
+                for (size_t j=0; j<repeats; j++){
+                    function(reader, memory, blocks);
+                }
+                uint32_t ticks = cycleCount() - start;
+                if (ticks < result) result = ticks;
+            }
+            return result;
+        }
+};
+
+} // namespace
@@ -0,0 +1,247 @@
+/**
+ * @file capture_cooperative.h
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Non-blocking capturing for single core processors: the samples are captured in short bursts from
+ * processCommand(), so that PulseView can still send commands while we wait for the trigger.
+ */
+#pragma once
+
+#include "logic_analyzer.h"
+
+// Target duration of a single burst of samples in microseconds: this defines the max latency for a RESET or ARM
+#ifndef COOPERATIVE_BURST_TIME_US
+#define COOPERATIVE_BURST_TIME_US 2000
+#endif
+
+// Max number of samples in a single burst
+#ifndef COOPERATIVE_MAX_BURST_SIZE
+#define COOPERATIVE_MAX_BURST_SIZE 8192
+#endif
+
+namespace logic_analyzer {
+
+/**
+ * @brief Capturing for single core processors (e.g. AVR, ESP8266): capture() does not block, but only prepares the
+ * capturing. The samples are captured in bursts by step() which is called by LogicAnalyzer::processCommand(), so the
+ * commands from PulseView (e.g. a RESET while we wait for the trigger) are processed between the bursts.
+ * The burst size is adjusted to the measured sampling speed, so that a burst takes about COOPERATIVE_BURST_TIME_US: 
+ * processing the commands between the bursts then takes less than 1% of the time. Please note that there is a small 
+ * gap in the sampling between the bursts, so keep your loop() short. 
+ * In the flight recorder mode the samples are recorded in bursts while no capture is active.
+ * The decimation (e.g. the noise filter) is supported. The jitter profiling, the timestamped and the segmented 
+ * capturing, the BurstSampler, the IsolationPolicy and the OverrunPolicy are not supported: we log a warning if they 
+ * are requested.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class CooperativeCapture : public Capture {
+    public:
+        /// Default Constructor
+        CooperativeCapture(uint64_t maxCaptureFreq, uint64_t maxCaptureFreqThreshold) : Capture(maxCaptureFreq, maxCaptureFreqThreshold) {
+        }
+
+        /// starts the capturing of the data: the samples are captured by step()
+        virtual void capture() {
+            logDebug("capture");
+            phase = IDLE;
+            if (!loadConfig()){
+                return;
+            }
+            if (config.is_flight_recorder){
+                dumpSnapshot();
+                return;
+            }
+            delay_time_us = isMaxSpeed() ? 0 : config.delay_time_us;
+            is_decimated = config.decimation_mode!=DECIMATION_OFF && !isMaxSpeed() && config.frequecy_value>0;
+            warnUnsupported();
+            burst_size = initialBurstSize();
+            if (config.trigger_mask) {
+                logDebug("waiting for trigger");
+                phase = WAIT_FOR_TRIGGER;
+            } else {
+                startCapture();
+            }
+        }
+
+        /// captures the next burst of samples: returns true if the capturing is still active
+        virtual bool step() {
+            if (phase==IDLE) {
+                // flight recorder mode: record the next burst while no capture is active
+                uint32_t start = cycleCount();
+                updateBurstSize(record(burst_size), cycleCount() - start);
+                return false;
+            }
+            if (isCancelled()){
+                logDebug("cancelled");
+                if (config.is_continuous_capture && (phase==CONTINUOUS || phase==DECIMATING)){
+                    state().endContinuous();
+                }
+                phase = IDLE;
+                return false;
+            }
+            uint32_t start = cycleCount();
+            uint32_t samples = isTestPattern() ? stepBurst(state().testPatternGenerator()) : stepBurst(pinReader());
+            updateBurstSize(samples, cycleCount() - start);
+            return phase!=IDLE;
+        }
+
+        /// Returns true if a capture is in progress
+        bool isActive() {
+            return phase!=IDLE;
+        }
+
+        /// Provides the actual number of samples per burst
+        uint32_t burstSize() {
+            return burst_size;
+        }
+
+    protected:
+        enum Phase : uint8_t {IDLE, WAIT_FOR_TRIGGER, CAPTURING, CONTINUOUS, DECIMATING};
+        Phase phase = IDLE;
+        uint32_t burst_size = 1;
+        unsigned long delay_time_us = 0;
+        bool is_decimated = false;
+        SampleDecimator decimator;
+
+        /// logs a warning for the requested features which are not supported by the cooperative capturing
+        void warnUnsupported() {
+            if (config.segment_count > 1) logWarning("cooperative: segmented capture not supported");
+            if (timestamps_ptr!=nullptr) logWarning("cooperative: timestamped capture not supported");
+            if (jitter_profiler_ptr!=nullptr) logWarning("cooperative: jitter profiling not supported");
+            if (burst_sampler_ptr!=nullptr) logWarning("cooperative: BurstSampler not supported");
+            if (isolation_policy!=ISOLATION_NONE) logWarning("cooperative: IsolationPolicy not supported");
+            if (config.is_continuous_capture && config.overrun_policy!=OVERRUN_CATCH_UP){
+                logWarning("cooperative: OverrunPolicy not supported");
+            }
+        }
+
+        /// determines the number of samples for the first burst from the requested frequency
+        uint32_t initialBurstSize() {
+            uint64_t size = config.frequecy_value * COOPERATIVE_BURST_TIME_US / 1000000;
+            return limit(size);
+        }
+
+        /// adjusts the burst size to the measured time per sample
+        void updateBurstSize(uint32_t samples, uint32_t ticks) {
+            if (samples==0) return;
+            uint64_t target_ticks = (uint64_t) cycleFrequency() * COOPERATIVE_BURST_TIME_US / 1000000;
+            burst_size = limit(ticks==0 ? (uint64_t) burst_size * 2 : target_ticks * samples / ticks);
+        }
+
+        /// limits the burst size to 1 - COOPERATIVE_MAX_BURST_SIZE
+        static uint32_t limit(uint64_t size) {
+            if (size < 1) return 1;
+            if (size > COOPERATIVE_MAX_BURST_SIZE) return COOPERATIVE_MAX_BURST_SIZE;
+            return size;
+        }
+
+        /// changes to the capturing after the trigger
+        void startCapture() {
+            if (!onTriggered()){
+                phase = IDLE;
+                return;
+            }
+            phase = is_decimated ? DECIMATING : config.is_continuous_capture ? CONTINUOUS : CAPTURING;
+            decimator = SampleDecimator(config.decimation_mode);
+        }
+
+        /// processes the next burst of the actual phase with the indicated source of the samples: returns the number of samples
+        template <class Reader>
+        uint32_t stepBurst(Reader &reader) {
+            switch(phase){
+                case WAIT_FOR_TRIGGER:
+                    return stepTrigger(reader);
+                case CAPTURING:
+                    return stepCapture(reader);
+                case CONTINUOUS:
+                    return stepContinuous(reader);
+                case DECIMATING:
+                    return stepDecimated(reader);
+                default:
+                    return 0;
+            }
+        }
+
+        /// waits for the trigger: returns the number of samples
+        template <class Reader>
+        uint32_t stepTrigger(Reader &reader) {
+            for (uint32_t j=0; j<burst_size; j++){
+                if (!((config.trigger_values ^ captureSample(reader)) & config.trigger_mask)){
+                    startCapture();
+                    return j + 1;
+                }
+            }
+            return burst_size;
+        }
+
+        /// captures the next burst into the buffer and dumps the data when we are done: returns the number of samples
+        template <class Reader>
+        uint32_t stepCapture(Reader &reader) {
+            size_t read_count = config.read_count;
+            uint32_t j = 0;
+            while (j<burst_size && buffer().available() < read_count){
+                captureSampleFast(reader);
+                if (delay_time_us>0){
+                    delayMicroseconds(delay_time_us);
+                }
+                j++;
+            }
+            if (buffer().available() >= read_count){
+                phase = IDLE;
+                onCaptured();
+            }
+            return j;
+        }
+
+        /// oversamples at max speed and reduces each output period to a single value: the grid starts again with each 
+        /// burst, so that the gap between the bursts is not caught up. Returns the number of output samples
+        template <class Reader>
+        uint32_t stepDecimated(Reader &reader) {
+            uint32_t frequency = config.frequecy_value;
+            uint32_t period = cycleFrequency() / frequency;
+            uint32_t remainder = cycleFrequency() % frequency;
+            uint32_t error = 0;
+            size_t read_count = config.read_count;
+            bool is_continuous = config.is_continuous_capture;
+            LogicAnalyzerState &source = state();
+            uint32_t next = cycleCount() + period;
+            uint32_t j = 0;
+            while (j<burst_size && (is_continuous || buffer().available() < read_count)){
+                do {
+                    decimator.add(reader.readAll());
+                } while ((int32_t)(cycleCount() - next) < 0);
+                next += period;
+                error += remainder;
+                if (error >= frequency){
+                    error -= frequency;
+                    next++;
+                }
+                if (is_continuous){
+                    source.write(decimator.result());
+                } else {
+                    buffer().write(decimator.result());
+                }
+                j++;
+            }
+            if (!is_continuous && buffer().available() >= read_count){
+                phase = IDLE;
+                onCaptured();
+            }
+            return j;
+        }
+
+        /// writes the next burst to the output stream: returns the number of samples
+        template <class Reader>
+        uint32_t stepContinuous(Reader &reader) {
+            for (uint32_t j=0; j<burst_size; j++){
+                captureSampleFastContinuous(reader);
+                if (delay_time_us>0){
+                    delayMicroseconds(delay_time_us);
+                }
+            }
+            return burst_size;
+        }
+};
+
+} // namespace
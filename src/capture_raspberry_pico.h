@@ -28,20 +28,20 @@ class PicoCapturePIO : public AbstractCapture {
 
         /// starts the capturing of the data
         virtual void capture(){
-            log("capture()");
+            logDebug("capture()");
             start();
             dump();
             // signal end of processing
             setStatus(STOPPED);
 
-            log("Number of samples: %d", n_samples);
-            log("Time in us: %lu", run_time_us);
-            log("Measured capturing frequency in Hz is %f", frequencyMeasured());
+            logDebug("Number of samples: %d", n_samples);
+            logDebug("Time in us: %lu", run_time_us);
+            logDebug("Measured capturing frequency in Hz is %f", frequencyMeasured());
         }
 
         /// cancels the capturing which is ccurrently in progress
         void cancel() {
-            log("cancel()");
+            logDebug("cancel()");
             if (!abort){
                 abort = true;
                 pio_sm_set_enabled(pio,  sm,  false);
@@ -51,7 +51,7 @@ class PicoCapturePIO : public AbstractCapture {
 
         /// Used to test the speed
         virtual void captureAll(){
-            log("captureAll()");
+            logDebug("captureAll()");
             start();
             waitForResult();
         }
@@ -61,19 +61,20 @@ class PicoCapturePIO : public AbstractCapture {
             return run_time_us;
         }
 
-        /// Provides the measured capturing frequency
+        /// Provides the measured capturing frequency: with a trigger we only measure the samples after the first DMA transfer
         float frequencyMeasured(){
-            float measured_freq = run_time_us == 0 ? 0 : 1000000.0 * n_samples  / run_time_us;
+            float measured_freq = run_time_us == 0 ? 0 : 1000000.0 * measured_samples / run_time_us;
             return measured_freq;
         }
 
         float maxFrequency(int warmup=1, int repeat=2) {
-            log("determine maxFrequency");
+            logDebug("determine maxFrequency");
             if (max_frequecy_value<=0.0) {
                 pin_base = logicAnalyzer().startPin();
                 pin_count = logicAnalyzer().numberOfPins();
                 n_samples = logicAnalyzer().readCount();
                 divider_value = 1.0;
+                is_trigger_active = false;
 
                 // warm up
                 for (int j=0;j<warmup;j++){
@@ -90,7 +91,7 @@ class PicoCapturePIO : public AbstractCapture {
                     freqTotal += frequencyMeasured();
                 }
                 max_frequecy_value = freqTotal / repeat;
-                log("maxFrequency: %f", max_frequecy_value);
+                logDebug("maxFrequency: %f", max_frequecy_value);
             }
             return max_frequecy_value;
         }
@@ -108,10 +109,12 @@ class PicoCapturePIO : public AbstractCapture {
         uint pin_base;
         uint pin_count; 
         uint32_t n_samples;
+        uint32_t measured_samples;
         uint32_t n_transfers;
         size_t capture_size_words;
         uint trigger_pin;
         bool trigger_level;
+        bool is_trigger_active = false;
         float divider_value;
         uint64_t frequecy_value;
         float max_frequecy_value = -1.0;  // in hz
@@ -123,13 +126,16 @@ class PicoCapturePIO : public AbstractCapture {
 
         /// starts the processing
         void start() {
-            log("start()");
+            logDebug("start()");
+            // we read the published config only once
+            const CaptureConfig &config = state().armedConfig();
+            state().beginCapture(config);
             // if we are well above the limit we do not capture at all
-            if (logicAnalyzer().captureFrequency() > (1.5 * maxFrequency())){
+            if (config.frequecy_value > (1.5 * maxFrequency())){
                 setStatus(STOPPED);
                 // Send some dummy data to stop pulseview
-                write(0);
-                log("The frequency %u is not supported!", logicAnalyzer().captureFrequency () );
+                state().write(0);
+                logWarning("The frequency %u is not supported!", config.frequecy_value );
                 return;
             }
 
@@ -137,26 +143,40 @@ class PicoCapturePIO : public AbstractCapture {
             abort = false;
             pin_base = logicAnalyzer().startPin();
             pin_count = logicAnalyzer().numberOfPins();
-            n_samples = logicAnalyzer().readCount();
-            divider_value = calculateDivider(logicAnalyzer().captureFrequency());
+            n_samples = config.read_count;
+            divider_value = calculateDivider(config.frequecy_value);
+            setupTrigger(config);
 
             arm();
         }
 
 
+        /// the PIO can wait for the level of a single pin w/o using the processor
+        void setupTrigger(const CaptureConfig &config) {
+            PinBitArray mask = config.trigger_mask;
+            is_trigger_active = mask != 0 && (mask & (mask - 1)) == 0;
+            if (is_trigger_active){
+                trigger_pin = pin_base + __builtin_ctz(mask);
+                trigger_level = (config.trigger_values & mask) != 0;
+                logDebug("trigger pin: %d level: %d", trigger_pin, trigger_level);
+            } else if (mask != 0){
+                logWarning("Only single pin triggers are supported: trigger ignored");
+            }
+        }
+
         /// determines the divider value 
         float calculateDivider(uint32_t frequecy_value_hz){
             // 1.0 => maxCaptureFrequency()
             float result = static_cast<float>(maxFrequency()) / static_cast<float>(frequecy_value_hz) ;
-            log("divider: %f", result);
+            logDebug("divider: %f", result);
             return result < 1.0 ? 1.0 : result;
         }
 
         /// intitialize the PIO
         void arm() {
-            log("arm()");
+            logDebug("arm()");
 
-            log("- Init trigger");
+            logDebug("- Init trigger");
 
             // Grant high bus priority to the DMA, so it can shove the processors out
             // of the way. This should only be needed if you are pushing things up to
@@ -188,7 +208,7 @@ class PicoCapturePIO : public AbstractCapture {
             pio_sm_init(pio, sm, offset, &c);
 
             /// arms the logic analyzer
-            log("- Arming trigger");
+            logDebug("- Arming trigger");
             pio_sm_set_enabled(pio, sm, false);
             // Need to clear _input shift counter_, as well as FIFO, because there may be
             // partial ISR contents left over from a previous run. sm_restart does this.
@@ -209,11 +229,18 @@ class PicoCapturePIO : public AbstractCapture {
                 true                // Start immediately
             );
 
-            /// TODO proper trigger support
-            ///pio_sm_exec(pio, sm, pio_encode_wait_gpio(trigger_level, trigger_pin));
+            // the state machine waits for the trigger before it starts to sample
+            if (is_trigger_active){
+                pio_sm_exec(pio, sm, pio_encode_wait_gpio(trigger_level, trigger_pin));
+            }
 
             run_time_us = 0;
+            measured_samples = n_samples;
             start_time = micros();
+            // w/o trigger the sampling starts immediately: otherwise we record the trigger in waitForResult()
+            if (!is_trigger_active){
+                state().performanceCounters().onTrigger();
+            }
             pio_sm_set_enabled(pio, sm, true);
         }
 
@@ -239,29 +266,44 @@ class PicoCapturePIO : public AbstractCapture {
 
         /// Dumps the result to PuleView (SUMP software)
         void dump() {
-            log("dump()");
+            logDebug("dump()");
             // wait for result an print it
             waitForResult();
             // process result
             if (!abort){
                 size_t count = logicAnalyzer().available();
-                write(logicAnalyzer().buffer().data_ptr(), count);
-                log("dump() - ended with %u records", count);
+                state().write(logicAnalyzer().buffer().data_ptr(), count);
+                state().performanceCounters().onDumpEnd();
+                logDebug("dump() - ended with %u records", count);
             } else {
                 // unblock pulseview
-                write(0);
-                log("dump() - aborted");
+                state().write(0);
+                logDebug("dump() - aborted");
             }
         }
 
+        /// Waits until the PIO has passed the trigger and records the trigger time: the first DMA transfer is done after 
+        /// 32 / pin_count samples, so the time is late by up to 32 sample periods. The time which we waited for the trigger
+        /// is not part of the measured frequency: we measure from the first transfer.
+        void waitForTrigger() {
+            while (!abort && dma_channel_is_busy(dma_chan) && dma_channel_hw_addr(dma_chan)->transfer_count == n_transfers);
+            start_time = micros();
+            measured_samples = n_transfers > 1 ? (n_transfers - 1) * 4 / sizeof(PinBitArray) : 0;
+            state().performanceCounters().onTrigger();
+        }
+
         /// Wait for result and update run_time_us and buffer available
         void waitForResult() {
-            log("waitForResult()");
+            logDebug("waitForResult()");
+            if (is_trigger_active){
+                waitForTrigger();
+            }
             dma_channel_wait_for_finish_blocking(dma_chan);
             run_time_us = micros() - start_time;
             size_t record_count = n_transfers * 4 / sizeof(PinBitArray);
             logicAnalyzer().buffer().setAvailable(abort ? 0 : record_count);
-            log("waitForResult() -> result available with %u records",record_count);
+            state().performanceCounters().onCaptureEnd(abort ? 0 : record_count);
+            logDebug("waitForResult() -> result available with %u records",record_count);
         }
 
 };
@@ -11,6 +11,12 @@
 #define START_PIN 0
 #define PIN_COUNT sizeof(PinBitArray)*8
 #define DESCRIPTION "Arduino-AVR"
+#define LOG_QUEUE_SIZE 8
+// micros() misses the timer overflows if the interrupts are masked for more than 1ms
+#define ISOLATION_MAX_CRITICAL_US 1000
+// the unrolled blocks of the BurstSampler need (BURST_MAX_PADDING + 1) * BURST_BLOCK_SIZE samples of program memory
+#define BURST_BLOCK_SIZE 16
+#define BURST_MAX_PADDING 3
 
 // Software Serial for logging
 #define LOG soft_serial
@@ -30,6 +36,16 @@ void setupLogger() {
 /// Define the datatype for PinBitArray: usually it is a uint8_t, but we could use uint16_t or uint32_t as well.
 typedef uint8_t PinBitArray;
 
+/// There is no cycle counter available, so we use the microseconds for time measurements
+inline uint32_t cycleCount() {
+    return micros();
+}
+
+/// Provides the number of cycleCount() ticks per second
+inline uint32_t cycleFrequency() {
+    return 1000000;
+}
+
 
 /**
  * @brief AVR specific implementation Logic for the PinReader
@@ -16,6 +16,10 @@
 #define START_PIN 19
 #define PIN_COUNT sizeof(PinBitArray)*8
 #define DESCRIPTION "Arduino-ESP32"
+#define CRC32_SLICE_BY_4 1
+// noInterrupts() is empty on the ESP32: the IsolationPolicy masks the interrupts of the capturing core with FreeRTOS
+#define ISOLATION_DISABLE_INTERRUPTS() portDISABLE_INTERRUPTS()
+#define ISOLATION_ENABLE_INTERRUPTS() portENABLE_INTERRUPTS()
 
 
 namespace logic_analyzer {
@@ -24,6 +28,16 @@ namespace logic_analyzer {
 /// Define the datatype for PinBitArray: usually it is a uint8_t, but we could use uint16_t or uint32_t as well.
 typedef uint8_t PinBitArray;
 
+/// Provides the CPU cycle counter which is used for time measurements
+inline uint32_t cycleCount() {
+    return ESP.getCycleCount();
+}
+
+/// Provides the number of cycleCount() ticks per second
+inline uint32_t cycleFrequency() {
+    return ESP.getCpuFreqMHz() * 1000000;
+}
+
 /**
  * @brief ESP32 specific implementation Logic for the PinReader
  * @author Phil Schatzmann
@@ -22,6 +22,16 @@ namespace logic_analyzer {
 /// Define the datatype for PinBitArray: usually it is a uint8_t, but we could use uint16_t or uint32_t as well.
 typedef uint8_t PinBitArray;
 
+/// Provides the CPU cycle counter which is used for time measurements
+inline uint32_t cycleCount() {
+    return ESP.getCycleCount();
+}
+
+/// Provides the number of cycleCount() ticks per second
+inline uint32_t cycleFrequency() {
+    return ESP.getCpuFreqMHz() * 1000000;
+}
+
 
 /**
  * @brief ESP8266 specific implementation Logic for PinReader
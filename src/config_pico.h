@@ -11,6 +11,10 @@
 #ifdef ARDUINO_ARCH_RP2040
 #include "Arduino.h"
 #include <stdarg.h>     /* va_list, va_start, va_arg, va_end */
+#include "hardware/structs/systick.h"
+#include "hardware/clocks.h"
+#include "hardware/timer.h"
+#include "hardware/sync.h"
 
 // processor specific settings
 #define MAX_CAPTURE_SIZE 65535  
@@ -21,12 +25,83 @@
 #define START_PIN 6
 #define PIN_COUNT sizeof(PinBitArray)*8
 #define DESCRIPTION "Arduino-Pico"
+#define CRC32_SLICE_BY_4 1
 
 namespace logic_analyzer {
 
 /// Define the datatype for PinBitArray: usually it is a uint8_t, but we could use uint16_t or uint32_t as well.
 typedef uint8_t PinBitArray;
 
+/**
+ * @brief The Cortex-M0+ has no 32 bit cycle counter, but each core has a 24 bit SysTick which is counting down with the
+ * processor clock. We extend it to 32 bits: the wraps between two calls are added, and if more than half a wrap period
+ * has passed (e.g. while we were waiting for a trigger), the missed wraps are determined with the microsecond timer. 
+ * If the SysTick is already running (e.g. for FreeRTOS), we keep its reload value: it must use the processor clock.
+ * The state is kept per core and is not protected, so cycleCount() must not be called from an interrupt handler.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class SysTickCounter {
+    public:
+        /// Provides the processor cycles since the first call as 32 bit value
+        inline uint32_t count() {
+            if (!is_active) begin();
+            uint32_t value = systick_hw->cvr;
+            uint32_t us = time_us_32();
+            uint32_t delta = last_value >= value ? last_value - value : last_value + reload - value;
+            uint32_t elapsed_us = us - last_us;
+            if (elapsed_us >= wrap_us){
+                // we might have missed some wraps: the timer tells us how many
+                int64_t missing = (int64_t) elapsed_us * cycles_per_us - delta;
+                delta += (uint32_t)(((missing + reload / 2) / reload) * reload);
+            }
+            last_value = value;
+            last_us = us;
+            count_value += delta;
+            return count_value;
+        }
+
+    protected:
+        bool is_active = false;
+        uint32_t reload = 0x1000000;
+        uint32_t cycles_per_us = 1;
+        uint32_t wrap_us = 1;
+        uint32_t last_value = 0;
+        uint32_t last_us = 0;
+        uint32_t count_value = 0;
+
+        void begin() {
+            if ((systick_hw->csr & M0PLUS_SYST_CSR_ENABLE_BITS) == 0){
+                systick_hw->rvr = 0xFFFFFF;
+                systick_hw->cvr = 0;
+                systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+            }
+            reload = (systick_hw->rvr & 0xFFFFFF) + 1;
+            cycles_per_us = clock_get_hz(clk_sys) / 1000000;
+            wrap_us = reload / cycles_per_us / 2;
+            if (wrap_us == 0) wrap_us = 1;
+            last_value = systick_hw->cvr;
+            last_us = time_us_32();
+            is_active = true;
+        }
+};
+
+/// Provides the SysTickCounter of the actual core: each core has its own SysTick
+inline SysTickCounter &sysTickCounter() {
+    static SysTickCounter counters[2];
+    return counters[get_core_num()];
+}
+
+/// Provides the processor cycles of the actual core (see SysTickCounter)
+inline uint32_t cycleCount() {
+    return sysTickCounter().count();
+}
+
+/// Provides the number of cycleCount() ticks per second
+inline uint32_t cycleFrequency() {
+    return clock_get_hz(clk_sys);
+}
+
 /**
  * @brief Pico specific implementation Logic for the PinReader
  * @author Phil Schatzmann
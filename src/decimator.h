@@ -0,0 +1,106 @@
+/**
+ * @file decimator.h
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Reduction of the samples which are oversampled at max speed to one value per output period, so that short
+ * glitches are not lost at low sampling rates.
+ */
+#pragma once
+
+#include "Arduino.h"
+#include "config.h"
+
+// Number of bit sliced counters: supports up to 2^DECIMATOR_COUNTER_BITS - 1 samples per output period
+#ifndef DECIMATOR_COUNTER_BITS
+#define DECIMATOR_COUNTER_BITS 16
+#endif
+
+namespace logic_analyzer {
+
+/// Reduction of the oversampled values: MAJORITY is the noise filter, GLITCH makes any transition in the period visible
+enum DecimationMode : uint8_t {DECIMATION_OFF, DECIMATION_MAJORITY, DECIMATION_GLITCH};
+
+/**
+ * @brief Reduces all samples of an output period to a single value. For the majority vote we count the high samples
+ * of all channels in parallel with bit sliced counters, so that we need only a few operations per sample. In the
+ * glitch mode a channel which had any transition in the period is inverted compared to the last output value.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class SampleDecimator {
+    public:
+        /// Default Constructor
+        SampleDecimator(DecimationMode mode=DECIMATION_MAJORITY) {
+            this->mode = mode;
+            clear();
+        }
+
+        /// Adds an oversampled value
+        inline void add(PinBitArray sample) {
+            and_value &= sample;
+            or_value |= sample;
+            if (mode==DECIMATION_MAJORITY && count < MAX_COUNT){
+                // add 1 for each high channel to the bit sliced counters
+                PinBitArray carry = sample;
+                for (int k=0; carry!=0 && k<DECIMATOR_COUNTER_BITS; k++){
+                    PinBitArray tmp = counters[k] & carry;
+                    counters[k] ^= carry;
+                    carry = tmp;
+                }
+            }
+            count++;
+        }
+
+        /// Provides the reduced value of the actual period and starts a new period
+        PinBitArray result() {
+            PinBitArray value;
+            if (mode==DECIMATION_GLITCH){
+                PinBitArray changed = and_value ^ or_value;
+                value = (or_value & ~changed) | (~last_value & changed);
+            } else {
+                value = majority();
+            }
+            last_value = value;
+            clear();
+            return value;
+        }
+
+        /// Number of samples in the actual period
+        uint32_t size() {
+            return count;
+        }
+
+    protected:
+        static const uint32_t MAX_COUNT = (1ul << DECIMATOR_COUNTER_BITS) - 1;
+        DecimationMode mode;
+        PinBitArray counters[DECIMATOR_COUNTER_BITS];
+        PinBitArray and_value;
+        PinBitArray or_value;
+        PinBitArray last_value = 0;
+        uint32_t count;
+
+        void clear() {
+            memset(counters, 0, sizeof(counters));
+            and_value = ~0;
+            or_value = 0;
+            count = 0;
+        }
+
+        /// determines the channels which were high in more than half of the samples
+        PinBitArray majority() {
+            // all samples were identical
+            if (and_value == or_value) return or_value;
+            uint32_t total = count < MAX_COUNT ? count : MAX_COUNT;
+            PinBitArray result = 0;
+            for (int ch=0; ch<(int)sizeof(PinBitArray)*8; ch++){
+                uint32_t high = 0;
+                for (int k=0; k<DECIMATOR_COUNTER_BITS; k++){
+                    high |= (uint32_t)((counters[k] >> ch) & 1) << k;
+                }
+                if (high * 2 > total) result |= (PinBitArray)1 << ch;
+            }
+            return result;
+        }
+};
+
+} // namespace
@@ -0,0 +1,361 @@
+/**
+ * @file decoder.h
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Protocol decoders (UART, SPI, I2C) which are running on the device: instead of the raw samples we only send
+ * compact frames with the decoded values, which reduces the required bandwidth dramatically.
+ */
+#pragma once
+
+#include "Arduino.h"
+#include "config.h"
+#include "network.h"
+#include "logger.h"
+
+// Number of samples which are collected in continuous mode before they are passed to the decoder and the statistics
+#ifndef DECODER_BLOCK_SIZE
+#define DECODER_BLOCK_SIZE 32
+#endif
+
+namespace logic_analyzer {
+
+/// Types of the decoded frames
+enum FrameType : uint8_t {FRAME_DATA=1, FRAME_ERROR=2, FRAME_START=3, FRAME_STOP=4, FRAME_ADDRESS=5, FRAME_ACK=6, FRAME_NACK=7, FRAME_MISO=8};
+
+/**
+ * @brief A decoded frame: it is sent as 6 bytes: type, value and the timestamp as big endian uint32_t. The timestamp
+ * is the sample number (since the ARM) where the frame has started.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct DecodedFrame {
+    uint8_t type;
+    uint8_t value;
+    uint32_t timestamp;
+};
+
+/**
+ * @brief Abstract Decoder: it consumes blocks of samples and writes the decoded frames to the output Stream. The
+ * channels are the bit positions in the PinBitArray.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class Decoder {
+    public:
+        /// Destructor
+        virtual ~Decoder() {
+        }
+
+        /// Defines the output Stream for the frames
+        void setOutput(Stream &out) {
+            out_ptr = &out;
+        }
+
+        /// Returns true if the output Stream has been defined
+        bool hasOutput() {
+            return out_ptr!=nullptr;
+        }
+
+        /// Resets the state and the sample number: called when the capture is armed
+        virtual void reset() {
+            sample_pos = 0;
+            frame_count = 0;
+        }
+
+        /// Decodes a block of samples
+        virtual void decode(const PinBitArray *samples, size_t count) = 0;
+
+        /// Number of frames since the last reset
+        uint32_t frameCount() {
+            return frame_count;
+        }
+
+    protected:
+        Stream *out_ptr = nullptr;
+        uint32_t sample_pos = 0;
+        uint32_t frame_count = 0;
+
+        /// Called for each decoded frame: writes the frame to the output Stream
+        virtual void onFrame(const DecodedFrame &frame) {
+            if (out_ptr==nullptr) return;
+            uint8_t data[6];
+            data[0] = frame.type;
+            data[1] = frame.value;
+            uint32_t timestamp = htonl(frame.timestamp);
+            memcpy(data + 2, &timestamp, sizeof(uint32_t));
+            out_ptr->write(data, sizeof(data));
+        }
+
+        /// Creates a frame and reports it
+        void emit(FrameType type, uint8_t value, uint32_t timestamp) {
+            DecodedFrame frame;
+            frame.type = type;
+            frame.value = value;
+            frame.timestamp = timestamp;
+            frame_count++;
+            onFrame(frame);
+        }
+};
+
+/**
+ * @brief UART Decoder (idle high, 1 start bit, 5-8 data bits LSB first, 1 stop bit). The bit time is defined in samples
+ * and we use 1/256 sample resolution, so any oversampling ratio >= 3 can be used. We emit FRAME_DATA or FRAME_ERROR
+ * if the stop bit is invalid.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class UARTDecoder : public Decoder {
+    public:
+        /// Default Constructor: the samplesPerBit is the capture frequency / baud rate
+        UARTDecoder(uint8_t channel=0, float samplesPerBit=8.0, uint8_t dataBits=8) {
+            begin(channel, samplesPerBit, dataBits);
+        }
+
+        /// Defines the parameters
+        void begin(uint8_t channel, float samplesPerBit, uint8_t dataBits=8) {
+            mask = 1 << channel;
+            bit_time = samplesPerBit * 256;
+            data_bits = dataBits;
+            reset();
+        }
+
+        /// Resets the state and the sample number
+        void reset() {
+            Decoder::reset();
+            state = IDLE;
+        }
+
+        /// Decodes a block of samples
+        void decode(const PinBitArray *samples, size_t count) {
+            for (size_t j=0; j<count; j++){
+                decodeSample(samples[j]);
+            }
+        }
+
+    protected:
+        enum State : uint8_t {IDLE, START, DATA, STOP};
+        State state = IDLE;
+        PinBitArray mask = 1;
+        int32_t bit_time = 8 * 256;
+        int32_t countdown = 0;
+        uint8_t data_bits = 8;
+        uint8_t bit_count = 0;
+        uint8_t value = 0;
+        uint32_t start_pos = 0;
+
+        inline void decodeSample(PinBitArray sample) {
+            uint32_t pos = sample_pos++;
+            bool bit = sample & mask;
+            if (state==IDLE){
+                if (!bit){
+                    // falling edge of the start bit: we sample in the middle of the bits
+                    state = START;
+                    start_pos = pos;
+                    countdown = bit_time / 2;
+                }
+                return;
+            }
+            countdown -= 256;
+            if (countdown > 0) return;
+            countdown += bit_time;
+            switch(state){
+                case START:
+                    // a glitch is not a start bit
+                    state = bit ? IDLE : DATA;
+                    bit_count = 0;
+                    value = 0;
+                    break;
+                case DATA:
+                    value |= bit << bit_count;
+                    if (++bit_count==data_bits) state = STOP;
+                    break;
+                case STOP:
+                    emit(bit ? FRAME_DATA : FRAME_ERROR, value, start_pos);
+                    state = IDLE;
+                    break;
+                default:
+                    break;
+            }
+        }
+};
+
+/**
+ * @brief SPI Decoder (MSB first): emits FRAME_DATA with the MOSI and FRAME_MISO with the MISO value of each byte. If a
+ * chip select channel is defined, FRAME_START and FRAME_STOP are emitted and bits are only sampled while CS is low.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class SPIDecoder : public Decoder {
+    public:
+        /// Default Constructor: use -1 for the channels which are not used
+        SPIDecoder(int clk=0, int mosi=1, int miso=-1, int cs=-1, uint8_t mode=0) {
+            begin(clk, mosi, miso, cs, mode);
+        }
+
+        /// Defines the channels and the SPI mode (0-3)
+        void begin(int clk, int mosi, int miso=-1, int cs=-1, uint8_t mode=0) {
+            clk_bit = clk;
+            mosi_mask = mosi < 0 ? 0 : 1 << mosi;
+            miso_mask = miso < 0 ? 0 : 1 << miso;
+            cs_mask = cs < 0 ? 0 : 1 << cs;
+            // index prev clk << 1 | clk: the data is sampled on the rising edge in mode 0 and 3
+            cpol = (mode & 2) != 0;
+            bool cpha = mode & 1;
+            sample_edge = cpol == cpha ? 0b01 : 0b10;
+            reset();
+        }
+
+        /// Resets the state and the sample number
+        void reset() {
+            Decoder::reset();
+            bit_count = 0;
+            // the clock starts at the idle level, so that the first sample is not an edge
+            prev_clk = cpol;
+            is_selected = cs_mask == 0;
+        }
+
+        /// Decodes a block of samples
+        void decode(const PinBitArray *samples, size_t count) {
+            for (size_t j=0; j<count; j++){
+                decodeSample(samples[j]);
+            }
+        }
+
+    protected:
+        uint8_t clk_bit = 0;
+        PinBitArray mosi_mask = 0;
+        PinBitArray miso_mask = 0;
+        PinBitArray cs_mask = 0;
+        uint8_t sample_edge = 0b01;
+        uint8_t cpol = 0;
+        uint8_t prev_clk = 0;
+        uint8_t bit_count = 0;
+        uint8_t mosi_value = 0;
+        uint8_t miso_value = 0;
+        uint32_t start_pos = 0;
+        bool is_selected = true;
+
+        inline void decodeSample(PinBitArray sample) {
+            uint32_t pos = sample_pos++;
+            if (cs_mask && (bool)(sample & cs_mask) == is_selected){
+                // chip select has changed
+                is_selected = !is_selected;
+                emit(is_selected ? FRAME_START : FRAME_STOP, 0, pos);
+                bit_count = 0;
+            }
+            uint8_t clk = (sample >> clk_bit) & 1;
+            uint8_t edge = prev_clk << 1 | clk;
+            prev_clk = clk;
+            if (edge!=sample_edge || !is_selected) return;
+            if (bit_count==0) start_pos = pos;
+            mosi_value = mosi_value << 1 | ((sample & mosi_mask) != 0);
+            miso_value = miso_value << 1 | ((sample & miso_mask) != 0);
+            if (++bit_count==8){
+                if (mosi_mask) emit(FRAME_DATA, mosi_value, start_pos);
+                if (miso_mask) emit(FRAME_MISO, miso_value, start_pos);
+                bit_count = 0;
+            }
+        }
+};
+
+/**
+ * @brief I2C Decoder: emits FRAME_START, FRAME_ADDRESS (address with the R/W bit), FRAME_DATA, FRAME_ACK or
+ * FRAME_NACK and FRAME_STOP. The bus events are determined with a lookup table from the previous and the actual SCL/SDA
+ * levels, so that we need only one table lookup for each sample.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class I2CDecoder : public Decoder {
+    public:
+        /// Default Constructor
+        I2CDecoder(uint8_t scl=0, uint8_t sda=1) {
+            begin(scl, sda);
+        }
+
+        /// Defines the channels
+        void begin(uint8_t scl, uint8_t sda) {
+            scl_bit = scl;
+            sda_bit = sda;
+            reset();
+        }
+
+        /// Resets the state and the sample number
+        void reset() {
+            Decoder::reset();
+            state = IDLE;
+            prev_lines = 0b11;
+        }
+
+        /// Decodes a block of samples
+        void decode(const PinBitArray *samples, size_t count) {
+            for (size_t j=0; j<count; j++){
+                decodeSample(samples[j]);
+            }
+        }
+
+    protected:
+        enum Event : uint8_t {NONE, START, STOP, BIT0, BIT1};
+        enum State : uint8_t {IDLE, ADDRESS, DATA};
+        State state = IDLE;
+        uint8_t scl_bit = 0;
+        uint8_t sda_bit = 1;
+        uint8_t prev_lines = 0b11;
+        uint8_t bit_count = 0;
+        uint8_t value = 0;
+        uint32_t start_pos = 0;
+
+        /// bus event for the index prev SCL, prev SDA, SCL, SDA
+        static uint8_t event(uint8_t idx) {
+            static const uint8_t events[16] = {
+                NONE, NONE, BIT0, BIT1,   // SCL low, SDA low ->
+                NONE, NONE, BIT0, BIT1,   // SCL low, SDA high ->
+                NONE, NONE, NONE, STOP,   // SCL high, SDA low ->
+                NONE, NONE, START, NONE,  // SCL high, SDA high ->
+            };
+            return events[idx];
+        }
+
+        inline void decodeSample(PinBitArray sample) {
+            uint32_t pos = sample_pos++;
+            uint8_t lines = ((sample >> scl_bit) & 1) << 1 | ((sample >> sda_bit) & 1);
+            uint8_t ev = event(prev_lines << 2 | lines);
+            prev_lines = lines;
+            if (ev!=NONE){
+                onEvent(ev, pos);
+            }
+        }
+
+        void onEvent(uint8_t ev, uint32_t pos) {
+            switch(ev){
+                case START:
+                    emit(FRAME_START, 0, pos);
+                    state = ADDRESS;
+                    bit_count = 0;
+                    value = 0;
+                    break;
+                case STOP:
+                    emit(FRAME_STOP, 0, pos);
+                    state = IDLE;
+                    break;
+                default:
+                    if (state==IDLE) return;
+                    bool bit = ev==BIT1;
+                    if (bit_count==0) start_pos = pos;
+                    if (bit_count<8){
+                        value = value << 1 | bit;
+                    } else {
+                        // 9th bit: acknowledge
+                        emit(state==ADDRESS ? FRAME_ADDRESS : FRAME_DATA, value, start_pos);
+                        emit(bit ? FRAME_NACK : FRAME_ACK, 0, pos);
+                        state = DATA;
+                        bit_count = 0;
+                        value = 0;
+                        return;
+                    }
+                    bit_count++;
+                    break;
+            }
+        }
+};
+
+} // namespace
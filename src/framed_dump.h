@@ -0,0 +1,254 @@
+/**
+ * @file framed_dump.h
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Framed dump for fast but unreliable links: the SUMP data is split into blocks which are sent as frames with a
+ * sequence number and a CRC32, so that the host can request the corrupted blocks again from the still resident buffer.
+ */
+#pragma once
+
+#include "Arduino.h"
+#include "config.h"
+#include "sample_encoder.h"
+
+// Max number of SUMP data bytes in a frame
+#ifndef FRAMED_BLOCK_SIZE
+#define FRAMED_BLOCK_SIZE 256
+#endif
+
+// Use the slice-by-4 CRC32 which is faster but needs 4 KB instead of 1 KB for the tables
+#ifndef CRC32_SLICE_BY_4
+#define CRC32_SLICE_BY_4 0
+#endif
+
+// First byte of each frame
+#define FRAMED_MAGIC 0xF5
+// magic, sequence number and payload length
+#define FRAMED_HEADER_SIZE 5
+#define FRAMED_CRC_SIZE 4
+
+namespace logic_analyzer {
+
+/**
+ * @brief Table driven CRC32 (IEEE 802.3, the same as zlib.crc32() in python)
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class CRC32 {
+    public:
+        /// Updates the crc with the indicated data: start with 0
+        static uint32_t update(uint32_t crc, const uint8_t *data, size_t len) {
+            const uint32_t *t = table();
+            crc = ~crc;
+#if CRC32_SLICE_BY_4
+            while (len >= 4){
+                crc ^= (uint32_t)data[0] | (uint32_t)data[1] << 8 | (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24;
+                crc = t[768 + (crc & 0xFF)] ^ t[512 + ((crc >> 8) & 0xFF)] ^ t[256 + ((crc >> 16) & 0xFF)] ^ t[crc >> 24];
+                data += 4;
+                len -= 4;
+            }
+#endif
+            while (len--){
+                crc = t[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+            }
+            return ~crc;
+        }
+
+    protected:
+        /// the tables are calculated on the first use
+        static const uint32_t *table() {
+            static uint32_t values[CRC32_SLICE_BY_4 ? 1024 : 256];
+            static bool is_initialized = false;
+            if (!is_initialized){
+                for (uint32_t j=0; j<256; j++){
+                    uint32_t crc = j;
+                    for (int bit=0; bit<8; bit++){
+                        crc = crc & 1 ? 0xEDB88320 ^ (crc >> 1) : crc >> 1;
+                    }
+                    values[j] = crc;
+                }
+#if CRC32_SLICE_BY_4
+                for (int j=256; j<1024; j++){
+                    values[j] = (values[j - 256] >> 8) ^ values[values[j - 256] & 0xFF];
+                }
+#endif
+                is_initialized = true;
+            }
+            return values;
+        }
+};
+
+/**
+ * @brief State of the framed dump. Each frame consists of the magic byte, the 16 bit sequence number, the 16 bit
+ * payload length, the payload (SUMP data) and the CRC32 of all preceding bytes of the frame (all values big endian).
+ * After the last block we send an end frame with the number of blocks as sequence number and no payload. The dump is
+ * pending until the host acknowledges it: until then the host can request any block again.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class FramedDump {
+    public:
+        /// Starts a new dump of the indicated number of samples
+        void begin(size_t samples, uint8_t bytesPerSample) {
+            sample_count = samples;
+            block_samples = FRAMED_BLOCK_SIZE / bytesPerSample;
+            block_count = (samples + block_samples - 1) / block_samples;
+            retransmits = 0;
+            is_pending = true;
+        }
+
+        /// Ends the dump: the samples are not needed any more
+        void end() {
+            is_pending = false;
+        }
+
+        /// Returns true if the dump has not been acknowledged yet
+        bool isPending() {
+            return is_pending;
+        }
+
+        /// Number of samples in the dump
+        size_t sampleCount() {
+            return sample_count;
+        }
+
+        /// Number of samples in a block
+        size_t blockSamples() {
+            return block_samples;
+        }
+
+        /// Number of blocks: this is also the sequence number of the end frame
+        uint16_t blockCount() {
+            return block_count;
+        }
+
+        /// Number of blocks which have been requested again
+        uint32_t retransmitCount() {
+            return retransmits;
+        }
+
+        /// Records a requested retransmit
+        void addRetransmit() {
+            retransmits++;
+        }
+
+        /// Starts a new frame with the indicated sequence number
+        void beginFrame(uint16_t seq) {
+            frame[0] = FRAMED_MAGIC;
+            frame[1] = seq >> 8;
+            frame[2] = seq & 0xFF;
+            frame_len = FRAMED_HEADER_SIZE;
+        }
+
+        /// Adds the encoded samples to the frame: the samples of a block might not be stored contiguously
+        void addSamples(SampleEncoder &encoder, const PinBitArray *samples, size_t n) {
+            frame_len += encoder.encode(samples, n, frame + frame_len);
+        }
+
+        /// Adds the length and the CRC: returns the completed frame
+        const uint8_t *endFrame(size_t &len) {
+            uint16_t payload = frame_len - FRAMED_HEADER_SIZE;
+            frame[3] = payload >> 8;
+            frame[4] = payload & 0xFF;
+            uint32_t crc = CRC32::update(0, frame, frame_len);
+            for (int j=0; j<FRAMED_CRC_SIZE; j++){
+                frame[frame_len++] = crc >> (24 - j * 8);
+            }
+            len = frame_len;
+            return frame;
+        }
+
+    protected:
+        uint8_t frame[FRAMED_HEADER_SIZE + FRAMED_BLOCK_SIZE + FRAMED_CRC_SIZE];
+        size_t frame_len = 0;
+        size_t sample_count = 0;
+        size_t block_samples = FRAMED_BLOCK_SIZE;
+        uint16_t block_count = 0;
+        uint32_t retransmits = 0;
+        bool is_pending = false;
+};
+
+/**
+ * @brief Stream which flips random bits of the written data before it is forwarded: used to test the framed dump
+ * and the retransmits (e.g. on Linux with a loopback) w/o a faulty link. The received data is not changed.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class FaultInjectingStream : public Stream {
+    public:
+        /// Forwards the data to the indicated stream with one bit error per bitsPerError bits on average (0 = no errors)
+        FaultInjectingStream(Stream &stream, uint32_t bitsPerError, uint32_t seed=1) {
+            stream_ptr = &stream;
+            bits_per_error = bitsPerError;
+            random_value = seed == 0 ? 1 : seed;
+            next_error = nextDistance();
+        }
+
+        /// Number of flipped bits
+        uint32_t errors() {
+            return error_count;
+        }
+
+        size_t write(uint8_t value) {
+            return write(&value, 1);
+        }
+
+        size_t write(const uint8_t *data, size_t len) {
+            uint8_t tmp[64];
+            size_t written = 0;
+            while (written < len){
+                size_t n = len - written < sizeof(tmp) ? len - written : sizeof(tmp);
+                memcpy(tmp, data + written, n);
+                for (size_t j=0; j<n && bits_per_error>0; j++){
+                    while (next_error <= 8){
+                        tmp[j] ^= 1 << (next_error - 1);
+                        error_count++;
+                        next_error += nextDistance();
+                    }
+                    next_error -= 8;
+                }
+                size_t result = stream_ptr->write(tmp, n);
+                written += result;
+                if (result < n) break;
+            }
+            return written;
+        }
+
+        int availableForWrite() {
+            return stream_ptr->availableForWrite();
+        }
+
+        void flush() {
+            stream_ptr->flush();
+        }
+
+        int available() {
+            return stream_ptr->available();
+        }
+
+        int read() {
+            return stream_ptr->read();
+        }
+
+        int peek() {
+            return stream_ptr->peek();
+        }
+
+    protected:
+        Stream *stream_ptr = nullptr;
+        uint32_t bits_per_error = 0;
+        uint32_t random_value = 1;
+        int32_t next_error = 0;
+        uint32_t error_count = 0;
+
+        /// distance in bits to the next error: uniform between 1 and 2 * bits_per_error
+        int32_t nextDistance() {
+            if (bits_per_error == 0) return 0x7FFFFFFF;
+            random_value ^= random_value << 13;
+            random_value ^= random_value >> 17;
+            random_value ^= random_value << 5;
+            return 1 + random_value % (2 * bits_per_error);
+        }
+};
+
+} // namespace
@@ -0,0 +1,162 @@
+/**
+ * @file isolation.h
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Shields the sampling loop from interrupts (e.g. the FreeRTOS tick, WiFi or UART), which show up as gaps in
+ * the captured data. The interrupts are masked in bounded windows, so that the watchdog and the system are not starved.
+ */
+#pragma once
+
+#include "Arduino.h"
+#include "config.h"
+#include "logger.h"
+
+// Max duration of a window with masked interrupts in microseconds for ISOLATION_BURSTS
+#ifndef ISOLATION_BURST_US
+#define ISOLATION_BURST_US 500
+#endif
+
+// Duration in microseconds in which the pending interrupts are processed between two windows
+#ifndef ISOLATION_PAUSE_US
+#define ISOLATION_PAUSE_US 2
+#endif
+
+// Max duration of the critical section in microseconds for ISOLATION_CRITICAL: must be below the watchdog timeout
+#ifndef ISOLATION_MAX_CRITICAL_US
+#define ISOLATION_MAX_CRITICAL_US 100000
+#endif
+
+#ifndef ISOLATION_DISABLE_INTERRUPTS
+#define ISOLATION_DISABLE_INTERRUPTS() noInterrupts()
+#endif
+
+#ifndef ISOLATION_ENABLE_INTERRUPTS
+#define ISOLATION_ENABLE_INTERRUPTS() interrupts()
+#endif
+
+namespace logic_analyzer {
+
+/**
+ * Isolation of the sampling loop: NONE does not change the interrupts, BURSTS masks them for windows of
+ * ISOLATION_BURST_US with a short re-enable in between and CRITICAL masks them for the whole capture, but at most for
+ * ISOLATION_MAX_CRITICAL_US
+ */
+enum IsolationPolicy : uint8_t {ISOLATION_NONE, ISOLATION_BURSTS, ISOLATION_CRITICAL};
+
+/**
+ * @brief Masks the interrupts during the capture according to the IsolationPolicy. The capturing loops call check()
+ * at their cancel check points: this re-enables the interrupts when the actual window has elapsed. So the
+ * windows can be a bit longer than defined, but only by the samples between two check points. The log records of
+ * the capture are queued until end(), so that no output is done while the interrupts are masked.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class CaptureIsolation {
+    public:
+        /// Masks the interrupts if the policy is not ISOLATION_NONE: called at the start of the sampling loop
+        void begin(IsolationPolicy policy) {
+            this->policy = policy;
+            window_count = 0;
+            max_masked = 0;
+            is_limit_reached = false;
+            if (policy == ISOLATION_NONE) return;
+            // the log records are queued while the interrupts are masked and printed by end()
+            is_log_printed = !isLogDeferred();
+            isLogDeferred() = true;
+            window_ticks = toTicks(policy == ISOLATION_BURSTS ? ISOLATION_BURST_US : ISOLATION_MAX_CRITICAL_US);
+            mask();
+        }
+
+        /// Ends the actual window if it has elapsed: BURSTS starts a new window after a short pause
+        inline void check() {
+            if (is_masked && (uint32_t)(cycleCount() - start) >= window_ticks){
+                unmask();
+                if (policy == ISOLATION_BURSTS){
+                    delayMicroseconds(ISOLATION_PAUSE_US);
+                    mask();
+                } else {
+                    is_limit_reached = true;
+                }
+            }
+        }
+
+        /// Unmasks the interrupts: called at the end of the sampling loop
+        void end() {
+            if (is_masked) unmask();
+            if (is_log_printed){
+                is_log_printed = false;
+                isLogDeferred() = false;
+                processLog();
+            }
+        }
+
+        /// Returns true if a single uninterruptible window of the indicated duration in microseconds can be masked
+        bool isSupported(uint64_t durationUs) {
+            return durationUs <= ISOLATION_MAX_CRITICAL_US;
+        }
+
+        /// Returns true if the interrupts are masked
+        bool isActive() {
+            return is_masked;
+        }
+
+        /// Policy of the last capture
+        IsolationPolicy isolationPolicy() {
+            return policy;
+        }
+
+        /// Number of windows with masked interrupts in the last capture
+        uint32_t windowCount() {
+            return window_count;
+        }
+
+        /// Longest window with masked interrupts in cycleCount() ticks
+        uint32_t maxMaskedTicks() {
+            return max_masked;
+        }
+
+        /// Returns true if the critical section was ended before the end of the capture
+        bool isLimitReached() {
+            return is_limit_reached;
+        }
+
+        /// Prints the result to the logger
+        void logResult() {
+            if (policy == ISOLATION_NONE) return;
+            logInfo("isolation windows: %lu / max masked ticks: %lu", window_count, max_masked);
+            if (is_limit_reached){
+                logWarning("isolation: critical section ended after %lu us", (unsigned long) ISOLATION_MAX_CRITICAL_US);
+            }
+        }
+
+    protected:
+        IsolationPolicy policy = ISOLATION_NONE;
+        bool is_masked = false;
+        bool is_limit_reached = false;
+        bool is_log_printed = false;
+        uint32_t start = 0;
+        uint32_t window_ticks = 0;
+        uint32_t window_count = 0;
+        uint32_t max_masked = 0;
+
+        void mask() {
+            ISOLATION_DISABLE_INTERRUPTS();
+            is_masked = true;
+            window_count++;
+            start = cycleCount();
+        }
+
+        void unmask() {
+            uint32_t masked = cycleCount() - start;
+            ISOLATION_ENABLE_INTERRUPTS();
+            is_masked = false;
+            if (masked > max_masked) max_masked = masked;
+        }
+
+        static uint32_t toTicks(uint32_t us) {
+            uint64_t ticks = (uint64_t) us * cycleFrequency() / 1000000;
+            return ticks > 0x7FFFFFFF ? 0x7FFFFFFF : ticks;
+        }
+};
+
+} // namespace
@@ -0,0 +1,138 @@
+/**
+ * @file jitter_profiler.h
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Measures the intervals between the captured samples, so that we can see if there are gaps e.g. caused by
+ * interrupts or by the granularity of delayMicroseconds().
+ */
+#pragma once
+
+#include "Arduino.h"
+#include "config.h"
+#include "logger.h"
+
+// Number of sub buckets per power of 2 in the histogram as bits: 3 gives a resolution of 12.5%
+#ifndef JITTER_SUB_BUCKET_BITS
+#define JITTER_SUB_BUCKET_BITS 3
+#endif
+
+namespace logic_analyzer {
+
+/**
+ * @brief Histogram of the inter sample intervals in cycleCount() ticks. Small values are recorded exactly, bigger values
+ * are recorded in logarithmic buckets with 2^JITTER_SUB_BUCKET_BITS sub buckets.
+ * With a stride > 1 we only measure the interval of the last sample of each block of stride samples, to keep the
+ * impact on the capturing small: so the histogram is a sample of the single intervals and a gap is only seen if it
+ * hits a measured sample. Use a stride of 1 to see every gap.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class JitterProfiler {
+    public:
+        /// Default Constructor: measures the interval of every stride-th sample
+        JitterProfiler(uint16_t stride=1) {
+            setStride(stride);
+            clear();
+        }
+
+        /// Defines the number of samples between two measured intervals
+        void setStride(uint16_t stride) {
+            stride_value = stride == 0 ? 1 : stride;
+        }
+
+        /// Provides the number of samples between two measured intervals
+        uint16_t stride() {
+            return stride_value;
+        }
+
+        /// Resets the histogram
+        void clear() {
+            memset(counts, 0, sizeof(counts));
+            total_count = 0;
+            min_value = 0xFFFFFFFF;
+            max_value = 0;
+        }
+
+        /// Records the interval of a single sample in cycleCount() ticks
+        inline void add(uint32_t interval) {
+            counts[bucket(interval)]++;
+            total_count++;
+            if (interval < min_value) min_value = interval;
+            if (interval > max_value) max_value = interval;
+        }
+
+        /// Number of recorded intervals
+        uint32_t count() {
+            return total_count;
+        }
+
+        /// Shortest interval in cycleCount() ticks
+        uint32_t min() {
+            return total_count == 0 ? 0 : min_value;
+        }
+
+        /// Longest interval in cycleCount() ticks
+        uint32_t max() {
+            return max_value;
+        }
+
+        /// Provides the interval (lower bound of the bucket) below which the indicated percent of the intervals are
+        uint32_t percentile(float percent) {
+            uint32_t limit = percent / 100.0 * total_count;
+            uint32_t sum = 0;
+            for (int j=0; j<BUCKETS; j++){
+                sum += counts[j];
+                if (sum > limit || (sum == total_count && sum > 0)) {
+                    return bucketValue(j);
+                }
+            }
+            return 0;
+        }
+
+        /// Number of intervals which are at least the indicated number of ticks (with the resolution of the buckets)
+        uint32_t countAbove(uint32_t ticks) {
+            uint32_t result = 0;
+            for (int j=bucket(ticks); j<BUCKETS; j++){
+                result += counts[j];
+            }
+            return result;
+        }
+
+        /// Converts cycleCount() ticks to nanoseconds
+        static uint32_t toNs(uint32_t ticks) {
+            return (uint64_t) ticks * 1000000000ull / cycleFrequency();
+        }
+
+        /// Prints the result to the logger
+        void logResult() {
+            logInfo("jitter samples: %lu (stride %u)", total_count, stride_value);
+            logInfo("jitter ns min: %lu / max: %lu", toNs(min()), toNs(max()));
+            logInfo("jitter ns p50: %lu / p99: %lu", toNs(percentile(50)), toNs(percentile(99)));
+        }
+
+    protected:
+        static const int SUB_BUCKETS = 1 << JITTER_SUB_BUCKET_BITS;
+        static const int BUCKETS = (32 - JITTER_SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+        uint32_t counts[BUCKETS];
+        uint32_t total_count = 0;
+        uint32_t min_value = 0xFFFFFFFF;
+        uint32_t max_value = 0;
+        uint16_t stride_value = 1;
+
+        /// determines the histogram bucket for the value
+        static int bucket(uint32_t value) {
+            if (value < (uint32_t) SUB_BUCKETS) return value;
+            int msb = (int)(sizeof(unsigned long) * 8) - 1 - __builtin_clzl(value);
+            int shift = msb - JITTER_SUB_BUCKET_BITS;
+            return ((shift + 1) << JITTER_SUB_BUCKET_BITS) + ((value >> shift) & (SUB_BUCKETS - 1));
+        }
+
+        /// provides the smallest value of the bucket
+        static uint32_t bucketValue(int bucket) {
+            if (bucket < SUB_BUCKETS) return bucket;
+            int shift = (bucket >> JITTER_SUB_BUCKET_BITS) - 1;
+            return (uint32_t)(SUB_BUCKETS + (bucket & (SUB_BUCKETS - 1))) << shift;
+        }
+};
+
+} // namespace
@@ -0,0 +1,82 @@
+/**
+ * @file lock_free_queue.h
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Bounded lock free queue which is used to pass data between the cores w/o blocking the capturing
+ */
+#pragma once
+
+#include "Arduino.h"
+#include "atomic_ops.h"
+
+namespace logic_analyzer {
+
+/**
+ * @brief Lock free bounded queue which supports multiple producers (e.g. both cores) and a single consumer.
+ * If the queue is full the entry is dropped and counted. The size must be a power of 2.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+template <class T, size_t SIZE>
+class LockFreeQueue {
+    public:
+        LockFreeQueue() {
+            for (size_t j=0; j<SIZE; j++){
+                entries[j].sequence = j;
+            }
+        }
+
+        /// adds a record: returns false if the queue is full
+        bool push(const T &record) {
+            size_t pos = atomicLoad(&write_pos);
+            while (true) {
+                Entry &entry = entries[pos & (SIZE-1)];
+                size_t seq = atomicLoad(&entry.sequence);
+                long diff = (long) seq - (long) pos;
+                if (diff == 0){
+                    if (atomicCompareExchange(&write_pos, pos, pos+1)){
+                        entry.record = record;
+                        atomicStore(&entry.sequence, pos+1);
+                        return true;
+                    }
+                } else if (diff < 0){
+                    atomicAddFetch(&dropped_count, (size_t) 1);
+                    return false;
+                } else {
+                    pos = atomicLoad(&write_pos);
+                }
+            }
+        }
+
+        /// removes the next record: returns false if there is no record - must only be called by one consumer
+        bool pop(T &record) {
+            Entry &entry = entries[read_pos & (SIZE-1)];
+            size_t seq = atomicLoad(&entry.sequence);
+            if (seq != read_pos+1){
+                return false;
+            }
+            record = entry.record;
+            atomicStore(&entry.sequence, read_pos+SIZE);
+            read_pos++;
+            return true;
+        }
+
+        /// provides the number of records which were dropped and resets the counter
+        size_t takeDropped() {
+            return atomicExchange(&dropped_count, (size_t) 0);
+        }
+
+    protected:
+        struct Entry {
+            size_t sequence;
+            T record;
+        };
+        Entry entries[SIZE];
+        size_t write_pos = 0;
+        size_t read_pos = 0;
+        size_t dropped_count = 0;
+
+        static_assert((SIZE & (SIZE-1)) == 0, "The queue size must be a power of 2");
+};
+
+} // namespace
@@ -0,0 +1,241 @@
+/**
+ * @file logger.h
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Logging which keeps the formatting and output away from the capturing: a log call only records the format
+ * string pointer and the raw arguments in a lock free queue. The output is done later e.g. from the Arduino loop().
+ *
+ */
+#pragma once
+
+#include "Arduino.h"
+#include "lock_free_queue.h"
+
+// Log levels
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARNING 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+// Log calls above this level are removed by the compiler
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+// Max numbers of logged characters in a line
+#ifndef LOG_BUFFER_SIZE
+#define LOG_BUFFER_SIZE 80
+#endif
+
+// Number of log records which can be queued: must be a power of 2
+#ifndef LOG_QUEUE_SIZE
+#define LOG_QUEUE_SIZE 32
+#endif
+
+// Max number of arguments of a log call
+#ifndef LOG_MAX_ARGS
+#define LOG_MAX_ARGS 4
+#endif
+
+namespace logic_analyzer {
+
+// The logger is shared by all LogicAnalyzer instances and is used by the free log functions and macros, so its state
+// is process wide. We use function local statics, so that the header can be included in multiple translation units.
+
+/// Logger Stream
+inline Stream *&loggerPtr() {
+    static Stream *logger_ptr = nullptr;
+    return logger_ptr;
+}
+
+/// Defines if the log records are queued or printed immediately
+inline bool &isLogDeferred() {
+    static bool is_log_deferred = false;
+    return is_log_deferred;
+}
+
+/**
+ * @brief A single raw log argument: the type is only interpreted when the record is formatted
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+union LogArg {
+    long int_value;
+    unsigned long uint_value;
+    double double_value;
+    const void* ptr_value;
+};
+
+/**
+ * @brief The format string pointer and the raw arguments of a single log call. Strings (%s) are stored as pointer, so
+ * they must still be valid when the record is printed (e.g. string literals).
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct LogRecord {
+    const char* fmt = nullptr;
+    uint8_t level = 0;
+    uint8_t arg_count = 0;
+    LogArg args[LOG_MAX_ARGS];
+
+    void add(long value) { args[arg_count++].int_value = value; }
+    void add(int value) { add((long)value); }
+    void add(short value) { add((long)value); }
+    void add(char value) { add((long)value); }
+    void add(signed char value) { add((long)value); }
+    void add(long long value) { add((long)value); }
+    void add(unsigned long value) { args[arg_count++].uint_value = value; }
+    void add(unsigned int value) { add((unsigned long)value); }
+    void add(unsigned short value) { add((unsigned long)value); }
+    void add(unsigned char value) { add((unsigned long)value); }
+    void add(unsigned long long value) { add((unsigned long)value); }
+    void add(bool value) { add((unsigned long)value); }
+    void add(double value) { args[arg_count++].double_value = value; }
+    void add(float value) { add((double)value); }
+    void add(const void* value) { args[arg_count++].ptr_value = value; }
+
+    /// formats the record into the provided buffer: the arguments are converted to the type requested by the format string
+    void format(char* result, size_t len) {
+        size_t pos = 0;
+        int arg_idx = 0;
+        const char* p = fmt;
+        result[0] = 0;
+        while (*p && pos + 1 < len){
+            if (*p != '%'){
+                result[pos++] = *p++;
+                continue;
+            }
+            if (p[1] == '%'){
+                result[pos++] = '%';
+                p += 2;
+                continue;
+            }
+            // collect the specification w/o length modifiers
+            char spec[16];
+            size_t spec_len = 0;
+            spec[spec_len++] = *p++;
+            while (*p && strchr("-+ #0123456789.", *p) && spec_len < sizeof(spec) - 3){
+                spec[spec_len++] = *p++;
+            }
+            while (*p && strchr("hlLqjzt", *p)){
+                p++;
+            }
+            char conversion = *p;
+            if (conversion == 0) break;
+            p++;
+            int written = 0;
+            LogArg arg = arg_idx < arg_count ? args[arg_idx++] : LogArg{0};
+            if (strchr("di", conversion)){
+                spec[spec_len++] = 'l';
+                spec[spec_len++] = conversion; spec[spec_len] = 0;
+                written = snprintf(result + pos, len - pos, spec, arg.int_value);
+            } else if (strchr("uxXoc", conversion)){
+                if (conversion != 'c') spec[spec_len++] = 'l';
+                spec[spec_len++] = conversion; spec[spec_len] = 0;
+                written = conversion == 'c' ? snprintf(result + pos, len - pos, spec, (int) arg.uint_value)
+                                            : snprintf(result + pos, len - pos, spec, arg.uint_value);
+            } else if (strchr("feEgG", conversion)){
+                spec[spec_len++] = conversion; spec[spec_len] = 0;
+                written = snprintf(result + pos, len - pos, spec, arg.double_value);
+            } else if (conversion == 's'){
+                spec[spec_len++] = conversion; spec[spec_len] = 0;
+                written = snprintf(result + pos, len - pos, spec, arg.ptr_value == nullptr ? "(null)" : (const char*) arg.ptr_value);
+            } else {
+                spec[spec_len++] = 'p'; spec[spec_len] = 0;
+                written = snprintf(result + pos, len - pos, spec, arg.ptr_value);
+            }
+            if (written > 0){
+                pos += written;
+                if (pos >= len) pos = len - 1;
+            }
+        }
+        result[pos] = 0;
+    }
+};
+
+/// Queue for the deferred log records
+inline LockFreeQueue<LogRecord, LOG_QUEUE_SIZE> &logQueue() {
+    static LockFreeQueue<LogRecord, LOG_QUEUE_SIZE> log_queue;
+    return log_queue;
+}
+
+/// formats and prints a single record to the logger output stream
+inline void printLogRecord(LogRecord &record) {
+    char serial_printf_buffer[LOG_BUFFER_SIZE];
+    record.format(serial_printf_buffer, LOG_BUFFER_SIZE);
+    loggerPtr()->println(serial_printf_buffer);
+}
+
+/// Prints all queued log records to the logger output stream - Call this from your Arduino loop() or any other core
+inline void processLog() {
+    if (loggerPtr()==nullptr) return;
+    LogRecord record;
+    while (logQueue().pop(record)){
+        printLogRecord(record);
+    }
+    size_t dropped = logQueue().takeDropped();
+    if (dropped>0){
+        loggerPtr()->print("log records dropped: ");
+        loggerPtr()->println((unsigned long)dropped);
+    }
+}
+
+inline void addLogArgs(LogRecord &) {}
+
+template <typename T, typename... Args>
+inline void addLogArgs(LogRecord &record, T value, Args... args) {
+    record.add(value);
+    addLogArgs(record, args...);
+}
+
+/// Records the format string and the arguments: in deferred mode nothing is formatted here
+template <typename... Args>
+inline void logLevel(uint8_t level, const char* fmt, Args... args) {
+    static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many log arguments: increase LOG_MAX_ARGS");
+    if (loggerPtr()!=nullptr) {
+        LogRecord record;
+        record.fmt = fmt;
+        record.level = level;
+        addLogArgs(record, args...);
+        if (isLogDeferred()){
+            logQueue().push(record);
+        } else {
+            printLogRecord(record);
+            loggerPtr()->flush();
+        }
+    }
+}
+
+/// Prints the content to the logger output stream (debug level): the library uses the logDebug() macro instead
+template <typename... Args>
+inline void log(const char* fmt, Args... args) {
+    if (LOG_LEVEL >= LOG_LEVEL_DEBUG) logLevel(LOG_LEVEL_DEBUG, fmt, args...);
+}
+
+} // namespace
+
+// The log macros drop the calls above the LOG_LEVEL together with the evaluation of their arguments
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define logError(...) ::logic_analyzer::logLevel(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define logError(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARNING
+#define logWarning(...) ::logic_analyzer::logLevel(LOG_LEVEL_WARNING, __VA_ARGS__)
+#else
+#define logWarning(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define logInfo(...) ::logic_analyzer::logLevel(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define logInfo(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define logDebug(...) ::logic_analyzer::logLevel(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define logDebug(...) do {} while (0)
+#endif
@@ -10,17 +10,44 @@
 #include "Arduino.h"
 #include "config.h"
 #include "network.h"
-
-// Max numbers of logged characters in a line
-#ifndef LOG_BUFFER_SIZE
-#define LOG_BUFFER_SIZE 80
-#endif 
+#include "logger.h"
+#include "performance_counters.h"
+#include "jitter_profiler.h"
+#include "trigger_interrupt.h"
+#include "decoder.h"
+#include "sample_encoder.h"
+#include "decimator.h"
+#include "statistics.h"
+#include "transport.h"
+#include "overrun.h"
+#include "storage.h"
+#include "test_pattern.h"
+#include "framed_dump.h"
+#include "block_codec.h"
+#include "burst_sampler.h"
+#include "isolation.h"
+#include "atomic_ops.h"
 
 // Max size of buffered print
 #ifndef DUMP_RECORD_SIZE
 #define DUMP_RECORD_SIZE 1024*1
 #endif
 
+// Number of events which can be queued: must be a power of 2
+#ifndef EVENT_QUEUE_SIZE
+#define EVENT_QUEUE_SIZE 16
+#endif
+
+// Max number of event handlers
+#ifndef MAX_EVENT_HANDLERS
+#define MAX_EVENT_HANDLERS 4
+#endif
+
+// Number of samples which share one time stamp in the timestamped capture
+#ifndef TIMESTAMP_BLOCK_SIZE
+#define TIMESTAMP_BLOCK_SIZE 64
+#endif
+
 // Supported Commands
 #define SUMP_RESET 0x00
 #define SUMP_ARM   0x01
@@ -35,6 +62,17 @@
 #define SUMP_SET_FLAGS 0x82
 #define SUMP_SET_RLE 0x0100
 #define SUMP_GET_METADATA 0x04
+// Vendor specific commands
+#define SUMP_GET_PERFORMANCE_COUNTERS 0x30
+#define SUMP_GET_SEGMENTS 0x31
+#define SUMP_SNAPSHOT 0x32
+#define SUMP_GET_STATISTICS 0x33
+#define SUMP_GET_OVERRUNS 0x34
+#define SUMP_REPLAY 0x35
+#define SUMP_FRAMED_DUMP 0x36
+#define SUMP_FRAMED_ACK 0x37
+#define SUMP_COMPRESSED_DUMP 0x38
+#define SUMP_FRAMED_NAK 0xA0
 
 namespace logic_analyzer {
 
@@ -52,62 +90,6 @@ enum Status : uint8_t {STOPPED, ARMED, TRIGGERED};
 enum Event : uint8_t {RESET, STATUS, CAPUTRE_SIZE, CAPTURE_FREQUNCY,TRIGGER_VALUES,TRIGGER_MASK, READ_DLEAY_COUNT, FLAGS};
 typedef void (*EventHandler)(Event event);
 
-PinReader *pin_reader_ptr = nullptr;
-/// common access to buffer
-RingBuffer *buffer_ptr = nullptr;;
-/// Logger Stream
-Stream *logger_ptr = nullptr;
-/// Command stream
-Stream *stream_ptr = nullptr;
-
-/// writes the status of all activated pins to the capturing device
-void write(PinBitArray bits) {
-    // write 4 bytes
-    stream_ptr->write(htonl(bits));
-}
-
-// writes a buffer of uint32_t values
-void write(uint32_t *buff, size_t n_samples) {
-    int written = 0;
-    int open = n_samples * sizeof(uint32_t);
-    while(open > 0){
-        size_t result = stream_ptr->write((const char*)buff + written, open);
-        written += result;
-        open -= result;
-    }
-}
-
-// writes a buffer of PinBitArray
-void write(PinBitArray *buff, size_t n_samples) {
-    // convert to uint32_t
-    uint32_t tmp[DUMP_RECORD_SIZE];
-    int idx = 0;
-    for (int j=0;j<n_samples;j++){
-        tmp[idx++] = htonl(buff[j]);
-        if (idx==DUMP_RECORD_SIZE){
-            write(tmp, idx);
-            idx = 0;
-        }
-    }
-    if (idx>0){
-        write(tmp, idx);
-    }
-}
-
-
-///  Prints the content to the logger output stream
-inline void log(const char* fmt, ...) {
-    if (logger_ptr!=nullptr) {
-        char serial_printf_buffer[LOG_BUFFER_SIZE] = {0};
-        va_list args;
-        va_start(args,fmt);
-        vsnprintf(serial_printf_buffer,LOG_BUFFER_SIZE, fmt, args);
-        logger_ptr->println(serial_printf_buffer);
-        va_end(args);
-        logger_ptr->flush();
-    }
-}
-
 /**
  * @brief 4 Byte SUMP Protocol Command.  The uint8Values data is provided in network format (big endian) while
  * the internal representation is little endian on the 
@@ -138,25 +120,74 @@ class Sump4ByteComandArg {
 
 };
 
+/**
+ * @brief Memory Management for the capture buffer: The default implementation is using the heap. Create your own 
+ * subclass if you want to use some other memory (e.g. PSRAM or some external RAM).
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class Allocator {
+    public:
+        /// Allocates the requested number of bytes - returns nullptr if there is not enough memory
+        virtual void *allocate(size_t size) {
+            return malloc(size);
+        }
+
+        /// Releases the memory which was provided by allocate()
+        virtual void free(void *ptr) {
+            ::free(ptr);
+        }
+};
+
+/// Heap Allocator which is used if no other Allocator has been defined: it has no state, so one instance is shared by all users
+inline Allocator &defaultAllocator() {
+    static Allocator default_allocator;
+    return default_allocator;
+}
+
+#if defined(ESP32) && defined(BOARD_HAS_PSRAM)
+/**
+ * @brief Allocator which is using the PSRAM of the ESP32
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class AllocatorPSRAM : public Allocator {
+    public:
+        /// Allocates the requested number of bytes in PSRAM
+        virtual void *allocate(size_t size) {
+            return ps_malloc(size);
+        }
+};
+#endif
+
 /**
  * @brief Data is captured in a ring buffer. If the buffer is full we overwrite the oldest entries....
+ * The memory can be provided by the caller (e.g. a static array) or it is requested from an Allocator.
  * @author Phil Schatzmann
  * @copyright GPLv3
  */
 class RingBuffer {
     public:
-        RingBuffer(size_t size){
-            this->size_count = size + 10;
-            data = new PinBitArray[this->size_count];
+        /// Allocates the memory for size entries with the help of the indicated Allocator
+        RingBuffer(size_t size, Allocator &allocator=defaultAllocator()){
+            this->allocator_ptr = &allocator;
+            this->size_count = size;
+            data = (PinBitArray*) allocator.allocate(size * sizeof(PinBitArray));
             if (data==nullptr){
-                log("Requested capture size is too big");
+                logError("Requested capture size is too big");
                 this->size_count = 0;
             }
         }
 
+        /// Uses the memory provided by the caller (e.g. a static array) which must hold size entries
+        RingBuffer(PinBitArray *buffer, size_t size){
+            this->size_count = buffer==nullptr ? 0 : size;
+            data = buffer;
+        }
+
          ~RingBuffer(){
-             if (data!=nullptr){
-                delete[] data;
+             if (data!=nullptr && allocator_ptr!=nullptr){
+                allocator_ptr->free(data);
              }
          }
 
@@ -167,13 +198,13 @@ class RingBuffer {
                 return;
             }
             data[write_pos++] = value;
-            if (write_pos>size_count){
+            if (write_pos>=size_count){
                 write_pos = 0;
             }
             if (available_count<size_count){
                 available_count++;
             } else {
-                read_pos = write_pos+1;
+                read_pos = write_pos;
             }
         }
 
@@ -181,10 +212,10 @@ class RingBuffer {
         PinBitArray read() {
             PinBitArray result = 0;
             if (available_count>0){
-                if (read_pos>size_count){
+                result = data[read_pos++];
+                if (read_pos>=size_count){
                     read_pos = 0;
                 }
-                result = data[read_pos++];
                 available_count--;
             }
             return result;
@@ -205,7 +236,7 @@ class RingBuffer {
             return read_len;
         }
 
-        /// clears all entries
+        /// clears all entries: we just reset the positions, so this is independent of the buffer size
         void clear() {
             ignore_count = 0;
             available_count = 0;
@@ -219,10 +250,12 @@ class RingBuffer {
             if (count>available_count){
                 // calculate number of future entries to ignore
                 ignore_count = count - available_count;
+                count = available_count;
             } 
-            // remove count entries            
-            for (int j=0;j<count && available()>0;j++){
-                read();
+            // remove count entries by moving the read position
+            if (count>0){
+                read_pos = (read_pos + count) % size_count;
+                available_count -= count;
             }
         }
 
@@ -245,17 +278,211 @@ class RingBuffer {
             return data;
         }
 
+        /// provides the next available entries w/o copying them: len is reduced to the number of entries which are stored 
+        /// contiguously. Remove them with clear(len) after they have been processed.
+        const PinBitArray *readPtr(size_t &len) {
+            size_t contiguous = size_count - read_pos;
+            if (contiguous > available_count) contiguous = available_count;
+            if (len > contiguous) len = contiguous;
+            return data + read_pos;
+        }
+
+        /// provides the entries starting at the indicated position relative to the next read position w/o removing them:
+        /// len is reduced to the number of entries which are stored contiguously
+        const PinBitArray *peekPtr(size_t idx, size_t &len) {
+            if (idx >= available_count) {
+                len = 0;
+                return data;
+            }
+            size_t pos = read_pos + idx;
+            if (pos>=size_count) pos -= size_count;
+            size_t contiguous = size_count - pos;
+            if (contiguous > available_count - idx) contiguous = available_count - idx;
+            if (len > contiguous) len = contiguous;
+            return data + pos;
+        }
+
+        /// provides the entry at the indicated position relative to the next read position w/o removing it
+        PinBitArray peek(size_t idx) {
+            size_t pos = read_pos + idx;
+            if (pos>=size_count) pos -= size_count;
+            return data[pos];
+        }
+
     private:
         size_t available_count = 0;
         size_t size_count = 0;
         size_t write_pos = 0;
         size_t read_pos = 0;
         size_t ignore_count = 0;
-        PinBitArray *data;
+        PinBitArray *data = nullptr;
+        Allocator *allocator_ptr = nullptr;
+};
+
+/**
+ * @brief Time stamps for the timestamped capture: We record the duration in cycleCount() ticks of each block of
+ * TIMESTAMP_BLOCK_SIZE samples.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class SampleTimestamps {
+    public:
+        /// Allocates the memory to support sampleCount samples with the help of the indicated Allocator
+        SampleTimestamps(size_t sampleCount, Allocator &allocator=defaultAllocator()){
+            this->allocator_ptr = &allocator;
+            this->size_count = blocks(sampleCount);
+            data = (uint32_t*) allocator.allocate(size_count * sizeof(uint32_t));
+            if (data==nullptr){
+                logError("Requested timestamp size is too big");
+                this->size_count = 0;
+            }
+        }
+
+        /// Uses the memory provided by the caller which must hold blocks(sampleCount) entries
+        SampleTimestamps(uint32_t *buffer, size_t blockCount){
+            this->size_count = buffer==nullptr ? 0 : blockCount;
+            data = buffer;
+        }
+
+        ~SampleTimestamps(){
+            if (data!=nullptr && allocator_ptr!=nullptr){
+                allocator_ptr->free(data);
+            }
+        }
+
+        /// Provides the number of blocks which are needed for the indicated number of samples
+        static size_t blocks(size_t sampleCount) {
+            return (sampleCount + TIMESTAMP_BLOCK_SIZE - 1) / TIMESTAMP_BLOCK_SIZE;
+        }
+
+        /// removes all time stamps
+        void clear() {
+            available_count = 0;
+        }
+
+        /// adds the duration of the next block: returns false if there is no space
+        inline bool add(uint32_t duration) {
+            if (available_count>=size_count) return false;
+            data[available_count++] = duration;
+            return true;
+        }
+
+        /// Provides the duration of the indicated block
+        uint32_t duration(size_t block) {
+            return data[block];
+        }
+
+        /// Number of recorded blocks
+        size_t available() {
+            return available_count;
+        }
+
+        /// Max number of blocks
+        size_t size() {
+            return size_count;
+        }
+
+    protected:
+        uint32_t *data = nullptr;
+        size_t size_count = 0;
+        size_t available_count = 0;
+        Allocator *allocator_ptr = nullptr;
+};
+
+// Max number of segments in the segmented capture
+#ifndef MAX_SEGMENTS
+#define MAX_SEGMENTS 16
+#endif
+
+/**
+ * @brief Trigger times of the segmented capture: the buffer is split into segments and each segment starts with a
+ * trigger. The times are recorded in cycleCount() ticks.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class CaptureSegments {
+    public:
+        /// removes all segments
+        void clear(size_t samplesPerSegment=0) {
+            available_count = 0;
+            segment_size = samplesPerSegment;
+        }
+
+        /// records the trigger time of the next segment: returns false if there is no space
+        inline bool add(uint32_t triggerTime) {
+            if (available_count>=MAX_SEGMENTS) return false;
+            trigger_time[available_count++] = triggerTime;
+            return true;
+        }
+
+        /// Number of recorded segments
+        size_t available() {
+            return available_count;
+        }
+
+        /// Number of samples in each segment (the last segment also contains the remaining samples)
+        size_t samplesPerSegment() {
+            return segment_size;
+        }
+
+        /// Trigger time of the indicated segment in cycleCount() ticks relative to the first trigger
+        uint32_t triggerTime(size_t segment) {
+            return segment < available_count ? trigger_time[segment] - trigger_time[0] : 0;
+        }
+
+        /// Trigger time of the indicated segment in microseconds relative to the first trigger
+        uint32_t triggerTimeUs(size_t segment) {
+            return (uint64_t) triggerTime(segment) * 1000000 / cycleFrequency();
+        }
+
+        /// Prints the result to the logger
+        void logResult() {
+            for (size_t j=0; j<available_count; j++){
+                logInfo("segment %u: trigger at %lu us", j, triggerTimeUs(j));
+            }
+        }
+
+    protected:
+        uint32_t trigger_time[MAX_SEGMENTS];
+        size_t available_count = 0;
+        size_t segment_size = 0;
+};
+
+// Number of samples after which the capturing loops check for a cancellation
+#ifndef CANCEL_CHECK_INTERVAL
+#define CANCEL_CHECK_INTERVAL 256
+#endif
+
+/**
+ * @brief Immutable copy of the capturing parameters which is published on ARM: The capturing reads it only once, 
+ * so that the command processing (e.g. on the other core) can change the parameters w/o impacting a running capture.
+ * The token identifies the ARM request and is used to detect a cancellation.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct CaptureConfig {
+    int read_count = 0;
+    int delay_count = 0;
+    uint64_t frequecy_value = 0;  // in hz
+    uint64_t delay_time_us = 0;
+    PinBitArray trigger_mask = 0;
+    PinBitArray trigger_values = 0;
+    bool is_continuous_capture = false;
+    uint16_t segment_count = 1;
+    bool is_flight_recorder = false;
+    uint8_t channel_groups = SampleEncoder::defaultGroups();
+    DecimationMode decimation_mode = DECIMATION_OFF;
+    OverrunPolicy overrun_policy = OVERRUN_CATCH_UP;
+    PinBitArray gap_marker = 0;
+    TestPatternMode test_pattern = TEST_PATTERN_OFF;
+    uint32_t token = 0;
 };
 
 /**
  * @brief Common State information for the Logic Analyzer - provides event handling on State change.
+ * The status is changed with atomic operations, so that it can be shared between the cores.
+ * Each LogicAnalyzer has its own state which also contains the output stream, the buffer and the PinReader, so that
+ * we can run multiple independent instances (e.g. one per core).
  * @author Phil Schatzmann
  * @copyright GPLv3
  */
@@ -268,18 +495,409 @@ class LogicAnalyzerState {
 
         /// Defines the actual status
         void setStatus(Status status){
-            log("setStatus %d", status);
-            status_value = status;
-            raiseEvent(STATUS);
+            logDebug("setStatus %d", (int) status);
+            atomicStore(&status_value, status);
+            onStatusChanged(status);
+        }
+
+        /// Changes the status only if it is still the expected one: returns false if the status was changed by someone else
+        bool compareAndSetStatus(Status expected, Status status){
+            if (!atomicCompareExchange(&status_value, expected, status)){
+                logDebug("setStatus %d failed: actual %d", (int) status, (int) expected);
+                return false;
+            }
+            logDebug("setStatus %d", (int) status);
+            onStatusChanged(status);
+            return true;
+        }
+
+        /// Provides the actual status
+        Status status() {
+            return atomicLoad(&status_value);
+        }
+
+        /// Publishes the actual parameters as new CaptureConfig with a new token: must be called before the status is changed to ARMED
+        void publishConfig() {
+            armed_config.read_count = read_count;
+            armed_config.delay_count = delay_count;
+            armed_config.frequecy_value = frequecy_value;
+            armed_config.delay_time_us = delay_time_us;
+            armed_config.trigger_mask = trigger_mask;
+            armed_config.trigger_values = trigger_values;
+            armed_config.is_continuous_capture = is_continuous_capture;
+            armed_config.segment_count = segment_count;
+            armed_config.is_flight_recorder = is_flight_recorder;
+            armed_config.channel_groups = channel_groups;
+            armed_config.decimation_mode = decimation_mode;
+            armed_config.overrun_policy = overrun_policy;
+            armed_config.gap_marker = gap_marker;
+            // the SUMP test mode flag selects the counter if no pattern has been defined
+            armed_config.test_pattern = test_pattern_mode!=TEST_PATTERN_OFF ? test_pattern_mode : (is_test_mode ? TEST_PATTERN_COUNTER : TEST_PATTERN_OFF);
+            atomicStore(&armed_config.token, atomicAddFetch(&token_value, (uint32_t) 1));
+        }
+
+        /// Provides the config which was published with the last ARM
+        const CaptureConfig &armedConfig() {
+            return armed_config;
+        }
+
+        /// Provides the token of the last published config
+        uint32_t armedToken() {
+            return atomicLoad(&armed_config.token);
+        }
+
+        /// Prepares the test pattern, the channel groups and the compressed stream for the config: this is called by the 
+        /// capturing after it has read the config, so that a previous capture which is still running is not impacted
+        void beginCapture(const CaptureConfig &config) {
+            test_pattern.begin(config.test_pattern);
+            encoder.setGroups(config.channel_groups);
+            beginCompressed();
+        }
+
+        /// Cancels the actual capturing: all loops which are using the actual token will stop
+        void cancel() {
+            atomicAddFetch(&token_value, (uint32_t) 1);
+        }
+
+        /// Checks if the capturing with the indicated config has been cancelled or stopped
+        bool isCancelled(const CaptureConfig &config) {
+            return atomicLoad(&token_value) != config.token || status() == STOPPED;
         }
 
         Stream &stream() {
             return *stream_ptr;
         }
 
+        /// Provides access to the buffer
+        RingBuffer &buffer() {
+            return *buffer_ptr;
+        }
+
+        /// Provides access to the PinReader
+        PinReader &pinReader() {
+            return pin_reader;
+        }
+
+        /// Provides the generator of the test pattern
+        TestPatternGenerator &testPatternGenerator() {
+            return test_pattern;
+        }
+
+        /// Reads all pins or provides the next value of the active test pattern: the capture loops select the source 
+        /// only once, so this is only used by the sampling which is not time critical
+        inline PinBitArray readAll() {
+            return test_pattern.isActive() ? test_pattern.readAll() : pin_reader.readAll();
+        }
+
+        /// Provides the performance counters of the last capture
+        PerformanceCounters &performanceCounters() {
+            return performance_counters;
+        }
+
+        /// Provides the trigger times of the last segmented capture
+        CaptureSegments &segments() {
+            return capture_segments;
+        }
+
+        /// Provides the overrun counters of the last continuous capture
+        OverrunMonitor &overrunMonitor() {
+            return overrun_monitor;
+        }
+
+        /// Writes the captured samples with the indicated config to the storage w/o removing them from the buffer
+        bool saveSnapshot(const char *name, const CaptureConfig &config) {
+            if (storage_ptr==nullptr) return false;
+            size_t available = buffer().available();
+            logDebug("saveSnapshot %s: %lu", name, available);
+            SnapshotHeader header;
+            header.encoding = storage_encoding;
+            header.channel_groups = encoder.groups();
+            header.frequency = config.frequecy_value;
+            header.sample_count = available;
+            header.delay_count = config.delay_count;
+            header.trigger_mask = config.trigger_mask;
+            header.trigger_values = config.trigger_values;
+            SnapshotWriter writer(*storage_ptr, codec_ptr);
+            if (!writer.begin(name, header)) return false;
+            // the buffer might wrap around
+            size_t len = available;
+            const PinBitArray *samples = buffer().readPtr(len);
+            writer.write(samples, len);
+            if (len < available){
+                writer.write(buffer().data_ptr(), available - len);
+            }
+            return writer.end();
+        }
+
+        /// writes the status of all activated pins to the capturing device
+        void write(PinBitArray bits) {
+            if (decoder_ptr!=nullptr || statistics_ptr!=nullptr){
+                // the decoder and the statistics get the samples in blocks
+                sample_block[block_pos++] = bits;
+                if (block_pos==DECODER_BLOCK_SIZE){
+                    flushSampleBlock();
+                }
+                if (decoder_ptr!=nullptr) return;
+            }
+            if (isCompressed()){
+                if (codec_ptr->add(bits)) handOffCompressedBlock();
+                performance_counters.addSamples(1);
+                return;
+            }
+            if (PerformanceCounters::isActive() && stream_ptr->availableForWrite()==0){
+                performance_counters.addOverrun();
+            }
+            uint8_t data[4];
+            size_t len = encoder.encode(&bits, 1, data);
+            size_t result = stream_ptr->write(data, len);
+            performance_counters.addSamples(1);
+            performance_counters.addBytes(result);
+        }
+
+        /// writes the bytes to the output stream
+        void writeBytes(const uint8_t *data, size_t len) {
+            size_t written = 0;
+            while(written < len){
+                size_t result = stream_ptr->write(data + written, len - written);
+                written += result;
+                performance_counters.addBytes(result);
+                if (written < len) {
+                    performance_counters.addWriteStall();
+                }
+            }
+        }
+
+        /// writes a buffer of PinBitArray in the SUMP wire format: if isStable is true the memory is not changed until 
+        /// the stream is flushed, so that a Transport can send it w/o copying
+        void write(const PinBitArray *buff, size_t n_samples, bool isStable=false) {
+            if (isCompressed()){
+                writeCompressed(buff, n_samples);
+                return;
+            }
+            // 8 channels: the memory has already the wire format
+            if (sizeof(PinBitArray)==1 && encoder.groups()==1){
+                if (transport_ptr!=nullptr && isStable){
+                    transport_ptr->queue((const uint8_t*) buff, n_samples);
+                    performance_counters.addBytes(n_samples);
+                } else {
+                    writeBytes((const uint8_t*) buff, n_samples);
+                }
+                return;
+            }
+            if (transport_ptr!=nullptr){
+                writeLoaned(buff, n_samples);
+                return;
+            }
+            uint8_t tmp[DUMP_RECORD_SIZE];
+            const size_t max_samples = DUMP_RECORD_SIZE / encoder.bytesPerSample();
+            while (n_samples > 0){
+                size_t len = n_samples < max_samples ? n_samples : max_samples;
+                writeBytes(tmp, encoder.encode(buff, len, tmp));
+                buff += len;
+                n_samples -= len;
+            }
+        }
+
+        /// encodes the samples directly into the send buffers of the Transport
+        void writeLoaned(const PinBitArray *buff, size_t n_samples) {
+            while (n_samples > 0){
+                if (transport_ptr->availableForWrite()==0){
+                    performance_counters.addWriteStall();
+                }
+                size_t size;
+                uint8_t *out = transport_ptr->loan(size);
+                size_t max_samples = size / encoder.bytesPerSample();
+                size_t len = n_samples < max_samples ? n_samples : max_samples;
+                size_t bytes = encoder.encode(buff, len, out);
+                transport_ptr->commit(bytes);
+                performance_counters.addBytes(bytes);
+                buff += len;
+                n_samples -= len;
+            }
+        }
+
+        /// Returns true if the dump is sent in frames with a CRC (see SUMP_FRAMED_DUMP)
+        bool isFramedDump() {
+            return framed_dump_ptr!=nullptr && (is_framed_dump || is_framed_requested);
+        }
+
+        /// Provides the FramedDump or nullptr
+        FramedDump *framedDump() {
+            return framed_dump_ptr;
+        }
+
+        /// Returns true if the last framed dump has not been acknowledged yet
+        bool isFramedDumpPending() {
+            return framed_dump_ptr!=nullptr && framed_dump_ptr->isPending();
+        }
+
+        /// Sends all samples of the buffer as frames followed by the end frame: the samples stay in the buffer until the host has acknowledged them
+        void writeFramedDump() {
+            FramedDump &framed_dump = *framed_dump_ptr;
+            framed_dump.begin(buffer().available(), encoder.bytesPerSample());
+            logDebug("writeFramedDump: %lu blocks", (unsigned long) framed_dump.blockCount());
+            for (uint16_t seq=0; seq<=framed_dump.blockCount(); seq++){
+                writeFrame(seq);
+            }
+        }
+
+        /// Sends the indicated block of the pending framed dump again: sequence numbers >= blockCount() send the end frame
+        void writeFrame(uint16_t seq) {
+            FramedDump &framed_dump = *framed_dump_ptr;
+            if (seq > framed_dump.blockCount()) seq = framed_dump.blockCount();
+            framed_dump.beginFrame(seq);
+            size_t pos = (size_t) seq * framed_dump.blockSamples();
+            size_t end = pos + framed_dump.blockSamples();
+            if (end > framed_dump.sampleCount()) end = framed_dump.sampleCount();
+            // the block might wrap around
+            while (pos < end){
+                size_t len = end - pos;
+                const PinBitArray *samples = buffer().peekPtr(pos, len);
+                if (len==0) break;
+                framed_dump.addSamples(encoder, samples, len);
+                pos += len;
+            }
+            size_t len;
+            const uint8_t *frame = framed_dump.endFrame(len);
+            writeBytes(frame, len);
+        }
+
+        /// Returns true if the samples are sent as compressed blocks (see SUMP_COMPRESSED_DUMP): this is not used for the decoded frames
+        bool isCompressed() {
+            return codec_ptr!=nullptr && decoder_ptr==nullptr && (is_compressed || is_compressed_requested);
+        }
+
+        /// Provides the BlockCodec or nullptr
+        BlockCodec *blockCodec() {
+            return codec_ptr;
+        }
+
+        /// Starts a new compressed stream
+        void beginCompressed() {
+            if (codec_ptr!=nullptr) codec_ptr->begin(encoder.groups());
+        }
+
+        /// Adds the samples to the compressed stream: the full blocks are sent immediately
+        void writeCompressed(const PinBitArray *buff, size_t n_samples) {
+            while (n_samples > 0){
+                size_t len = codec_ptr->add(buff, n_samples);
+                if (codec_ptr->isFull()) writeCompressedBlock();
+                buff += len;
+                n_samples -= len;
+            }
+        }
+
+        /// Sends the open block and the end marker of the compressed stream: a block which has been handed off is sent first
+        void endCompressed() {
+            while (codec_ptr->isPending()){
+                writePendingBlock();
+            }
+            if (codec_ptr->pending() > 0) writeCompressedBlock();
+            writeCompressedBlock();
+            codec_ptr->logResult();
+        }
+
+        /// Encodes and sends the actual block of the BlockCodec
+        void writeCompressedBlock() {
+            size_t len;
+            const uint8_t *data = codec_ptr->encodeBlock(len);
+            writeBytes(data, len);
+        }
+
+        /// Passes a full block of a continuous capture to writePendingBlock() on the other core. If the previous block has 
+        /// not been taken yet we send it here, and if it is being sent we wait: both are counted as stall of the capturing
+        void handOffCompressedBlock() {
+            if (codec_ptr->handOff()) return;
+            codec_ptr->addStall();
+            while (codec_ptr->isPending()){
+                writePendingBlock();
+            }
+            codec_ptr->handOff();
+        }
+
+        /// Encodes and sends the block which has been handed off by the capturing, if it has not been taken yet
+        void writePendingBlock() {
+            if (codec_ptr==nullptr || !codec_ptr->claimPending()) return;
+            size_t len;
+            const uint8_t *data = codec_ptr->encodePending(len);
+            writeBytes(data, len);
+            codec_ptr->releasePending();
+        }
+
+        /// Provides the Transport or nullptr if we use a regular Stream
+        Transport *transport() {
+            return transport_ptr;
+        }
+
+        /// Provides the encoder for the SUMP wire format
+        SampleEncoder &sampleEncoder() {
+            return encoder;
+        }
+
+        /// passes the collected samples to the decoder and the statistics
+        void flushSampleBlock() {
+            if (block_pos==0) return;
+            if (statistics_ptr!=nullptr){
+                statistics_ptr->update(sample_block, block_pos);
+            }
+            if (decoder_ptr!=nullptr){
+                decoder_ptr->decode(sample_block, block_pos);
+                performance_counters.addSamples(block_pos);
+            }
+            block_pos = 0;
+        }
+
+        /// ends a continuous capture: flushes the open sample block and sends the end of the compressed stream
+        void endContinuous() {
+            flushSampleBlock();
+            if (isCompressed()) endCompressed();
+        }
+
+        /// Provides the active statistics or nullptr
+        SignalStatistics *statistics() {
+            return statistics_ptr;
+        }
+
+        /// Provides the active decoder or nullptr
+        Decoder *decoder() {
+            return decoder_ptr;
+        }
+
     protected:
+        Stream *stream_ptr = nullptr;
+        Transport *transport_ptr = nullptr;
+        RingBuffer *buffer_ptr = nullptr;
+        PinReader pin_reader = PinReader(START_PIN);
+        PerformanceCounters performance_counters;
+        CaptureSegments capture_segments;
+        OverrunMonitor overrun_monitor;
+        CaptureStorage *storage_ptr = nullptr;
+        const char *storage_name = STORAGE_DEFAULT_NAME;
+        SnapshotEncoding storage_encoding = SNAPSHOT_RLE;
+        Decoder *decoder_ptr = nullptr;
+        SignalStatistics *statistics_ptr = nullptr;
+        PinBitArray sample_block[DECODER_BLOCK_SIZE];
+        size_t block_pos = 0;
         volatile Status status_value;
+        uint32_t token_value = 0;
+        CaptureConfig armed_config;
         bool is_continuous_capture = false; // => continous capture
+        uint16_t segment_count = 1;
+        bool is_flight_recorder = false;
+        uint8_t channel_groups = SampleEncoder::defaultGroups();
+        DecimationMode decimation_mode = DECIMATION_OFF;
+        OverrunPolicy overrun_policy = OVERRUN_CATCH_UP;
+        PinBitArray gap_marker = 0;
+        TestPatternGenerator test_pattern;
+        TestPatternMode test_pattern_mode = TEST_PATTERN_OFF;
+        bool is_test_mode = false;
+        FramedDump *framed_dump_ptr = nullptr;
+        bool is_framed_dump = false;
+        bool is_framed_requested = false;
+        BlockCodec *codec_ptr = nullptr;
+        bool is_compressed = false;
+        bool is_compressed_requested = false;
+        SampleEncoder encoder;
         uint32_t max_capture_size = 1000;
         int trigger_pos = -1;
         int read_count = 0;
@@ -291,14 +909,47 @@ class LogicAnalyzerState {
         PinBitArray trigger_mask = 0;
         PinBitArray trigger_values = 0;
         Sump4ByteComandArg cmd4;
-        EventHandler eventHandler = nullptr;
-
+        EventHandler sync_event_handler = nullptr;
+        EventHandler event_handlers[MAX_EVENT_HANDLERS] = {nullptr};
+        int event_handler_count = 0;
+        LockFreeQueue<Event, EVENT_QUEUE_SIZE> event_queue;
 
-        /// raises an event
+        /// raises an event: the synchronous handler is called immediately, all other handlers only in processEvents()
         void raiseEvent(Event event){
-            if (eventHandler!=nullptr) eventHandler(event);
+            if (sync_event_handler!=nullptr) sync_event_handler(event);
+            if (event_handler_count>0) event_queue.push(event);
         }
-} la_state;       
+
+        /// delivers the queued events to all event handlers
+        void processEvents() {
+            Event event;
+            while (event_queue.pop(event)){
+                for (int j=0; j<event_handler_count; j++){
+                    event_handlers[j](event);
+                }
+            }
+            if (event_queue.takeDropped()>0){
+                logWarning("events dropped");
+            }
+        }
+
+        /// updates the performance counters and notifies the event handler
+        void onStatusChanged(Status status){
+            if (status==ARMED) {
+                performance_counters.onArm();
+                block_pos = 0;
+                if (decoder_ptr!=nullptr) {
+                    decoder_ptr->reset();
+                }
+                if (statistics_ptr!=nullptr) {
+                    statistics_ptr->clear();
+                }
+            } else if (status==TRIGGERED) {
+                performance_counters.onTrigger();
+            }
+            raiseEvent(STATUS);
+        }
+};
 
 
 
@@ -327,12 +978,22 @@ class AbstractCapture {
 
         /// Provides access to the PinReader
         virtual PinReader &pinReader() {
-            return *(pin_reader_ptr);
+            return state().pinReader();
+        }
+
+        /// Provides access to the state of the LogicAnalyzer
+        LogicAnalyzerState &state() {
+            return *la_state_ptr;
+        }
+
+        /// Provides access to the buffer of the LogicAnalyzer
+        RingBuffer &buffer() {
+            return state().buffer();
         }
 
         /// Sets the status
         virtual void setStatus(Status status){
-            la_state.setStatus(status);
+            state().setStatus(status);
         }
 
         /// Captures the data and dumps the result
@@ -341,12 +1002,19 @@ class AbstractCapture {
         /// Used to masure the speed - capture into memory w/o dump!
         virtual void captureAll() = 0;
 
+        /// Processes the next bounded part of a running capture: used by captures which do not block in capture(). Returns true if a capture is active
+        virtual bool step() {
+            return false;
+        }
+
 
     protected:
         LogicAnalyzer *logic_analyzer_ptr = nullptr;
+        LogicAnalyzerState *la_state_ptr = nullptr;
 
-        virtual void setLogicAnalyzer(LogicAnalyzer &la){
+        virtual void setLogicAnalyzer(LogicAnalyzer &la, LogicAnalyzerState &state){
             logic_analyzer_ptr = &la;
+            la_state_ptr = &state;
         }
 
 };
@@ -366,152 +1034,855 @@ class Capture : public AbstractCapture {
 
         /// starts the capturing of the data
         virtual void capture(){
-            log("capture");
-            // no capture if request is well above max rate
-            if (la_state.frequecy_value > max_frequecy_value + (max_frequecy_value/2)){
-                setStatus(STOPPED);
-                // Send some dummy data to stop pulseview
-                write(0);
-                log("The frequency %u is not supported!", la_state.frequecy_value );
+            logDebug("capture");
+            if (!loadConfig()){
+                return;
+            }
+            if (config.is_flight_recorder){
+                dumpSnapshot();
                 return;
             }
 
             // if frequecy_value >= max_frequecy_value -> capture at max speed
-            capture(la_state.frequecy_value >= max_frequecy_threshold); 
-            log("capture-end");
+            capture(isMaxSpeed()); 
+            logDebug("capture-end");
         }
 
         /// Generic Capturing of requested number of examples into the buffer
         void captureAll() {
-            log("captureAll %ld entries", la_state.read_count);
-            unsigned long delay_time_us = la_state.delay_time_us;
-            while(la_state.status_value == TRIGGERED && buffer_ptr->available() < la_state.read_count ){
-                captureSampleFast();   
-                delayMicroseconds(delay_time_us);
+            readConfig();
+            beginIsolation();
+            if (isTestPattern()){
+                loopAll(state().testPatternGenerator());
+            } else {
+                loopAll(pinReader());
             }
+            endIsolation();
         }
 
         /// Capturing of requested number of examples into the buffer at maximum speed 
         void captureAllMaxSpeed() {
-            log("captureAllMaxSpeed %ld entries",la_state.read_count);
-            while(la_state.status_value == TRIGGERED && buffer_ptr->available() < la_state.read_count ){
-                captureSampleFast();
+            readConfig();
+            beginIsolation();
+            if (isTestPattern()){
+                loopAllMaxSpeed(state().testPatternGenerator());
+            } else {
+                loopAllMaxSpeed(pinReader());
             }
+            endIsolation();
         }
 
         /// Continuous capturing at the requested speed
         void captureAllContinous() {
-            log("captureAllContinous");
-            unsigned long delay_time_us = la_state.delay_time_us;
-            while(la_state.status_value == TRIGGERED){
-                captureSampleFastContinuous();   
+            readConfig();
+            if (isTestPattern()){
+                loopAllContinous(state().testPatternGenerator());
+            } else {
+                loopAllContinous(pinReader());
+            }
+        }
+
+        /// Continuous capturing at max speed
+        void captureAllContinousMaxSpeed() {
+            readConfig();
+            if (isTestPattern()){
+                loopAllContinousMaxSpeed(state().testPatternGenerator());
+            } else {
+                loopAllContinousMaxSpeed(pinReader());
+            }
+        }
+
+        /// Dumps the captured samples to the SUMP stream: used to measure the dump throughput
+        void dump() {
+            readConfig();
+            dumpData();
+        }
+
+        /// Capturing at max speed where all samples of each output period are reduced to a single value
+        template <class Reader>
+        void loopAllDecimated(Reader &reader) {
+            logDebug("captureAllDecimated %ld entries", config.read_count);
+            SampleDecimator decimator(config.decimation_mode);
+            // output period in cycleCount() ticks: we distribute the remainder
+            uint32_t frequency = config.frequecy_value;
+            uint32_t period = cycleFrequency() / frequency;
+            uint32_t remainder = cycleFrequency() % frequency;
+            uint32_t error = 0;
+            size_t read_count = config.read_count;
+            bool is_continuous = config.is_continuous_capture;
+            uint32_t next = cycleCount() + period;
+            while((is_continuous || buffer().available() < read_count) && !isCancelled()){
+                do {
+                    decimator.add(reader.readAll());
+                } while ((int32_t)(cycleCount() - next) < 0);
+                next += period;
+                error += remainder;
+                if (error >= frequency){
+                    error -= frequency;
+                    next++;
+                }
+                if (is_continuous){
+                    state().write(decimator.result());
+                } else {
+                    buffer().write(decimator.result());
+                }
+            }
+            if (is_continuous){
+                state().endContinuous();
+            } else {
+                state().flushSampleBlock();
+            }
+        }
+
+        /// Capturing at max speed with time stamps until the requested time span is covered or the buffer is full
+        void captureAllTimestamped() {
+            readConfig();
+            beginIsolation();
+            if (isTestPattern()){
+                loopAllTimestamped(state().testPatternGenerator());
+            } else {
+                loopAllTimestamped(pinReader());
+            }
+            endIsolation();
+        }
+
+        /// Flight recorder mode: records up to the indicated number of samples into the buffer at the actual capture frequency while 
+        /// no capture is active. Call this repeatedly e.g. from the capturing task. Returns the number of recorded samples.
+        size_t record(size_t samples) {
+            LogicAnalyzerState &la_state = state();
+            // the parameters are taken from the published config which is read again after each publication
+            if (la_state.armedToken() != config.token){
+                readConfig();
+            }
+            if (!config.is_flight_recorder) return 0;
+            if (isTestPattern()){
+                return recordSamples(state().testPatternGenerator(), samples);
+            }
+            return recordSamples(pinReader(), samples);
+        }
+
+        /// Activates the profiling of the intervals between the samples for captureAll() and captureAllMaxSpeed()
+        void setJitterProfiler(JitterProfiler &profiler){
+            jitter_profiler_ptr = &profiler;
+        }
+
+        /// Deactivates the profiling of the intervals between the samples
+        void clearJitterProfiler(){
+            jitter_profiler_ptr = nullptr;
+        }
+
+        /// Activates the timestamped capture: we capture at max speed and record the time of each block of samples. 
+        /// On dump the data is resampled to the requested frequency. Pre-trigger samples are not supported in this mode.
+        void setTimestamps(SampleTimestamps &timestamps){
+            timestamps_ptr = &timestamps;
+        }
+
+        /// Deactivates the timestamped capture
+        void clearTimestamps(){
+            timestamps_ptr = nullptr;
+        }
+
+        /// Waits for a single pin trigger with the help of the interrupt instead of polling all pins, so that the core is free while we wait
+        void setTriggerInterrupt(TriggerInterrupt &interrupt){
+            trigger_interrupt_ptr = &interrupt;
+        }
+
+        /// Deactivates the waiting for the trigger with an interrupt
+        void clearTriggerInterrupt(){
+            trigger_interrupt_ptr = nullptr;
+        }
+
+        /// Activates the cycle exact capturing with unrolled blocks for the frequencies which can be reached with the BurstSampler
+        void setBurstSampler(BurstSampler &sampler){
+            burst_sampler_ptr = &sampler;
+        }
+
+        /// Deactivates the cycle exact capturing
+        void clearBurstSampler(){
+            burst_sampler_ptr = nullptr;
+        }
+
+        /// Defines how the sampling loop is shielded from interrupts: this is not used for continuous captures
+        void setIsolationPolicy(IsolationPolicy policy){
+            isolation_policy = policy;
+        }
+
+        /// Provides the actual IsolationPolicy
+        IsolationPolicy isolationPolicy() {
+            return isolation_policy;
+        }
+
+        /// Provides the isolation counters of the last capture
+        CaptureIsolation &isolation() {
+            return capture_isolation;
+        }
+
+        /// captures one singe entry for all pins and writes it to the buffer
+        void captureSampleFast() {
+            buffer().write(state().readAll());
+        }
+
+        /// captures one singe entry with the indicated reader and writes it to the buffer
+        template <class Reader>
+        inline void captureSampleFast(Reader &reader) {
+            buffer().write(reader.readAll());
+        }
+
+        /// captures one singe entry for all pins and writes it to output stream
+        void captureSampleFastContinuous() {
+            state().write(state().readAll());
+        }
+
+        /// captures one singe entry with the indicated reader and writes it to output stream
+        template <class Reader>
+        inline void captureSampleFastContinuous(Reader &reader) {
+            state().write(reader.readAll());
+        }
+
+        /// captures one single entry for all pins and provides the result - used by the trigger
+        PinBitArray captureSample() {
+            return captureSample(state());
+        }
+
+        /// captures one single entry with the indicated reader and provides the result
+        template <class Reader>
+        PinBitArray captureSample(Reader &reader) {
+            // actual state
+            PinBitArray actual = reader.readAll();
+
+            // buffer single capture cycle
+            if (config.is_continuous_capture) {
+                state().write(actual);
+            } else if (state().status()==TRIGGERED) {
+                buffer().write(actual);
+            } 
+            return actual;          
+        }
+
+
+    protected:
+        uint64_t max_frequecy_value;  // in hz
+        uint64_t max_frequecy_threshold;  // in hz
+        JitterProfiler *jitter_profiler_ptr = nullptr;
+        SampleTimestamps *timestamps_ptr = nullptr;
+        TriggerInterrupt *trigger_interrupt_ptr = nullptr;
+        BurstSampler *burst_sampler_ptr = nullptr;
+        bool is_burst = false;
+        IsolationPolicy isolation_policy = ISOLATION_NONE;
+        CaptureIsolation capture_isolation;
+        CaptureConfig config;
+
+        /// reads the published config and prepares the state for it: called once at the start of each capture
+        void readConfig() {
+            config = state().armedConfig();
+            state().beginCapture(config);
+        }
+
+        /// Returns true if the samples are provided by the test pattern instead of the pins: the loops are specialized for
+        /// the source, so that we do not need to decide this for each sample
+        bool isTestPattern() {
+            return state().testPatternGenerator().isActive();
+        }
+
+        /// flight recorder mode: records up to the indicated number of samples into the buffer
+        template <class Reader>
+        size_t recordSamples(Reader &reader, size_t samples) {
+            LogicAnalyzerState &la_state = state();
+            unsigned long delay_time_us = isMaxSpeed() ? 0 : config.delay_time_us;
+            size_t j = 0;
+            while (j<samples){
+                if (j % CANCEL_CHECK_INTERVAL == 0 && la_state.status()!=STOPPED) break;
+                captureSampleFast(reader);
+                if (delay_time_us>0){
+                    delayMicroseconds(delay_time_us);
+                }
+                j++;
+            }
+            return j;
+        }
+
+        /// reads the published config only once: returns false if the requested frequency is not supported
+        bool loadConfig() {
+            readConfig();
+            // the BurstSampler can also reach frequencies above the max rate
+            is_burst = isBurstSupported() && burst_sampler_ptr->begin(pinReader(), buffer().data_ptr(), buffer().size(), config.frequecy_value);
+            // no capture if request is well above max rate
+            if (!is_burst && config.frequecy_value > max_frequecy_value + (max_frequecy_value/2)){
+                setStatus(STOPPED);
+                // Send some dummy data to stop pulseview
+                state().write(0);
+                logWarning("The frequency %u is not supported!", config.frequecy_value );
+                return false;
+            }
+            return true;
+        }
+
+        /// the BurstSampler is only used for regular captures into the buffer
+        bool isBurstSupported() {
+            return burst_sampler_ptr!=nullptr && !config.is_continuous_capture && !config.is_flight_recorder
+                && config.decimation_mode==DECIMATION_OFF && config.segment_count <= 1 && config.test_pattern==TEST_PATTERN_OFF
+                && timestamps_ptr==nullptr && jitter_profiler_ptr==nullptr;
+        }
+
+        /// Captures read_count samples with the BurstSampler directly into the memory of the buffer
+        void loopAllBurst() {
+            size_t read_count = config.read_count;
+            if (read_count > buffer().size()) read_count = buffer().size();
+            logDebug("captureAllBurst %ld entries", read_count);
+            // the burst can't be interrupted by check(): so we only mask the interrupts if it is short enough
+            if (capture_isolation.isActive() && !capture_isolation.isSupported((uint64_t) read_count * 1000000 / burst_sampler_ptr->frequency())){
+                logWarning("burst too long for the isolation");
+                capture_isolation.end();
+            }
+            buffer().clear();
+            burst_sampler_ptr->capture(pinReader(), buffer().data_ptr(), read_count);
+            buffer().setAvailable(read_count);
+        }
+
+        /// flight recorder mode: dumps the last read_count recorded samples w/o waiting for a trigger
+        void dumpSnapshot() {
+            logDebug("dumpSnapshot");
+            if (!state().compareAndSetStatus(ARMED, TRIGGERED)){
+                logDebug("cancelled");
+                return;
+            }
+            size_t read_count = config.read_count;
+            if (buffer().available() > read_count){
+                buffer().clear(buffer().available() - read_count);
+            } else if (buffer().available() < read_count){
+                logWarning("snapshot: only %lu samples recorded", buffer().available());
+            }
+            onCaptured();
+        }
+
+        /// checks if we need to capture w/o any delays
+        bool isMaxSpeed() {
+            return config.frequecy_value >= max_frequecy_threshold;
+        }
+
+        /// checks if the actual capture has been cancelled: this is also the point where the isolation window can end
+        bool isCancelled() {
+            capture_isolation.check();
+            return state().isCancelled(config);
+        }
+
+        /// masks the interrupts for the sampling loop according to the IsolationPolicy
+        void beginIsolation() {
+            capture_isolation.begin(config.is_continuous_capture ? ISOLATION_NONE : isolation_policy);
+        }
+
+        /// unmasks the interrupts after the sampling loop
+        void endIsolation() {
+            capture_isolation.end();
+            capture_isolation.logResult();
+        }
+
+        /// Generic Capturing of requested number of examples into the buffer
+        template <class Reader>
+        void loopAll(Reader &reader) {
+            logDebug("captureAll %ld entries", config.read_count);
+            unsigned long delay_time_us = config.delay_time_us;
+            if (jitter_profiler_ptr!=nullptr){
+                loopAllProfiled(reader, delay_time_us);
+                return;
+            }
+            size_t read_count = config.read_count;
+            while(buffer().available() < read_count && !isCancelled()){
+                captureSampleFast(reader);   
+                delayMicroseconds(delay_time_us);
+            }
+        }
+
+        /// Capturing of requested number of examples into the buffer at maximum speed: we check for a cancellation only every CANCEL_CHECK_INTERVAL samples
+        template <class Reader>
+        void loopAllMaxSpeed(Reader &reader) {
+            logDebug("captureAllMaxSpeed %ld entries",config.read_count);
+            if (jitter_profiler_ptr!=nullptr){
+                loopAllProfiled(reader, 0);
+                return;
+            }
+            size_t read_count = config.read_count;
+            uint16_t check = 0;
+            while(buffer().available() < read_count){
+                captureSampleFast(reader);
+                if (++check==CANCEL_CHECK_INTERVAL){
+                    check = 0;
+                    if (isCancelled()) break;
+                }
+            }
+        }
+
+        /// Continuous capturing at the requested speed: the samples are taken on the grid of the sample period, so that we 
+        /// can detect if the output can't keep up and apply the OverrunPolicy
+        template <class Reader>
+        void loopAllContinous(Reader &reader) {
+            logDebug("captureAllContinous");
+            OverrunMonitor &monitor = state().overrun_monitor;
+            monitor.begin(config.frequecy_value, config.overrun_policy);
+            if (!monitor.isGridSupported()){
+                loopAllContinousDelayed(reader);
+                return;
+            }
+            uint32_t next = cycleCount();
+            while(!isCancelled()){
+                captureSampleFastContinuous(reader);
+                monitor.advance(next);
+                uint32_t missed = monitor.missed(next);
+                if (missed > 0 && !onOverrun(monitor, missed, next)){
+                    break;
+                }
+                while ((int32_t)(cycleCount() - next) < 0);
+            }
+            state().endContinuous();
+            monitor.logResult();
+        }
+
+        /// Continuous capturing with a delay between the samples: used if the cycleCount() is too coarse for the requested rate
+        template <class Reader>
+        void loopAllContinousDelayed(Reader &reader) {
+            logInfo("cycle counter too coarse for %lu hz: no overrun detection", (unsigned long) config.frequecy_value);
+            unsigned long delay_time_us = config.delay_time_us;
+            while(!isCancelled()){
+                captureSampleFastContinuous(reader);   
                 delayMicroseconds(delay_time_us);
             }
+            state().endContinuous();
+        }
+
+        /// applies the OverrunPolicy after the indicated number of sample periods have been missed: returns false if the capture needs to be aborted
+        bool onOverrun(OverrunMonitor &monitor, uint32_t missed, uint32_t &next) {
+            monitor.addOverrun(missed);
+            switch(config.overrun_policy){
+                case OVERRUN_MARK_GAPS:
+                    // replace the missed samples, so that the time axis stays correct
+                    for (uint32_t j=0; j<missed; j++){
+                        state().write(config.gap_marker);
+                        monitor.advance(next);
+                    }
+                    monitor.addGap(missed);
+                    break;
+                case OVERRUN_REDUCE_RATE:
+                    if (monitor.isBacklogExceeded(missed) && monitor.canReduceRate()){
+                        monitor.addRateReduction();
+                        logWarning("overrun: sample rate reduced to %lu hz", monitor.sampleRate());
+                        next = cycleCount();
+                    }
+                    break;
+                case OVERRUN_ABORT:
+                    if (monitor.isBacklogExceeded(missed)){
+                        monitor.setAborted();
+                        logError("overrun: capture aborted after %lu missed samples", missed);
+                        state().compareAndSetStatus(TRIGGERED, STOPPED);
+                        return false;
+                    }
+                    break;
+                default:
+                    // we take the late samples back to back
+                    break;
+            }
+            return true;
+        }
+
+        /// Continuous capturing at max speed
+        template <class Reader>
+        void loopAllContinousMaxSpeed(Reader &reader) {
+            logDebug("captureAllContinousMaxSpeed");
+            while(!isCancelled()){
+                for (int j=0; j<CANCEL_CHECK_INTERVAL; j++){
+                    captureSampleFastContinuous(reader);   
+                }
+            }
+            state().endContinuous();
+        }
+
+        /// Capturing at max speed with time stamps until the requested time span is covered or the buffer is full
+        template <class Reader>
+        void loopAllTimestamped(Reader &reader) {
+            logDebug("captureAllTimestamped %ld entries", config.read_count);
+            SampleTimestamps &timestamps = *timestamps_ptr;
+            timestamps.clear();
+            buffer().clear();
+            size_t max_samples = buffer().size();
+            if (max_samples > timestamps.size() * TIMESTAMP_BLOCK_SIZE){
+                max_samples = timestamps.size() * TIMESTAMP_BLOCK_SIZE;
+            }
+            max_samples -= max_samples % TIMESTAMP_BLOCK_SIZE;
+            // requested time span in cycleCount() ticks
+            uint64_t time_span = (uint64_t) config.read_count * cycleFrequency() / config.frequecy_value;
+            uint64_t elapsed = 0;
+            size_t samples = 0;
+            uint32_t last = cycleCount();
+            while(samples < max_samples && elapsed < time_span && !isCancelled()){
+                for (int j=0; j<TIMESTAMP_BLOCK_SIZE; j++){
+                    captureSampleFast(reader);
+                }
+                uint32_t now = cycleCount();
+                timestamps.add(now - last);
+                elapsed += now - last;
+                last = now;
+                samples += TIMESTAMP_BLOCK_SIZE;
+            }
+            logDebug("captureAllTimestamped: %lu samples in %lu ticks", samples, (unsigned long) elapsed);
+        }
+
+        /// Segmented capturing: the requested number of samples is split into segment_count segments. After each segment 
+        /// we immediately wait for the next trigger edge and record the trigger time.
+        template <class Reader>
+        void loopAllSegmented(Reader &reader, unsigned long delay_time_us) {
+            CaptureSegments &segments = state().segments();
+            uint16_t segment_count = config.segment_count > MAX_SEGMENTS ? MAX_SEGMENTS : config.segment_count;
+            size_t read_count = config.read_count;
+            size_t segment_size = read_count / segment_count;
+            logDebug("captureAllSegmented %u segments with %lu entries", segment_count, segment_size);
+            segments.clear(segment_size);
+            segments.add(cycleCount());
+            buffer().clear();
+            for (uint16_t segment=0; segment<segment_count; segment++){
+                if (segment>0){
+                    if (!waitForTriggerEdge(reader)) return;
+                    segments.add(cycleCount());
+                }
+                // the last segment also gets the remaining samples
+                size_t end = segment==segment_count-1 ? read_count : (segment + 1) * segment_size;
+                uint16_t check = 0;
+                while(buffer().available() < end){
+                    captureSampleFast(reader);
+                    if (delay_time_us>0){
+                        delayMicroseconds(delay_time_us);
+                    }
+                    if (++check==CANCEL_CHECK_INTERVAL){
+                        check = 0;
+                        if (isCancelled()) return;
+                    }
+                }
+            }
+            segments.logResult();
+        }
+
+        /// waits until the trigger condition is not met any more and then until it is met again: returns false if the capturing has been cancelled
+        template <class Reader>
+        bool waitForTriggerEdge(Reader &reader) {
+            return waitForTriggerCondition(reader, false) && waitForTriggerCondition(reader, true);
+        }
+
+        /// waits until the trigger condition has the indicated result: returns false if the capturing has been cancelled
+        template <class Reader>
+        bool waitForTriggerCondition(Reader &reader, bool met) {
+            uint16_t check = 0;
+            while ((((config.trigger_values ^ reader.readAll()) & config.trigger_mask) == 0) != met){
+                if (++check==CANCEL_CHECK_INTERVAL){
+                    check = 0;
+                    if (isCancelled()) return false;
+                }
+            }
+            return true;
+        }
+
+        /// Capturing of requested number of examples into the buffer which records the interval of the last sample of 
+        /// every stride samples: so a single gap is not averaged over the stride. As in loopAll() and loopAllMaxSpeed() we 
+        /// check for a cancellation after each sample only if we delay anyway
+        template <class Reader>
+        void loopAllProfiled(Reader &reader, unsigned long delay_time_us) {
+            logDebug("captureAllProfiled");
+            JitterProfiler &profiler = *jitter_profiler_ptr;
+            profiler.clear();
+            uint16_t stride = profiler.stride();
+            uint16_t count = 0;
+            uint16_t check = 0;
+            uint16_t check_interval = delay_time_us>0 ? 1 : CANCEL_CHECK_INTERVAL;
+            size_t read_count = config.read_count;
+            uint32_t last = cycleCount();
+            while(buffer().available() < read_count){
+                captureSampleFast(reader);
+                if (delay_time_us>0){
+                    delayMicroseconds(delay_time_us);
+                }
+                if (++count==stride){
+                    uint32_t now = cycleCount();
+                    profiler.add(now - last);
+                    last = now;
+                    count = 0;
+                } else if (count==stride-1){
+                    // start of the measured sample
+                    last = cycleCount();
+                }
+                if (++check==check_interval){
+                    check = 0;
+                    if (isCancelled()) break;
+                }
+            }
+            profiler.logResult();
         }
 
-        /// Continuous capturing at max speed
-        void captureAllContinousMaxSpeed() {
-            log("captureAllContinousMaxSpeed");
-            while(la_state.status_value == TRIGGERED){
-                captureSampleFastContinuous();   
+        /// starts the capturing of the data: the source of the samples is selected only once
+        void capture(bool is_max_speed) {
+            if (isTestPattern()){
+                capture(state().testPatternGenerator(), is_max_speed);
+            } else {
+                capture(pinReader(), is_max_speed);
             }
         }
 
-        /// captures one singe entry for all pins and writes it to the buffer
-        void captureSampleFast() {
-            buffer_ptr->write(pin_reader_ptr->readAll());            
-        }
-
-        /// captures one singe entry for all pins and writes it to output stream
-        void captureSampleFastContinuous() {
-            write(pin_reader_ptr->readAll());            
-        }
+        /// starts the capturing of the data with the indicated source of the samples
+        template <class Reader>
+        void capture(Reader &reader, bool is_max_speed) {
+            logDebug("capture is_max_speed: %s", is_max_speed ? "true":"false");
+            // waiting for trigger
+            if (config.trigger_mask && !waitForTrigger(reader)) {
+                logDebug("cancelled");
+                return;
+            } 
+            if (!onTriggered()){
+                return;
+            }
 
-        /// captures one single entry for all pins and provides the result - used by the trigger
-        PinBitArray captureSample() {
-            // actual state
-            PinBitArray actual = pin_reader_ptr->readAll();
+            // below the max speed we oversample and reduce the samples of each period to a single value
+            if (config.decimation_mode!=DECIMATION_OFF && !is_max_speed && config.frequecy_value>0){
+                beginIsolation();
+                loopAllDecimated(reader);
+                endIsolation();
+                if (!config.is_continuous_capture) onCaptured();
+                return;
+            }
 
-            // buffer single capture cycle
-            if (la_state.is_continuous_capture) {
-                write(actual);
-            } else if (la_state.status_value==TRIGGERED) {
-                buffer_ptr->write(actual);
+            // Start Capture
+            if (config.is_continuous_capture){
+                if (is_max_speed){
+                    loopAllContinousMaxSpeed(reader);
+                } else {
+                    loopAllContinous(reader);
+                }
+                return;
             } 
-            return actual;          
+            
+            beginIsolation();
+            if (timestamps_ptr!=nullptr){
+                loopAllTimestamped(reader);
+            } else if (is_burst && buffer().available()==0){
+                // no pre-trigger samples: the buffer memory is filled from the start
+                loopAllBurst();
+            } else if (config.segment_count > 1 && config.trigger_mask){
+                loopAllSegmented(reader, is_max_speed ? 0 : config.delay_time_us);
+            } else if (is_max_speed){
+                loopAllMaxSpeed(reader);
+            } else { 
+                loopAll(reader);
+            }
+            endIsolation();
+            onCaptured();
         }
 
+        /// waits until the trigger condition is met: returns false if the capturing has been cancelled
+        template <class Reader>
+        bool waitForTrigger(Reader &reader) {
+            logDebug("waiting for trigger");
+            if (TRIGGER_TEST_PIN >= 0){
+                pinMode(TRIGGER_TEST_PIN, OUTPUT);
+                digitalWrite(TRIGGER_TEST_PIN, LOW);
+            }
+            if (!detectTrigger(reader)){
+                return false;
+            }
+            // the delay from the trigger edge to this edge is the trigger latency
+            if (TRIGGER_TEST_PIN >= 0){
+                digitalWrite(TRIGGER_TEST_PIN, HIGH);
+            }
+            return true;
+        }
+
+        /// waits with the interrupt or by polling until the trigger condition is met: returns false if the capturing has been cancelled
+        template <class Reader>
+        bool detectTrigger(Reader &reader) {
+            // a single pin trigger can be handled by an interrupt
+            if (trigger_interrupt_ptr!=nullptr && config.test_pattern==TEST_PATTERN_OFF && (config.trigger_mask & (config.trigger_mask - 1))==0){
+                uint8_t pin = state().pin_start + __builtin_ctz(config.trigger_mask);
+                if (trigger_interrupt_ptr->begin(pin, config.trigger_values & config.trigger_mask)){
+                    bool result = waitForTriggerInterrupt();
+                    trigger_interrupt_ptr->end();
+                    return result;
+                }
+            }
+            uint16_t check = 0;
+            while ((config.trigger_values ^ captureSample(reader)) & config.trigger_mask){
+                if (++check==CANCEL_CHECK_INTERVAL){
+                    check = 0;
+                    if (isCancelled()) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
 
-    protected:
-        uint64_t max_frequecy_value;  // in hz
-        uint64_t max_frequecy_threshold;  // in hz
+        /// sleeps until the trigger interrupt has been raised: we check the level after the interrupt has been activated, so that we do not miss any edge
+        bool waitForTriggerInterrupt() {
+            // the interrupt is only used w/o test pattern
+            PinReader &reader = pinReader();
+            while ((config.trigger_values ^ reader.readAll()) & config.trigger_mask){
+                if (trigger_interrupt_ptr->wait(TRIGGER_WAIT_TIMEOUT_US)){
+                    return true;
+                }
+                if (isCancelled()){
+                    return false;
+                }
+            }
+            return true;
+        }
 
-        /// starts the capturing of the data
-        void capture(bool is_max_speed) {
-            log("capture is_max_speed: %s", is_max_speed ? "true":"false");
-            // waiting for trigger
-            if (la_state.trigger_mask) {
-                log("waiting for trigger");
-                while ((la_state.trigger_values ^ captureSample()) & la_state.trigger_mask)
-                    ;
-            } 
-            la_state.setStatus(TRIGGERED);
-            log("triggered");
+        /// changes the status to TRIGGERED and removes the unnecessary entries from the buffer: returns false if the capturing has been cancelled
+        bool onTriggered() {
+            // we only continue if nobody has stopped or re-armed the capturing in the meantime
+            if (isCancelled() || !state().compareAndSetStatus(ARMED, TRIGGERED)){
+                logDebug("cancelled");
+                return false;
+            }
+            logDebug("triggered");
 
             // remove unnecessary entries from buffer based on delayCount & readCount
-            long keep = la_state.read_count - la_state.delay_count;   
-            if (keep > 0 && buffer_ptr->available()>keep)  {
-                log("keeping last %ld entries",keep);
-                buffer_ptr->clear(buffer_ptr->available() - keep);
+            long keep = config.read_count - config.delay_count;   
+            if (keep > 0 && buffer().available()>keep)  {
+                logDebug("keeping last %ld entries",keep);
+                buffer().clear(buffer().available() - keep);
             } else if (keep < 0)  {
-                log("ignoring first %ld entries",abs(keep));
-                buffer_ptr->clear(buffer_ptr->available() + abs(keep));
+                logDebug("ignoring first %ld entries",abs(keep));
+                buffer().clear(buffer().available() + abs(keep));
             } else if (keep==0l){
-                log("starting with clean buffer");
-                buffer_ptr->clear();
+                logDebug("starting with clean buffer");
+                buffer().clear();
             } 
+            return true;
+        }
 
-            // Start Capture
-            if (is_max_speed){
-                if (la_state.is_continuous_capture){
-                    captureAllContinousMaxSpeed();
-                } else {
-                    captureAllMaxSpeed();
-                    dumpData();
-                    log("capture-done: %lu",buffer_ptr->available());
-                    setStatus(STOPPED);
-                }
-            } else { 
-                if (la_state.is_continuous_capture){
-                    captureAllContinous();
-                } else {
-                    captureAll();
-                    dumpData();
-                    log("capture-done: %lu",buffer_ptr->available());
-                    setStatus(STOPPED);
-                }
+        /// dumps the captured data and changes the status to STOPPED 
+        void onCaptured() {
+            state().performance_counters.onCaptureEnd(buffer().available());
+            if (isCancelled()){
+                logDebug("cancelled");
+                return;
+            }
+            // persist the capture, so that it is not lost if nobody is listening
+            if (state().storage_ptr!=nullptr && !state().saveSnapshot(state().storage_name, config)){
+                logError("saving of the capture failed");
+            }
+            if (timestamps_ptr!=nullptr){
+                dumpDataResampled();
+            } else {
+                dumpData();
             }
+            logDebug("capture-done: %lu",buffer().available());
+            state().compareAndSetStatus(TRIGGERED, STOPPED);
         }
 
         /// Provides access to the SUMP command stream
         virtual Stream &stream() {
-            return *stream_ptr;
+            return state().stream();
         }
 
        
         /// dumps the caputred data to the recording device
         void dumpData() {
-            log("dumpData: %lu",buffer_ptr->available());
-            // buffered write 
-            uint32_t tmp[DUMP_RECORD_SIZE];
-            stream_ptr->setTimeout(10000);
-            while(buffer_ptr->available()){
-                size_t len = buffer_ptr->readBuffer(tmp, DUMP_RECORD_SIZE);
-                write(tmp, len);
+            logDebug("dumpData: %lu",buffer().available());
+            state().stream().setTimeout(10000);
+            Decoder *decoder = state().decoder();
+            SignalStatistics *statistics = state().statistics();
+            if (state().isFramedDump() && decoder==nullptr){
+                dumpDataFramed(statistics);
+                return;
+            }
+            state().beginCompressed();
+            // we process the buffer w/o copying it
+            while(buffer().available()){
+                size_t len = buffer().available();
+                const PinBitArray *samples = buffer().readPtr(len);
+                if (statistics!=nullptr){
+                    statistics->update(samples, len);
+                }
+                if (decoder!=nullptr){
+                    // send the decoded frames instead of the samples
+                    decoder->decode(samples, len);
+                } else {
+                    // the buffer is not overwritten before the flush below
+                    state().write(samples, len, true);
+                }
+                buffer().clear(len);
+            }
+            if (state().isCompressed()){
+                state().endCompressed();
             }
             // flush final records - for backward compatibility 
-            stream_ptr->flush();
-            log("dumpData-end");
+            state().stream().flush();
+            state().performance_counters.onDumpEnd();
+            if (PerformanceCounters::isActive()) {
+                state().performance_counters.logResult();
+            }
+            logDebug("dumpData-end");
+        }
+
+        /// dumps the captured data as frames with a CRC: the buffer is cleared when the host has acknowledged the dump
+        void dumpDataFramed(SignalStatistics *statistics) {
+            if (statistics!=nullptr){
+                size_t pos = 0;
+                while (pos < buffer().available()){
+                    size_t len = buffer().available() - pos;
+                    statistics->update(buffer().peekPtr(pos, len), len);
+                    pos += len;
+                }
+            }
+            state().writeFramedDump();
+            state().stream().flush();
+            state().performance_counters.onDumpEnd();
+            if (PerformanceCounters::isActive()) {
+                state().performance_counters.logResult();
+            }
+            logDebug("dumpDataFramed-end");
+        }
+
+        /// dumps read_count samples on the exact grid of the requested frequency: we use the time stamps to determine 
+        /// the captured sample for each output sample, so samples are repeated or dropped as needed
+        void dumpDataResampled() {
+            logDebug("dumpDataResampled: %lu", buffer().available());
+            SampleTimestamps &timestamps = *timestamps_ptr;
+            PinBitArray out[DUMP_RECORD_SIZE];
+            const size_t out_size = DUMP_RECORD_SIZE;
+            size_t out_pos = 0;
+            size_t available = buffer().available();
+            // output period in 1/256 ticks
+            uint64_t period = ((uint64_t)cycleFrequency() << 8) / config.frequecy_value;
+            uint64_t block_start = 0;
+            size_t block = 0;
+            PinBitArray last = available > 0 ? buffer().peek(0) : 0;
+            state().stream().setTimeout(10000);
+            state().beginCompressed();
+            for (long k=0; k<config.read_count; k++){
+                uint64_t time = k * period;
+                // find the block which contains the time
+                while (block < timestamps.available() && time >= block_start + ((uint64_t)timestamps.duration(block) << 8)){
+                    block_start += (uint64_t)timestamps.duration(block) << 8;
+                    block++;
+                }
+                if (block < timestamps.available()){
+                    uint64_t duration = (uint64_t)timestamps.duration(block) << 8;
+                    size_t idx = block * TIMESTAMP_BLOCK_SIZE;
+                    if (duration > 0) idx += (time - block_start) * TIMESTAMP_BLOCK_SIZE / duration;
+                    if (idx < available) last = buffer().peek(idx);
+                }
+                // if the time is after the last captured sample we repeat the last value
+                out[out_pos++] = last;
+                if (out_pos == out_size){
+                    state().write(out, out_pos);
+                    out_pos = 0;
+                }
+            }
+            if (out_pos > 0){
+                state().write(out, out_pos);
+            }
+            if (state().isCompressed()){
+                state().endCompressed();
+            }
+            buffer().clear();
+            state().stream().flush();
+            state().performance_counters.onDumpEnd();
+            logDebug("dumpDataResampled-end");
         }
 };
 
@@ -528,20 +1899,17 @@ class LogicAnalyzer {
     public:
         /// Default Constructor
         LogicAnalyzer() {            
-            log("LogicAnalyzer");
+            logDebug("LogicAnalyzer");
         }
 
         /// Destructor
         ~LogicAnalyzer() {
-            log("~LogicAnalyzer");
-            if (buffer_ptr!=nullptr)  {
-                delete buffer_ptr;
-                buffer_ptr = nullptr;
-            }
-            if (pin_reader_ptr!=nullptr){
-                delete pin_reader_ptr;
-                pin_reader_ptr = nullptr;
+            logDebug("~LogicAnalyzer");
+            if (la_state.buffer_ptr!=nullptr && is_buffer_owned)  {
+                delete la_state.buffer_ptr;
             }
+            la_state.buffer_ptr = nullptr;
+            delete reader_ptr;
         }
 
         /**
@@ -557,8 +1925,12 @@ class LogicAnalyzer {
          * @param setup_pins Change the pin mode to input 
          */
         void begin(Stream &procesingStream, AbstractCapture *capture, uint32_t maxCaptureSize, uint8_t pinStart=0, uint8_t numberOfPins=8, bool setup_pins=false){
-            log("begin");
-            stream_ptr = &procesingStream;
+            logDebug("begin");
+            la_state.stream_ptr = &procesingStream;
+            la_state.transport_ptr = nullptr;
+            if (la_state.decoder_ptr!=nullptr && !la_state.decoder_ptr->hasOutput()){
+                la_state.decoder_ptr->setOutput(procesingStream);
+            }
             this->capture_ptr = capture;
 
             la_state.max_capture_size = maxCaptureSize;
@@ -570,17 +1942,16 @@ class LogicAnalyzer {
             // set initial status
             setStatus(STOPPED);
 
-            if (pin_reader_ptr==nullptr){
-                pin_reader_ptr = new PinReader(pinStart);
-            }
+            la_state.pin_reader = PinReader(pinStart);
 
-            if (do_allocate_buffer && buffer_ptr==nullptr) {
-                buffer_ptr = new RingBuffer(maxCaptureSize);
+            if (do_allocate_buffer && la_state.buffer_ptr==nullptr) {
+                la_state.buffer_ptr = new RingBuffer(maxCaptureSize, *allocator_ptr);
+                is_buffer_owned = true;
             }
 
             // assign state to capture 
             if (capture!=nullptr) {
-                capture->setLogicAnalyzer(*this);
+                capture->setLogicAnalyzer(*this, la_state);
             }
 
             // by default the pins are in read mode - so it is usually not really necesarry to set the mode to input
@@ -591,7 +1962,13 @@ class LogicAnalyzer {
                 }
             }
     
-            log("begin-end");
+            logDebug("begin-end");
+        }
+
+        /// Starts the processing with a Transport (e.g. the TCPServerTransport): the dump is sent with its non-blocking zero copy send queue
+        void begin(Transport &transport, AbstractCapture *capture, uint32_t maxCaptureSize, uint8_t pinStart=0, uint8_t numberOfPins=8, bool setup_pins=false){
+            begin((Stream&)transport, capture, maxCaptureSize, pinStart, numberOfPins, setup_pins);
+            la_state.transport_ptr = &transport;
         }
 
         /// Provides the GPIO number of the start pin which is used for capturing
@@ -606,31 +1983,61 @@ class LogicAnalyzer {
 
         /// provides command output stream of capturing divice
         Stream &stream() {
-            return *(stream_ptr);
+            return *(la_state.stream_ptr);
         }
 
         /// provides the actual Status
         Status status() {
-            return la_state.status_value;
+            return la_state.status();
         }
 
-        /// Defines the actual status
+        /// Defines the actual status: ARMED and TRIGGERED publish the actual parameters for the capturing
         void setStatus(Status status){
+            if (status!=STOPPED){
+                la_state.publishConfig();
+            }
             la_state.setStatus(status);
         }
 
         /// Provides access to the buffer
         RingBuffer &buffer() {
-            return *(buffer_ptr);
+            return *(la_state.buffer_ptr);
+        }
+
+        /// Splits the capture into the indicated number of segments: after each segment we re-arm immediately and wait for the next trigger
+        void setSegmentCount(uint16_t count){
+            la_state.segment_count = count == 0 ? 1 : count > MAX_SEGMENTS ? MAX_SEGMENTS : count;
+        }
+
+        /// Provides the number of segments
+        uint16_t segmentCount() {
+            return la_state.segment_count;
+        }
+
+        /// Provides the trigger times of the last segmented capture
+        CaptureSegments &segments() {
+            return la_state.capture_segments;
+        }
+
+        /// Provides the performance counters of the last capture: they are only updated if PERFORMANCE_COUNTERS is active
+        PerformanceCounters &performanceCounters() {
+            return la_state.performance_counters;
         }
 
-        /// process the next available command - Call this function from your Arduino loop()!
+        /// process the next available command and the next burst of a cooperative capture - Call this function from your Arduino loop()!
         void processCommand(){
             if (hasCommand()){
                 int cmd = command();
-                log("processCommand %d", cmd);
+                logDebug("processCommand %d", cmd);
                 processCommand(cmd);
             }
+            if (capture_ptr!=nullptr){
+                capture_ptr->step();
+            }
+            // the compressed blocks of a continuous capture are encoded here and not in the sampling loop
+            la_state.writePendingBlock();
+            processEvents();
+            processLog();
         }
 
         /// provides the trigger values
@@ -641,7 +2048,7 @@ class LogicAnalyzer {
         /// defines the trigger values
         void setTriggerValues(PinBitArray values){
             la_state.trigger_values = values;
-            log("--> setTriggerValues: %u", (uint32_t) values);
+            logDebug("--> setTriggerValues: %u", (uint32_t) values);
             raiseEvent(TRIGGER_VALUES);
         } 
 
@@ -653,7 +2060,7 @@ class LogicAnalyzer {
         /// defines the trigger mask
         void setTriggerMask(PinBitArray values){
             la_state.trigger_mask = values;
-            log("--> setTriggerValues: %u", (uint32_t) values);
+            logDebug("--> setTriggerValues: %u", (uint32_t) values);
             raiseEvent(TRIGGER_MASK);
         } 
 
@@ -674,7 +2081,7 @@ class LogicAnalyzer {
 
         /// defines the delay count
         void setDelayCount(int count){
-            log("--> setDelayCount: %d", count);
+            logDebug("--> setDelayCount: %d", count);
             la_state.delay_count = count;
         }
 
@@ -691,9 +2098,9 @@ class LogicAnalyzer {
         /// defines the caputring frequency
         void setCaptureFrequency(uint64_t value){
             la_state.frequecy_value = value;
-            log("--> setCaptureFrequency: %lu", la_state.frequecy_value);
+            logDebug("--> setCaptureFrequency: %lu", la_state.frequecy_value);
             la_state.delay_time_us = (1000000.0 / value );
-            log("--> delay_time_us: %lu", la_state.delay_time_us);
+            logDebug("--> delay_time_us: %lu", la_state.delay_time_us);
             raiseEvent(CAPTURE_FREQUNCY);
         }
 
@@ -707,34 +2114,268 @@ class LogicAnalyzer {
             la_state.is_continuous_capture = cont;
         }
 
-        /// defines a event handler that gets notified on some defined events
+        /// Activates the flight recorder mode: the buffer is filled continuously while no capture is active (see Capture::record()) 
+        /// and an ARM or snapshot() dumps the last readCount() samples immediately. The actual parameters are published for 
+        /// the recording: later changes become active with the next ARM or snapshot.
+        void setFlightRecorder(bool active){
+            la_state.is_flight_recorder = active;
+            la_state.publishConfig();
+        }
+
+        /// Returns true if the flight recorder mode is active
+        bool isFlightRecorder() {
+            return la_state.is_flight_recorder;
+        }
+
+        /// Flight recorder mode: freezes the last readCount() samples and dumps them
+        void snapshot() {
+            if (!la_state.is_flight_recorder){
+                logWarning("snapshot: flight recorder is not active");
+                return;
+            }
+            logDebug("snapshot");
+            // we keep the recorded data
+            setStatus(ARMED);
+            if (is_capture_on_arm){
+                capture(); 
+            }
+        }
+
+        /// Oversamples at max speed below the max frequency and reduces each output period to a single value: 
+        /// DECIMATION_MAJORITY is the noise filter and DECIMATION_GLITCH makes any transition in the period visible
+        void setDecimation(DecimationMode mode){
+            la_state.decimation_mode = mode;
+        }
+
+        /// Provides the actual decimation mode
+        DecimationMode decimation() {
+            return la_state.decimation_mode;
+        }
+
+        /// Defines the enabled groups of 8 channels (bit 0 = channels 0-7) which are sent in the dump: this is usually set by the SUMP flags
+        void setChannelGroups(uint8_t groups){
+            la_state.channel_groups = groups;
+        }
+
+        /// Provides the enabled groups of 8 channels
+        uint8_t channelGroups() {
+            return la_state.channel_groups;
+        }
+
+        /// Replaces the pins by the indicated test pattern: TEST_PATTERN_OFF uses the pins unless the SUMP test mode flag is set
+        void setTestPattern(TestPatternMode mode){
+            la_state.test_pattern_mode = mode;
+        }
+
+        /// Provides the test pattern which was defined with setTestPattern()
+        TestPatternMode testPattern() {
+            return la_state.test_pattern_mode;
+        }
+
+        /// Sends the dump in frames with a sequence number and a CRC32, so that the host can request corrupted blocks again. 
+        /// If not active, the host can request it with the SUMP_FRAMED_DUMP command
+        void setFramedDump(FramedDump &dump, bool active=true){
+            la_state.framed_dump_ptr = &dump;
+            la_state.is_framed_dump = active;
+        }
+
+        /// Deactivates the framed dump
+        void clearFramedDump(){
+            la_state.framed_dump_ptr = nullptr;
+            la_state.is_framed_dump = false;
+        }
+
+        /// Returns true if the dump is sent in frames
+        bool isFramedDump() {
+            return la_state.isFramedDump();
+        }
+
+        /// Provides the FramedDump or nullptr
+        FramedDump *framedDump() {
+            return la_state.framedDump();
+        }
+
+        /// Defines the codec for the compression of the dumps, the continuous captures and the snapshots with SNAPSHOT_BLOCK. 
+        /// If not active, the host can request the compression with the SUMP_COMPRESSED_DUMP command. The blocks of a continuous 
+        /// capture are encoded and sent by processCommand(), so call it on the other core
+        void setBlockCodec(BlockCodec &codec, bool active=true){
+            la_state.codec_ptr = &codec;
+            la_state.is_compressed = active;
+        }
+
+        /// Deactivates the compression
+        void clearBlockCodec(){
+            la_state.codec_ptr = nullptr;
+            la_state.is_compressed = false;
+        }
+
+        /// Returns true if the samples are sent as compressed blocks
+        bool isCompressed() {
+            return la_state.isCompressed();
+        }
+
+        /// Defines how the continuous capture reacts if the output can't keep up: with OVERRUN_MARK_GAPS the missed samples are replaced by the gapMarker
+        void setOverrunPolicy(OverrunPolicy policy, PinBitArray gapMarker=0){
+            la_state.overrun_policy = policy;
+            la_state.gap_marker = gapMarker;
+        }
+
+        /// Provides the actual overrun policy
+        OverrunPolicy overrunPolicy() {
+            return la_state.overrun_policy;
+        }
+
+        /// Provides the overrun counters of the last continuous capture
+        OverrunMonitor &overruns() {
+            return la_state.overrun_monitor;
+        }
+
+        /// Activates the persistence of the captures: each capture is written to the storage before it is dumped
+        void setStorage(CaptureStorage &storage, const char *name=STORAGE_DEFAULT_NAME, SnapshotEncoding encoding=SNAPSHOT_RLE){
+            la_state.storage_ptr = &storage;
+            la_state.storage_name = name;
+            la_state.storage_encoding = encoding;
+        }
+
+        /// Deactivates the persistence of the captures
+        void clearStorage(){
+            la_state.storage_ptr = nullptr;
+        }
+
+        /// Writes the actual buffer to the storage
+        bool save(const char *name=STORAGE_DEFAULT_NAME){
+            return la_state.saveSnapshot(name, la_state.armedConfig());
+        }
+
+        /// Sends the stored capture to the SUMP stream in the format which the host expects: returns the number of samples
+        size_t replay(const char *name=nullptr){
+            if (la_state.storage_ptr==nullptr){
+                logWarning("replay: no storage");
+                return 0;
+            }
+            if (status()!=STOPPED){
+                logWarning("replay: not possible during a capture");
+                return 0;
+            }
+            // the reader needs several KB: so it is allocated on the heap with the first replay and not on the stack
+            if (reader_ptr==nullptr){
+                reader_ptr = new SnapshotReader(*la_state.storage_ptr);
+            }
+            SnapshotReader &reader = *reader_ptr;
+            reader.setStorage(*la_state.storage_ptr);
+            if (!reader.begin(name==nullptr ? la_state.storage_name : name)){
+                return 0;
+            }
+            // we use the channel groups and the compression of the actual session
+            la_state.publishConfig();
+            const CaptureConfig &config = la_state.armedConfig();
+            la_state.beginCapture(config);
+            SnapshotHeader &header = reader.header();
+            logDebug("replay: %lu samples", header.sample_count);
+            size_t result;
+            if (header.channel_groups==la_state.sampleEncoder().groups() && header.sample_count==(uint32_t)config.read_count
+                && !la_state.isCompressed() && !la_state.isFramedDump()){
+                // the stored data has already the requested format
+                result = reader.replay(stream());
+            } else {
+                result = replayConverted(reader, config.read_count);
+            }
+            stream().flush();
+            return result;
+        }
+
+        /// An ARM replays the stored capture instead of capturing new data
+        void setReplayOnArm(bool active){
+            is_replay_on_arm = active;
+        }
+
+        /// Activates an on device protocol decoder: instead of the samples we send the decoded frames. If the decoder has 
+        /// no output Stream, we use the stream of the LogicAnalyzer.
+        void setDecoder(Decoder &decoder){
+            if (!decoder.hasOutput() && la_state.stream_ptr!=nullptr){
+                decoder.setOutput(*la_state.stream_ptr);
+            }
+            la_state.decoder_ptr = &decoder;
+        }
+
+        /// Activates the calculation of the signal statistics of the captured data: available with statistics() or the vendor specific SUMP command 0x33
+        void setStatistics(SignalStatistics &statistics){
+            la_state.statistics_ptr = &statistics;
+        }
+
+        /// Deactivates the signal statistics
+        void clearStatistics(){
+            la_state.statistics_ptr = nullptr;
+        }
+
+        /// Provides the signal statistics or nullptr if they are not active
+        SignalStatistics *statistics() {
+            return la_state.statistics_ptr;
+        }
+
+        /// Deactivates the decoder: we send the samples again
+        void clearDecoder(){
+            la_state.decoder_ptr = nullptr;
+        }
+
+        /// defines a event handler that gets notified on some defined events: it replaces all other event handlers
+        /// and is called from processEvents() 
         void setEventHandler(EventHandler eh){
-            la_state.eventHandler = eh;
+            la_state.event_handler_count = 0;
+            addEventHandler(eh);
+        }
+
+        /// adds an additional event handler which is called from processEvents(): returns false if there are already MAX_EVENT_HANDLERS
+        bool addEventHandler(EventHandler eh){
+            if (la_state.event_handler_count>=MAX_EVENT_HANDLERS) return false;
+            la_state.event_handlers[la_state.event_handler_count++] = eh;
+            return true;
         }
 
-        /// Resets the status and buffer
+        /// defines a event handler which is called immediately (e.g. on the capturing core) - it must only execute 
+        /// some short logic like cancelling a capture
+        void setSyncEventHandler(EventHandler eh){
+            la_state.sync_event_handler = eh;
+        }
+
+        /// Delivers the queued events to the event handlers - Call this function from your Arduino loop() or on any other core!
+        void processEvents() {
+            la_state.processEvents();
+        }
+
+        /// Resets the status and buffer: we only reset the buffer positions, so the time does not depend on the buffer size
         void clear(){
-            log("clear");
+            logDebug("clear");
+            la_state.cancel();
             setStatus(STOPPED);
-            if (buffer_ptr!=nullptr){
-                memset(buffer_ptr->data_ptr(),0x00, la_state.max_capture_size*sizeof(PinBitArray));
-                buffer_ptr->clear();
+            if (la_state.framed_dump_ptr!=nullptr){
+                la_state.framed_dump_ptr->end();
+            }
+            if (la_state.buffer_ptr!=nullptr){
+                la_state.buffer_ptr->clear();
             }
         }
 
         /// returns the max buffer size
         size_t size() {
-            return buffer_ptr == nullptr ? 0 : buffer_ptr->size();
+            return la_state.buffer_ptr == nullptr ? 0 : la_state.buffer_ptr->size();
         }
 
         /// returns the avialable buffer entries
         size_t available() {
-            return buffer_ptr == nullptr ? 0 : buffer_ptr->available();
+            return la_state.buffer_ptr == nullptr ? 0 : la_state.buffer_ptr->available();
+        }
+
+        /// Activate the logging by defining the logging output Stream: if deferred is true, the log records are queued and
+        /// only printed by processLog() (which is also called by processCommand())
+        void setLogger(Stream &logger, bool deferred=false){
+            loggerPtr() = &logger;
+            isLogDeferred() = deferred;
         }
 
-        /// Activate the logging by defining the logging output Stream
-        void setLogger(Stream &logger){
-            logger_ptr = &logger;
+        /// Prints the queued log records - Call this function from your Arduino loop() or on any other core!
+        void processLog() {
+            logic_analyzer::processLog();
         }
 
         /// Switch automatic capturing on ARMED status on/off 
@@ -753,6 +2394,20 @@ class LogicAnalyzer {
             do_allocate_buffer = do_allocate;
         }
 
+        /// Defines the Allocator which is used for the automatic buffer allocation (e.g. for PSRAM) - call before begin!
+        void setAllocator(Allocator &allocator){
+            allocator_ptr = &allocator;
+        }
+
+        /// Uses the buffer provided by the caller (e.g. backed by a static array) instead of allocating one - call before begin!
+        void setBuffer(RingBuffer &buffer){
+            if (la_state.buffer_ptr!=nullptr && is_buffer_owned){
+                delete la_state.buffer_ptr;
+            }
+            la_state.buffer_ptr = &buffer;
+            is_buffer_owned = false;
+        }
+
         /// starts the capturing
         void capture() {
             if (capture_ptr!=nullptr)
@@ -762,7 +2417,12 @@ class LogicAnalyzer {
 
     protected:
         bool is_capture_on_arm = true;
+        bool is_replay_on_arm = false;
         bool do_allocate_buffer = true;
+        bool is_buffer_owned = false;
+        Allocator *allocator_ptr = &defaultAllocator();
+        SnapshotReader *reader_ptr = nullptr;
+        LogicAnalyzerState la_state;
         uint64_t sump_reset_igorne_timeout=0;
         AbstractCapture *capture_ptr = nullptr;
         const char* description = "ARDUINO";
@@ -778,7 +2438,7 @@ class LogicAnalyzer {
 
         /// checks if there is a command available
         bool hasCommand() {
-            return stream_ptr->available() > 0;
+            return la_state.stream_ptr->available() > 0;
         }
 
         /// gets the next 1 byte command
@@ -853,7 +2513,7 @@ class LogicAnalyzer {
         *
         */
         void sendMetadata() {
-            log("sendMetadata");
+            logDebug("sendMetadata");
             write(0x01, description);
             write(0x02, firmware_version);
             // number of probes 
@@ -867,6 +2527,116 @@ class LogicAnalyzer {
             stream().flush();
         }
 
+        /**
+         * Vendor specific command which returns the performance counters of the last capture. The format is the same
+         * as for the metadata: 1 byte key followed by a 4 byte value and a final 0.
+         * 0x01 trigger wait us, 0x02 capture us, 0x03 dump us, 0x04 samples captured, 0x05 sample rate hz, 
+         * 0x06 bytes dumped, 0x07 write stalls, 0x08 overruns
+         */
+        void sendPerformanceCounters() {
+            logDebug("sendPerformanceCounters");
+            PerformanceCounters &pc = la_state.performance_counters;
+            write(0x01, pc.triggerWaitUs());
+            write(0x02, pc.captureTimeUs());
+            write(0x03, pc.dumpTimeUs());
+            write(0x04, pc.samples_captured);
+            write(0x05, pc.sampleRate());
+            write(0x06, pc.bytes_dumped);
+            write(0x07, pc.write_stalls);
+            write(0x08, pc.overruns);
+            stream().write((uint8_t)0x00);
+            stream().flush();
+        }
+
+        /// Vendor specific: sends the number of segments, the samples per segment and the trigger time in us of each segment
+        void sendSegments() {
+            logDebug("sendSegments");
+            CaptureSegments &segments = la_state.capture_segments;
+            write(0x01, segments.available());
+            write(0x02, segments.samplesPerSegment());
+            for (size_t j=0; j<segments.available(); j++){
+                write(0x03, segments.triggerTimeUs(j));
+            }
+            stream().write((uint8_t)0x00);
+            stream().flush();
+        }
+
+        /**
+         * Vendor specific command which returns the signal statistics in the metadata format: 0x01 number of samples,
+         * then for each channel 0x10 channel, 0x11 high samples, 0x12 rising edges, 0x13 falling edges, 0x14 min high 
+         * width, 0x15 max high width, 0x16 min low width, 0x17 max low width (in samples) and 0x18 frequency in hz
+         */
+        void sendStatistics() {
+            logDebug("sendStatistics");
+            SignalStatistics *statistics = la_state.statistics_ptr;
+            if (statistics!=nullptr){
+                write(0x01, statistics->size());
+                for (int ch=0; ch<la_state.pin_numbers && ch<SignalStatistics::CHANNELS; ch++){
+                    ChannelStatistics &stat = statistics->channel(ch);
+                    write(0x10, ch);
+                    write(0x11, stat.high_count);
+                    write(0x12, stat.rising_edges);
+                    write(0x13, stat.falling_edges);
+                    write(0x14, stat.min_high_width);
+                    write(0x15, stat.max_high_width);
+                    write(0x16, stat.min_low_width);
+                    write(0x17, stat.max_low_width);
+                    write(0x18, statistics->frequency(ch, la_state.armedConfig().frequecy_value));
+                }
+            }
+            stream().write((uint8_t)0x00);
+            stream().flush();
+        }
+
+        /**
+         * Vendor specific command which returns the overrun counters of the last continuous capture in the metadata format:
+         * 0x01 overruns, 0x02 late samples, 0x03 max backlog, 0x04 gap samples, 0x05 rate reductions, 0x06 sample rate in hz 
+         * and 0x07 aborted
+         */
+        void sendOverruns() {
+            logDebug("sendOverruns");
+            OverrunMonitor &monitor = la_state.overrun_monitor;
+            write(0x01, monitor.overruns);
+            write(0x02, monitor.late_samples);
+            write(0x03, monitor.max_backlog);
+            write(0x04, monitor.gap_samples);
+            write(0x05, monitor.rate_reductions);
+            write(0x06, monitor.sampleRate());
+            write(0x07, monitor.is_aborted);
+            stream().write((uint8_t)0x00);
+            stream().flush();
+        }
+
+        /// Loads the stored samples into the buffer and sends them like a capture: so they are converted to the actual channel 
+        /// groups, read count and compressed or framed dump. Missing samples are replaced by the last value.
+        size_t replayConverted(SnapshotReader &reader, size_t read_count) {
+            RingBuffer &buffer = *(la_state.buffer_ptr);
+            if (read_count > buffer.size()) read_count = buffer.size();
+            if (reader.header().sample_count != read_count){
+                logWarning("replay: %lu samples stored for %lu requested", (unsigned long) reader.header().sample_count, (unsigned long) read_count);
+            }
+            buffer.clear();
+            PinBitArray *samples = buffer.data_ptr();
+            size_t result = reader.read(samples, read_count);
+            reader.end();
+            PinBitArray last = result > 0 ? samples[result-1] : 0;
+            for (size_t j=result; j<read_count; j++){
+                samples[j] = last;
+            }
+            buffer.setAvailable(read_count);
+            if (la_state.isFramedDump()){
+                // the samples stay in the buffer until the host has acknowledged them
+                la_state.writeFramedDump();
+                return result;
+            }
+            la_state.write(samples, read_count);
+            if (la_state.isCompressed()){
+                la_state.endCompressed();
+            }
+            buffer.clear();
+            return result;
+        }
+
         /**
          *  Proposess the SUMP commands
          */
@@ -879,9 +2649,11 @@ class LogicAnalyzer {
                 case SUMP_RESET:
                     // debounce reset
                     if (millis()>sump_reset_igorne_timeout){
-                        log("=>SUMP_RESET");
+                        logDebug("=>SUMP_RESET");
                         setStatus(STOPPED);
                         clear();
+                        la_state.is_framed_requested = false;
+                        la_state.is_compressed_requested = false;
                         sump_reset_igorne_timeout = millis()+ 500;
                         raiseEvent(RESET);
                     }
@@ -891,7 +2663,7 @@ class LogicAnalyzer {
                  * Asks for device identification. The device will respond with four bytes. 
                  */
                 case SUMP_ID:
-                    log("=>SUMP_ID");
+                    logDebug("=>SUMP_ID");
                     stream().write(device_id, 4);
                     stream().flush();
                     break;
@@ -901,15 +2673,119 @@ class LogicAnalyzer {
                 * Check the function's comments below.
                 */
                 case SUMP_GET_METADATA:
-                    log("=>SUMP_GET_METADATA");
+                    logDebug("=>SUMP_GET_METADATA");
                     sendMetadata();
                     break;
 
+                /*
+                * Vendor specific: provides the performance counters of the last capture
+                */
+                case SUMP_GET_PERFORMANCE_COUNTERS:
+                    logDebug("=>SUMP_GET_PERFORMANCE_COUNTERS");
+                    sendPerformanceCounters();
+                    break;
+
+                /*
+                * Vendor specific: provides the trigger times of the last segmented capture
+                */
+                case SUMP_GET_SEGMENTS:
+                    logDebug("=>SUMP_GET_SEGMENTS");
+                    sendSegments();
+                    break;
+
+                /*
+                * Vendor specific: dumps the data which was recorded by the flight recorder
+                */
+                case SUMP_SNAPSHOT:
+                    logDebug("=>SUMP_SNAPSHOT");
+                    snapshot();
+                    break;
+
+                /*
+                * Vendor specific: provides the signal statistics of the last capture
+                */
+                case SUMP_GET_STATISTICS:
+                    logDebug("=>SUMP_GET_STATISTICS");
+                    sendStatistics();
+                    break;
+
+                /*
+                * Vendor specific: provides the overrun counters of the last continuous capture
+                */
+                case SUMP_GET_OVERRUNS:
+                    logDebug("=>SUMP_GET_OVERRUNS");
+                    sendOverruns();
+                    break;
+
+                /*
+                * Vendor specific: sends the stored capture
+                */
+                case SUMP_REPLAY:
+                    logDebug("=>SUMP_REPLAY");
+                    replay();
+                    break;
+
+                /*
+                * Vendor specific: the following dumps are sent in frames with a CRC until the next reset
+                */
+                case SUMP_FRAMED_DUMP:
+                    logDebug("=>SUMP_FRAMED_DUMP");
+                    if (la_state.framed_dump_ptr==nullptr){
+                        logWarning("framed dump: no FramedDump");
+                    }
+                    la_state.is_framed_requested = true;
+                    break;
+
+                /*
+                * Vendor specific: the following dumps and continuous captures are sent as compressed blocks until the next reset
+                */
+                case SUMP_COMPRESSED_DUMP:
+                    logDebug("=>SUMP_COMPRESSED_DUMP");
+                    if (la_state.codec_ptr==nullptr){
+                        logWarning("compression: no BlockCodec");
+                    }
+                    la_state.is_compressed_requested = true;
+                    break;
+
+                /*
+                * Vendor specific: the host has received all frames, so we can release the samples
+                */
+                case SUMP_FRAMED_ACK:
+                    logDebug("=>SUMP_FRAMED_ACK");
+                    if (la_state.isFramedDumpPending()){
+                        logDebug("--> retransmits: %lu", (unsigned long) la_state.framed_dump_ptr->retransmitCount());
+                        clear();
+                    }
+                    break;
+
+                /*
+                * Vendor specific: sends the frame with the indicated sequence number again
+                */
+                case SUMP_FRAMED_NAK: {
+                        Sump4ByteComandArg cmd = commandExt();
+                        uint32_t seq = cmd.get32();
+                        logDebug("=>SUMP_FRAMED_NAK %lu", (unsigned long) seq);
+                        if (la_state.isFramedDumpPending()){
+                            la_state.framed_dump_ptr->addRetransmit();
+                            la_state.writeFrame(seq > 0xFFFF ? 0xFFFF : seq);
+                            stream().flush();
+                        }
+                    }
+                    break;
+
                 /*
                 * Captures the data
                 */
                 case SUMP_ARM:
-                    log("=>SUMP_ARM");
+                    logDebug("=>SUMP_ARM");
+                    if (is_replay_on_arm){
+                        replay();
+                        break;
+                    }
+                    if (la_state.is_flight_recorder){
+                        snapshot();
+                        break;
+                    }
                     // clear current data
                     clear();
                     setStatus(ARMED);
@@ -923,7 +2799,7 @@ class LogicAnalyzer {
                 * we can just use it directly as our trigger mask.
                 */
                 case SUMP_TRIGGER_MASK:
-                    log("=>SUMP_TRIGGER_MASK");
+                    logDebug("=>SUMP_TRIGGER_MASK");
                     setTriggerMask(commandExtPinBitArray());
                     break;
 
@@ -932,14 +2808,14 @@ class LogicAnalyzer {
                 * defines whether we're looking for it to be high or low.
                 */
                 case SUMP_TRIGGER_VALUES:
-                    log("=>SUMP_TRIGGER_VALUES");
+                    logDebug("=>SUMP_TRIGGER_VALUES");
                     setTriggerValues(commandExtPinBitArray());
                     break;
 
 
                 /* read the rest of the command bytes but ignore them. */
                 case SUMP_TRIGGER_CONFIG: 
-                    log("=>SUMP_TRIGGER_CONFIG");
+                    logDebug("=>SUMP_TRIGGER_CONFIG");
                     commandExt();                     
                     break;
 
@@ -948,10 +2824,10 @@ class LogicAnalyzer {
                 * so that << 16 doesn't end up as zero.
                 */
                 case SUMP_SET_DIVIDER: {
-                        log("=>SUMP_SET_DIVIDER");
+                        logDebug("=>SUMP_SET_DIVIDER");
                         Sump4ByteComandArg cmd = commandExt();
                         uint32_t divider = cmd.get32();
-                        log("-divider: %lu\n", divider);
+                        logDebug("-divider: %lu\n", divider);
                         setupDelay(divider);
                     }
                     break;
@@ -968,21 +2844,31 @@ class LogicAnalyzer {
                 */
                 case SUMP_SET_READ_DELAY_COUNT: {
                         Sump4ByteComandArg cmd = commandExt();
-                        log("=>SUMP_SET_READ_DELAY_COUNT %02X %02X",cmd.get16(0),cmd.get16(1));
+                        logDebug("=>SUMP_SET_READ_DELAY_COUNT %02X %02X",cmd.get16(0),cmd.get16(1));
                         la_state.read_count = (cmd.get16(0)+1) * 4;
                         la_state.delay_count = (cmd.get16(1)+1) * 4;
-                        log("--> read_count: %d", la_state.read_count);
-                        log("--> delay_count: %d", la_state.delay_count);
+                        logDebug("--> read_count: %d", la_state.read_count);
+                        logDebug("--> delay_count: %d", la_state.delay_count);
                         raiseEvent(READ_DLEAY_COUNT);
                     }
                     break;
 
                 /* read the rest of the command bytes and check if RLE is enabled. */
                 case SUMP_SET_FLAGS: {
-                        log("=>SUMP_SET_FLAGS");
+                        logDebug("=>SUMP_SET_FLAGS");
                         Sump4ByteComandArg cmd =  commandExt();
                         la_state.is_continuous_capture = ((cmd.getPtr()[1] & 0B1000000) != 0);
-                        log("--> is_continuous_capture: %d\n", la_state.is_continuous_capture);
+                        la_state.is_test_mode = ((cmd.getPtr()[1] & 0B1000) != 0);
+                        la_state.channel_groups = SampleEncoder::groupsFromFlags(cmd.getPtr()[0]);
+                        // noise filter
+                        if (cmd.getPtr()[0] & 0B10){
+                            la_state.decimation_mode = DECIMATION_MAJORITY;
+                        } else if (la_state.decimation_mode==DECIMATION_MAJORITY){
+                            la_state.decimation_mode = DECIMATION_OFF;
+                        }
+                        logDebug("--> is_continuous_capture: %d\n", la_state.is_continuous_capture);
+                        logDebug("--> channel groups: %x", la_state.channel_groups);
+                        logDebug("--> test mode: %d", la_state.is_test_mode);
                         raiseEvent(FLAGS);
 
                     }
@@ -990,7 +2876,7 @@ class LogicAnalyzer {
 
                 /* ignore any unrecognized bytes. */
                 default:
-                    log("=>UNHANDLED command: %d", cmd);
+                    logDebug("=>UNHANDLED command: %d", cmd);
                     break;
                 
             };
@@ -7,6 +7,9 @@
  * 
  */
 
+// the network stack (e.g. lwIP) might already provide the conversion
+#ifndef htons
+
 #if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
 
 #define htons(x) x
@@ -23,3 +26,5 @@
 #define ntohl(x) htonl(x)
 
 #endif
+
+#endif
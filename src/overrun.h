@@ -0,0 +1,159 @@
+/**
+ * @file overrun.h
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Detection of overruns in continuous mode: if the output can't keep up, the writing blocks and the samples
+ * are taken too late. We detect this on the sample grid and apply a policy, so that the time axis is not silently
+ * corrupted.
+ */
+#pragma once
+
+#include "Arduino.h"
+#include "config.h"
+#include "logger.h"
+
+// Number of missed sample periods after which we reduce the rate or abort
+#ifndef OVERRUN_MAX_BACKLOG
+#define OVERRUN_MAX_BACKLOG 16
+#endif
+
+// Max number of rate reductions: afterwards we just catch up
+#ifndef OVERRUN_MAX_REDUCTIONS
+#define OVERRUN_MAX_REDUCTIONS 8
+#endif
+
+// Min sample period in cycleCount() ticks for the sample grid: with a coarser counter we just delay w/o overrun detection
+#ifndef OVERRUN_MIN_PERIOD
+#define OVERRUN_MIN_PERIOD 4
+#endif
+
+namespace logic_analyzer {
+
+/**
+ * Handling of overruns: CATCH_UP takes the late samples back to back, MARK_GAPS writes the gap marker for each missed
+ * sample, REDUCE_RATE halves the sampling rate and ABORT stops the capture
+ */
+enum OverrunPolicy : uint8_t {OVERRUN_CATCH_UP, OVERRUN_MARK_GAPS, OVERRUN_REDUCE_RATE, OVERRUN_ABORT};
+
+/**
+ * @brief Sample grid and overrun counters of the last continuous capture. A sample is late if it was taken one or more 
+ * sample periods after its time on the grid: the backlog is the number of missed periods and its max value is the 
+ * high-water mark. An overrun starts with the first late sample and ends when we are back on the grid.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class OverrunMonitor {
+    public:
+        /// resets all values: called at the start of the capture with the sampling rate in hz
+        void begin(uint32_t frequency, OverrunPolicy policy) {
+            *this = OverrunMonitor();
+            this->policy = policy;
+            setFrequency(frequency);
+        }
+
+        /// Moves the due time to the next sample: the remainder of the period in cycleCount() ticks is distributed, so 
+        /// that the average sampling rate is exact
+        inline void advance(uint32_t &due) {
+            due += period;
+            error += remainder;
+            if (error >= frequency){
+                error -= frequency;
+                due++;
+            }
+        }
+
+        /// Returns true if the cycleCount() is fine enough for the sample grid of the requested rate
+        bool isGridSupported() {
+            return period >= OVERRUN_MIN_PERIOD;
+        }
+
+        /// Determines the number of missed sample periods (backlog) for the sample which is due at the indicated time
+        inline uint32_t missed(uint32_t due) {
+            int32_t late = cycleCount() - due;
+            if (late < (int32_t)period){
+                backlog = 0;
+                return 0;
+            }
+            return late / period;
+        }
+
+        /// records a late sample with the indicated number of missed sample periods: a new overrun starts when we had no backlog
+        void addOverrun(uint32_t missed) {
+            if (backlog == 0) overruns++;
+            backlog = missed;
+            late_samples++;
+            if (missed > max_backlog) max_backlog = missed;
+        }
+
+        /// records the gap markers which replaced the missed samples: the backlog is gone
+        void addGap(uint32_t samples) {
+            gap_samples += samples;
+            backlog = 0;
+        }
+
+        /// records a halving of the sampling rate
+        void addRateReduction() {
+            rate_reductions++;
+            setFrequency(frequency / 2);
+            backlog = 0;
+        }
+
+        /// records the abort of the capture
+        void setAborted() {
+            is_aborted = true;
+        }
+
+        /// Returns true if the backlog is too big for REDUCE_RATE or ABORT
+        bool isBacklogExceeded(uint32_t missed) {
+            return missed >= OVERRUN_MAX_BACKLOG;
+        }
+
+        /// Returns true if the rate can still be reduced
+        bool canReduceRate() {
+            return rate_reductions < OVERRUN_MAX_REDUCTIONS && frequency > 1;
+        }
+
+        /// Returns true if we had any overruns
+        bool hasOverruns() {
+            return overruns > 0;
+        }
+
+        /// Actual sampling rate in hz
+        uint32_t sampleRate() {
+            return frequency;
+        }
+
+        /// Prints the summary to the logger
+        void logResult() {
+            if (!hasOverruns()){
+                logInfo("overruns: 0");
+                return;
+            }
+            logWarning("overruns: %lu / late samples: %lu / max backlog: %lu", overruns, late_samples, max_backlog);
+            logWarning("gap samples: %lu / rate reductions: %lu / sample rate hz: %lu / aborted: %d", gap_samples, rate_reductions, sampleRate(), is_aborted);
+        }
+
+        OverrunPolicy policy = OVERRUN_CATCH_UP;
+        uint32_t frequency = 0;
+        uint32_t period = 0;
+        uint32_t remainder = 0;
+        uint32_t error = 0;
+        uint32_t overruns = 0;
+        uint32_t backlog = 0;
+        uint32_t late_samples = 0;
+        uint32_t max_backlog = 0;
+        uint32_t gap_samples = 0;
+        uint32_t rate_reductions = 0;
+        bool is_aborted = false;
+
+    protected:
+        /// determines the sample period in cycleCount() ticks and its remainder
+        void setFrequency(uint32_t frequency) {
+            this->frequency = frequency == 0 ? 1 : frequency;
+            period = cycleFrequency() / this->frequency;
+            remainder = cycleFrequency() % this->frequency;
+            error = 0;
+        }
+};
+
+} // namespace
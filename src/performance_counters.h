@@ -0,0 +1,132 @@
+/**
+ * @file performance_counters.h
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Instrumentation of the capturing and dump: timestamps and counters which help to find out if a capture is
+ * limited by the sampling, the trigger or the transport. Define PERFORMANCE_COUNTERS as 1 to activate them: otherwise
+ * all updates are removed by the compiler.
+ */
+#pragma once
+
+#include "Arduino.h"
+#include "config.h"
+#include "logger.h"
+
+#ifndef PERFORMANCE_COUNTERS
+#define PERFORMANCE_COUNTERS 0
+#endif
+
+namespace logic_analyzer {
+
+/**
+ * @brief Performance Counters of the last capture. The timestamps are in cycleCount() ticks.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class PerformanceCounters {
+    public:
+        /// Returns true if the counters have been activated with PERFORMANCE_COUNTERS
+        static constexpr bool isActive() {
+            return PERFORMANCE_COUNTERS != 0;
+        }
+
+        /// resets all values: called when the capture is armed
+        void clear() {
+            if (isActive()) {
+                *this = PerformanceCounters();
+            }
+        }
+
+        /// records the arm time
+        inline void onArm() {
+            if (isActive()) {
+                clear();
+                arm_time = cycleCount();
+            }
+        }
+
+        /// records the time when the trigger was hit
+        inline void onTrigger() {
+            if (isActive()) trigger_time = cycleCount();
+        }
+
+        /// records the end of the capturing
+        inline void onCaptureEnd(uint32_t samples) {
+            if (isActive()) {
+                capture_end_time = cycleCount();
+                samples_captured = samples;
+            }
+        }
+
+        /// records the end of the dump
+        inline void onDumpEnd() {
+            if (isActive()) dump_end_time = cycleCount();
+        }
+
+        /// counts the samples which are written directly to the stream in continuous mode
+        inline void addSamples(uint32_t samples) {
+            if (isActive()) samples_captured += samples;
+        }
+
+        /// counts the bytes which were written to the stream
+        inline void addBytes(uint32_t bytes) {
+            if (isActive()) bytes_dumped += bytes;
+        }
+
+        /// counts a write which could not be completed in one call
+        inline void addWriteStall() {
+            if (isActive()) write_stalls++;
+        }
+
+        /// counts a sample which could not be written w/o blocking in continuous mode
+        inline void addOverrun() {
+            if (isActive()) overruns++;
+        }
+
+        /// Time between arm and trigger in microseconds
+        uint32_t triggerWaitUs() {
+            return toUs(trigger_time - arm_time);
+        }
+
+        /// Capturing time (from the trigger to the end of the capture) in microseconds
+        uint32_t captureTimeUs() {
+            return toUs(capture_end_time - trigger_time);
+        }
+
+        /// Dump time in microseconds
+        uint32_t dumpTimeUs() {
+            return toUs(dump_end_time - capture_end_time);
+        }
+
+        /// Effective sampling rate in hz
+        uint32_t sampleRate() {
+            uint32_t time_us = captureTimeUs();
+            return time_us == 0 ? 0 : 1000000.0 * samples_captured / time_us;
+        }
+
+        /// Prints the values to the logger
+        void logResult() {
+            logInfo("trigger wait us: %lu", triggerWaitUs());
+            logInfo("capture us: %lu / samples: %lu", captureTimeUs(), samples_captured);
+            logInfo("sample rate hz: %lu", sampleRate());
+            logInfo("dump us: %lu / bytes: %lu", dumpTimeUs(), bytes_dumped);
+            logInfo("write stalls: %lu / overruns: %lu", write_stalls, overruns);
+        }
+
+        uint32_t arm_time = 0;
+        uint32_t trigger_time = 0;
+        uint32_t capture_end_time = 0;
+        uint32_t dump_end_time = 0;
+        uint32_t samples_captured = 0;
+        uint32_t bytes_dumped = 0;
+        uint32_t write_stalls = 0;
+        uint32_t overruns = 0;
+
+    protected:
+        uint32_t toUs(uint32_t cycles) {
+            return (uint64_t) cycles * 1000000 / cycleFrequency();
+        }
+
+};
+
+} // namespace
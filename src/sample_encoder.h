@@ -0,0 +1,89 @@
+/**
+ * @file sample_encoder.h
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Conversion of the samples into the SUMP wire format: each sample is sent with 1 byte for each enabled channel
+ * group (channels 0-7, 8-15, 16-23, 24-31) starting with the lowest group.
+ */
+#pragma once
+
+#include "Arduino.h"
+#include "config.h"
+
+namespace logic_analyzer {
+
+/// Function which encodes count samples into out and returns the number of bytes
+typedef size_t (*EncodeFunction)(const PinBitArray *samples, size_t count, uint8_t *out);
+
+/// Encodes the samples for the enabled channel groups: the group tests are resolved by the compiler
+template <uint8_t GROUPS>
+size_t encodeGroups(const PinBitArray *samples, size_t count, uint8_t *out) {
+    uint8_t *start = out;
+    for (size_t j=0; j<count; j++){
+        uint32_t sample = samples[j];
+        if (GROUPS & 1) *out++ = sample;
+        if (GROUPS & 2) *out++ = sample >> 8;
+        if (GROUPS & 4) *out++ = sample >> 16;
+        if (GROUPS & 8) *out++ = sample >> 24;
+    }
+    return out - start;
+}
+
+/**
+ * @brief Converts the samples into the SUMP wire format with a specialized function for each combination of the
+ * enabled channel groups.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class SampleEncoder {
+    public:
+        /// Default Constructor: all groups which are covered by the PinBitArray are enabled
+        SampleEncoder() {
+            setGroups(defaultGroups());
+        }
+
+        /// Groups which are covered by the PinBitArray
+        static constexpr uint8_t defaultGroups() {
+            return (1 << sizeof(PinBitArray)) - 1;
+        }
+
+        /// Determines the enabled groups from the SUMP flags: bits 2-5 disable the groups 0-3
+        static uint8_t groupsFromFlags(uint8_t flags) {
+            return (~flags >> 2) & 0x0F;
+        }
+
+        /// Defines the enabled channel groups as bit mask: if no group is enabled we use group 0
+        void setGroups(uint8_t groups) {
+            static const EncodeFunction functions[16] = {
+                encodeGroups<0>, encodeGroups<1>, encodeGroups<2>, encodeGroups<3>,
+                encodeGroups<4>, encodeGroups<5>, encodeGroups<6>, encodeGroups<7>,
+                encodeGroups<8>, encodeGroups<9>, encodeGroups<10>, encodeGroups<11>,
+                encodeGroups<12>, encodeGroups<13>, encodeGroups<14>, encodeGroups<15>,
+            };
+            groups_value = (groups & 0x0F) == 0 ? 1 : groups & 0x0F;
+            bytes_per_sample = __builtin_popcount(groups_value);
+            encode_function = functions[groups_value];
+        }
+
+        /// Provides the enabled channel groups
+        uint8_t groups() {
+            return groups_value;
+        }
+
+        /// Number of bytes which are sent for each sample
+        uint8_t bytesPerSample() {
+            return bytes_per_sample;
+        }
+
+        /// Encodes count samples into out which must provide count * bytesPerSample() bytes: returns the number of bytes
+        inline size_t encode(const PinBitArray *samples, size_t count, uint8_t *out) {
+            return encode_function(samples, count, out);
+        }
+
+    protected:
+        uint8_t groups_value = 1;
+        uint8_t bytes_per_sample = 1;
+        EncodeFunction encode_function = encodeGroups<1>;
+};
+
+} // namespace
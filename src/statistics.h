@@ -0,0 +1,187 @@
+/**
+ * @file statistics.h
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Per channel signal statistics (high time, duty cycle, edges, frequency and pulse widths) which are updated
+ * incrementally with each block of samples, so that they can also be used in continuous mode.
+ */
+#pragma once
+
+#include "Arduino.h"
+#include "config.h"
+
+namespace logic_analyzer {
+
+/**
+ * @brief Statistics of a single channel: the positions and widths are in samples
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct ChannelStatistics {
+    uint32_t high_count = 0;
+    uint32_t rising_edges = 0;
+    uint32_t falling_edges = 0;
+    uint32_t min_high_width = 0xFFFFFFFF;
+    uint32_t max_high_width = 0;
+    uint32_t min_low_width = 0xFFFFFFFF;
+    uint32_t max_low_width = 0;
+    uint32_t first_rising = 0;
+    uint32_t last_rising = 0;
+    uint32_t last_edge = 0;
+    bool has_edge = false;
+    bool has_rising = false;
+};
+
+/**
+ * @brief Incremental signal statistics for all channels. Blocks of 8 samples are transposed (bit slicing), so that we
+ * get one byte per channel which contains its 8 samples: the high time and the edges are then determined with a popcount.
+ * The pulse widths are only evaluated for the channels which had an edge in the block.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class SignalStatistics {
+    public:
+        static const int CHANNELS = sizeof(PinBitArray) * 8;
+
+        /// Default Constructor
+        SignalStatistics() {
+            clear();
+        }
+
+        /// Resets all values: called when the capture is armed
+        void clear() {
+            for (int ch=0; ch<CHANNELS; ch++){
+                channels[ch] = ChannelStatistics();
+            }
+            sample_count = 0;
+            last_sample = 0;
+        }
+
+        /// Adds a block of samples
+        void update(const PinBitArray *samples, size_t count) {
+            // the first sample is not an edge
+            if (sample_count==0 && count>0) last_sample = samples[0];
+            size_t j = 0;
+            for (; j + 8 <= count; j += 8){
+                updateBlock(samples + j);
+            }
+            for (; j < count; j++){
+                updateSample(samples[j]);
+            }
+        }
+
+        /// Number of processed samples
+        uint32_t size() {
+            return sample_count;
+        }
+
+        /// Provides the statistics of the indicated channel
+        ChannelStatistics &channel(int ch) {
+            return channels[ch];
+        }
+
+        /// Percentage of the samples where the channel was high
+        float dutyCycle(int ch) {
+            return sample_count == 0 ? 0.0 : 100.0 * channels[ch].high_count / sample_count;
+        }
+
+        /// Frequency in hz from the distance of the rising edges
+        float frequency(int ch, uint32_t sampleRateHz) {
+            ChannelStatistics &stat = channels[ch];
+            if (stat.rising_edges < 2 || stat.last_rising == stat.first_rising) return 0.0;
+            float period = (float)(stat.last_rising - stat.first_rising) / (stat.rising_edges - 1);
+            return sampleRateHz / period;
+        }
+
+    protected:
+        ChannelStatistics channels[CHANNELS];
+        uint32_t sample_count = 0;
+        PinBitArray last_sample = 0;
+
+        /// 8x8 bit matrix transpose: afterwards byte n contains bit n of each input byte
+        static inline uint64_t transpose(uint64_t x) {
+            uint64_t t;
+            t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+            x = x ^ t ^ (t << 7);
+            t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+            x = x ^ t ^ (t << 14);
+            t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+            x = x ^ t ^ (t << 28);
+            return x;
+        }
+
+        /// processes 8 samples: we handle 8 channels at a time
+        void updateBlock(const PinBitArray *samples) {
+            for (int group=0; group<(int)sizeof(PinBitArray); group++){
+                int shift = group * 8;
+                uint64_t values = 0;
+                for (int j=0; j<8; j++){
+                    values |= (uint64_t)((samples[j] >> shift) & 0xFF) << (j * 8);
+                }
+                // previous sample of each sample
+                uint64_t previous = values << 8 | ((last_sample >> shift) & 0xFF);
+                uint64_t edges = values ^ previous;
+                uint64_t high = transpose(values);
+                uint64_t rising = edges ? transpose(edges & values) : 0;
+                uint64_t falling = edges ? transpose(edges & ~values) : 0;
+                for (int bit=0; bit<8; bit++){
+                    int ch = shift + bit;
+                    ChannelStatistics &stat = channels[ch];
+                    stat.high_count += __builtin_popcount((uint8_t)(high >> (bit * 8)));
+                    uint8_t ch_rising = rising >> (bit * 8);
+                    uint8_t ch_falling = falling >> (bit * 8);
+                    if (ch_rising | ch_falling){
+                        stat.rising_edges += __builtin_popcount(ch_rising);
+                        stat.falling_edges += __builtin_popcount(ch_falling);
+                        // evaluate the pulse widths in the sequence of the edges
+                        for (int j=0; j<8; j++){
+                            if ((ch_rising >> j) & 1) onEdge(stat, sample_count + j, true);
+                            else if ((ch_falling >> j) & 1) onEdge(stat, sample_count + j, false);
+                        }
+                    }
+                }
+            }
+            last_sample = samples[7];
+            sample_count += 8;
+        }
+
+        /// processes a single sample
+        void updateSample(PinBitArray sample) {
+            PinBitArray edges = sample ^ last_sample;
+            for (int ch=0; ch<CHANNELS; ch++){
+                ChannelStatistics &stat = channels[ch];
+                bool level = (sample >> ch) & 1;
+                stat.high_count += level;
+                if ((edges >> ch) & 1){
+                    if (level) stat.rising_edges++;
+                    else stat.falling_edges++;
+                    onEdge(stat, sample_count, level);
+                }
+            }
+            last_sample = sample;
+            sample_count++;
+        }
+
+        /// updates the pulse widths: the pulse before a rising edge was low
+        void onEdge(ChannelStatistics &stat, uint32_t pos, bool is_rising) {
+            if (stat.has_edge){
+                uint32_t width = pos - stat.last_edge;
+                if (is_rising){
+                    if (width < stat.min_low_width) stat.min_low_width = width;
+                    if (width > stat.max_low_width) stat.max_low_width = width;
+                } else {
+                    if (width < stat.min_high_width) stat.min_high_width = width;
+                    if (width > stat.max_high_width) stat.max_high_width = width;
+                }
+            }
+            if (is_rising){
+                if (!stat.has_rising) stat.first_rising = pos;
+                stat.has_rising = true;
+                stat.last_rising = pos;
+            }
+            stat.has_edge = true;
+            stat.last_edge = pos;
+        }
+};
+
+} // namespace
@@ -0,0 +1,565 @@
+/**
+ * @file storage.h
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Persistent capture snapshots: the captured samples are written in the SUMP wire format (raw, run length
+ * encoded or compressed with the BlockCodec) together with the capture parameters to a pluggable storage, so that they
+ * can be replayed later.
+ */
+#pragma once
+
+#include "Arduino.h"
+#include "config.h"
+#include "logger.h"
+#include "sample_encoder.h"
+#include "block_codec.h"
+#if defined(ESP32) || defined(ESP8266)
+#include "FS.h"
+#endif
+
+// The data is written to the storage in blocks of this size (flash page or SD sector)
+#ifndef STORAGE_BLOCK_SIZE
+#define STORAGE_BLOCK_SIZE 512
+#endif
+
+// Default name of the stored capture
+#ifndef STORAGE_DEFAULT_NAME
+#define STORAGE_DEFAULT_NAME "/capture.sump"
+#endif
+
+namespace logic_analyzer {
+
+/// Encoding of the samples in a snapshot: RLE stores each value with the (LEB128) number of repetitions and BLOCK the blocks of the BlockCodec
+enum SnapshotEncoding : uint8_t {SNAPSHOT_RAW=0, SNAPSHOT_RLE=1, SNAPSHOT_BLOCK=2};
+
+/**
+ * @brief Header of a stored capture: it is stored as 32 bytes with big endian values
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct SnapshotHeader {
+    static const size_t SIZE = 32;
+    static const uint8_t VERSION = 1;
+    uint8_t version = VERSION;
+    SnapshotEncoding encoding = SNAPSHOT_RAW;
+    uint8_t bytes_per_sample = 1;
+    uint8_t channel_groups = 1;
+    uint32_t frequency = 0;
+    uint32_t sample_count = 0;
+    uint32_t delay_count = 0;
+    uint32_t trigger_mask = 0;
+    uint32_t trigger_values = 0;
+
+    /// Converts the header to the stored format
+    void toBytes(uint8_t *data) {
+        memset(data, 0, SIZE);
+        memcpy(data, "LASN", 4);
+        data[4] = version;
+        data[5] = encoding;
+        data[6] = bytes_per_sample;
+        data[7] = channel_groups;
+        put32(data + 8, frequency);
+        put32(data + 12, sample_count);
+        put32(data + 16, delay_count);
+        put32(data + 20, trigger_mask);
+        put32(data + 24, trigger_values);
+    }
+
+    /// Reads the header from the stored format: returns false if it is not valid
+    bool fromBytes(const uint8_t *data) {
+        if (memcmp(data, "LASN", 4)!=0 || data[4]!=VERSION) return false;
+        version = data[4];
+        encoding = (SnapshotEncoding) data[5];
+        bytes_per_sample = data[6];
+        channel_groups = data[7];
+        frequency = get32(data + 8);
+        sample_count = get32(data + 12);
+        delay_count = get32(data + 16);
+        trigger_mask = get32(data + 20);
+        trigger_values = get32(data + 24);
+        return bytes_per_sample > 0 && bytes_per_sample == __builtin_popcount(channel_groups & 0x0F);
+    }
+
+    protected:
+        static void put32(uint8_t *data, uint32_t value) {
+            data[0] = value >> 24;
+            data[1] = value >> 16;
+            data[2] = value >> 8;
+            data[3] = value;
+        }
+
+        static uint32_t get32(const uint8_t *data) {
+            return (uint32_t)data[0] << 24 | (uint32_t)data[1] << 16 | (uint32_t)data[2] << 8 | data[3];
+        }
+};
+
+/**
+ * @brief Abstract storage backend: you can support any file system or raw flash area by implementing these methods.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class CaptureStorage {
+    public:
+        /// Destructor
+        virtual ~CaptureStorage() {
+        }
+
+        /// Opens the indicated snapshot for writing (which replaces the old content) or reading
+        virtual bool open(const char *name, bool isWrite) = 0;
+
+        /// Writes the data: returns the number of written bytes
+        virtual size_t write(const uint8_t *data, size_t len) = 0;
+
+        /// Reads up to len bytes: returns 0 at the end
+        virtual size_t read(uint8_t *data, size_t len) = 0;
+
+        /// Closes the actual snapshot
+        virtual void close() = 0;
+};
+
+/**
+ * @brief Writes the samples to a CaptureStorage: the output is collected and written in blocks of STORAGE_BLOCK_SIZE
+ * bytes. The samples are stored in the SUMP wire format of the enabled channel groups.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class SnapshotWriter {
+    public:
+        /// Default Constructor: the codec is needed for SNAPSHOT_BLOCK
+        SnapshotWriter(CaptureStorage &storage, BlockCodec *codec=nullptr) {
+            storage_ptr = &storage;
+            codec_ptr = codec;
+        }
+
+        /// Opens the snapshot and writes the header
+        bool begin(const char *name, SnapshotHeader &header) {
+            if (!storage_ptr->open(name, true)){
+                logError("storage: could not open %s", name);
+                return false;
+            }
+            encoder.setGroups(header.channel_groups);
+            header.channel_groups = encoder.groups();
+            header.bytes_per_sample = encoder.bytesPerSample();
+            if (header.encoding==SNAPSHOT_BLOCK && codec_ptr==nullptr){
+                logWarning("storage: no BlockCodec - using RLE");
+                header.encoding = SNAPSHOT_RLE;
+            }
+            encoding = header.encoding;
+            if (encoding==SNAPSHOT_BLOCK){
+                codec_ptr->begin(encoder.groups());
+            }
+            // we only compare the values of the enabled channel groups
+            value_mask = 0;
+            for (int g=0; g<4; g++){
+                if ((encoder.groups() >> g) & 1) value_mask |= 0xFFul << (g * 8);
+            }
+            block_pos = 0;
+            run_count = 0;
+            is_ok = true;
+            header.toBytes(block);
+            block_pos = SnapshotHeader::SIZE;
+            return true;
+        }
+
+        /// Adds the samples
+        void write(const PinBitArray *samples, size_t count) {
+            if (encoding==SNAPSHOT_RAW){
+                uint8_t tmp[128];
+                const size_t max_samples = sizeof(tmp) / encoder.bytesPerSample();
+                while (count > 0){
+                    size_t len = count < max_samples ? count : max_samples;
+                    writeBytes(tmp, encoder.encode(samples, len, tmp));
+                    samples += len;
+                    count -= len;
+                }
+                return;
+            }
+            if (encoding==SNAPSHOT_BLOCK){
+                while (count > 0){
+                    size_t len = codec_ptr->add(samples, count);
+                    if (codec_ptr->isFull()) writeCodecBlock();
+                    samples += len;
+                    count -= len;
+                }
+                return;
+            }
+            for (size_t j=0; j<count; j++){
+                PinBitArray value = samples[j] & value_mask;
+                if (run_count > 0 && value == run_value){
+                    run_count++;
+                } else {
+                    writeRun();
+                    run_value = value;
+                    run_count = 1;
+                }
+            }
+        }
+
+        /// Writes the open data and closes the snapshot: returns false if the storage reported an error
+        bool end() {
+            if (encoding==SNAPSHOT_BLOCK){
+                // open block and end marker
+                if (codec_ptr->pending() > 0) writeCodecBlock();
+                writeCodecBlock();
+            }
+            writeRun();
+            writeBlock();
+            storage_ptr->close();
+            return is_ok;
+        }
+
+    protected:
+        CaptureStorage *storage_ptr = nullptr;
+        BlockCodec *codec_ptr = nullptr;
+        SampleEncoder encoder;
+        SnapshotEncoding encoding = SNAPSHOT_RAW;
+        PinBitArray value_mask = 0;
+        PinBitArray run_value = 0;
+        uint32_t run_count = 0;
+        uint8_t block[STORAGE_BLOCK_SIZE];
+        size_t block_pos = 0;
+        bool is_ok = true;
+
+        /// writes the actual run: value followed by the LEB128 count
+        void writeRun() {
+            if (run_count == 0) return;
+            uint8_t tmp[9];
+            size_t len = encoder.encode(&run_value, 1, tmp);
+            uint32_t count = run_count;
+            do {
+                uint8_t byte = count & 0x7F;
+                count >>= 7;
+                tmp[len++] = count ? byte | 0x80 : byte;
+            } while (count);
+            writeBytes(tmp, len);
+            run_count = 0;
+        }
+
+        void writeCodecBlock() {
+            size_t len;
+            const uint8_t *data = codec_ptr->encodeBlock(len);
+            writeBytes(data, len);
+        }
+
+        void writeBytes(const uint8_t *data, size_t len) {
+            while (len > 0){
+                size_t n = STORAGE_BLOCK_SIZE - block_pos;
+                if (n > len) n = len;
+                memcpy(block + block_pos, data, n);
+                block_pos += n;
+                data += n;
+                len -= n;
+                if (block_pos == STORAGE_BLOCK_SIZE){
+                    writeBlock();
+                }
+            }
+        }
+
+        void writeBlock() {
+            if (block_pos == 0) return;
+            if (storage_ptr->write(block, block_pos) != block_pos){
+                is_ok = false;
+            }
+            block_pos = 0;
+        }
+};
+
+/**
+ * @brief Reads a stored snapshot and replays the samples in the SUMP wire format to a Stream or provides them as
+ * PinBitArray, so that they can be converted to other channel groups. The buffers and the BlockDecoder need several KB,
+ * so the LogicAnalyzer allocates the reader on the heap: avoid it on the stack of small tasks (e.g. on the ESP8266).
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class SnapshotReader {
+    public:
+        /// Default Constructor
+        SnapshotReader(CaptureStorage &storage) {
+            setStorage(storage);
+        }
+
+        /// Defines the storage which is used by the next begin()
+        void setStorage(CaptureStorage &storage) {
+            storage_ptr = &storage;
+        }
+
+        /// Opens the snapshot and reads the header: returns false if there is no valid snapshot
+        bool begin(const char *name) {
+            if (!storage_ptr->open(name, false)){
+                logWarning("storage: could not open %s", name);
+                return false;
+            }
+            block_pos = 0;
+            block_len = 0;
+            samples_read = 0;
+            run_count = 0;
+            decoder = BlockDecoder();
+            uint8_t data[SnapshotHeader::SIZE];
+            if (readBytes(data, SnapshotHeader::SIZE) != SnapshotHeader::SIZE || !snapshot_header.fromBytes(data)){
+                logError("storage: %s is not a valid snapshot", name);
+                storage_ptr->close();
+                return false;
+            }
+            return true;
+        }
+
+        /// Provides the header of the opened snapshot
+        SnapshotHeader &header() {
+            return snapshot_header;
+        }
+
+        /// Writes the samples to the output: returns the number of samples
+        size_t replay(Print &out) {
+            uint32_t samples = 0;
+            uint32_t sample_count = snapshot_header.sample_count;
+            uint8_t bytes_per_sample = snapshot_header.bytes_per_sample;
+            if (snapshot_header.encoding == SNAPSHOT_RAW){
+                // we pass the blocks on w/o any conversion
+                size_t remaining = sample_count * bytes_per_sample;
+                while (remaining > 0){
+                    if (!fillBlock()) break;
+                    size_t len = block_len - block_pos;
+                    if (len > remaining) len = remaining;
+                    out.write(block + block_pos, len);
+                    block_pos += len;
+                    remaining -= len;
+                }
+                samples = sample_count - remaining / bytes_per_sample;
+            } else if (snapshot_header.encoding == SNAPSHOT_BLOCK){
+                samples = replayBlocks(out);
+            } else {
+                uint8_t value[4];
+                size_t out_pos = 0;
+                while (samples < sample_count){
+                    uint32_t count;
+                    if (readBytes(value, bytes_per_sample) != bytes_per_sample || !readCount(count)) break;
+                    if (count > sample_count - samples) count = sample_count - samples;
+                    for (uint32_t j=0; j<count; j++){
+                        if (out_pos + bytes_per_sample > STORAGE_BLOCK_SIZE){
+                            out.write(out_buffer, out_pos);
+                            out_pos = 0;
+                        }
+                        memcpy(out_buffer + out_pos, value, bytes_per_sample);
+                        out_pos += bytes_per_sample;
+                    }
+                    samples += count;
+                }
+                out.write(out_buffer, out_pos);
+            }
+            storage_ptr->close();
+            if (samples < sample_count){
+                logWarning("storage: snapshot is truncated: %lu of %lu samples", samples, sample_count);
+            }
+            return samples;
+        }
+
+        /// Provides up to count samples: the stored channel groups are expanded to the PinBitArray. Returns 0 at the end.
+        size_t read(PinBitArray *samples, size_t count) {
+            size_t result = 0;
+            uint8_t value[4];
+            while (result < count && samples_read < snapshot_header.sample_count && readValue(value)){
+                samples[result++] = toSample(value);
+                samples_read++;
+            }
+            return result;
+        }
+
+        /// Closes the snapshot after read()
+        void end() {
+            storage_ptr->close();
+        }
+
+    protected:
+        CaptureStorage *storage_ptr = nullptr;
+        SnapshotHeader snapshot_header;
+        uint32_t samples_read = 0;
+        uint8_t run_value[4];
+        uint32_t run_count = 0;
+        uint8_t block[STORAGE_BLOCK_SIZE];
+        size_t block_pos = 0;
+        size_t block_len = 0;
+        uint8_t out_buffer[STORAGE_BLOCK_SIZE];
+        uint8_t codec_block[BLOCK_CODEC_MAX_SIZE];
+        BlockDecoder decoder;
+
+        /// decodes the blocks of the BlockCodec until the end marker
+        uint32_t replayBlocks(Print &out) {
+            uint32_t samples = 0;
+            uint32_t sample_count = snapshot_header.sample_count;
+            uint8_t bytes_per_sample = snapshot_header.bytes_per_sample;
+            while (samples < sample_count && readCodecBlock()){
+                size_t len;
+                while ((len = decoder.read(out_buffer, STORAGE_BLOCK_SIZE / bytes_per_sample)) > 0){
+                    if (len > sample_count - samples) len = sample_count - samples;
+                    out.write(out_buffer, len * bytes_per_sample);
+                    samples += len;
+                }
+            }
+            return samples;
+        }
+
+        /// reads the next block of the BlockCodec: returns false at the end marker or if the block is not valid
+        bool readCodecBlock() {
+            if (readBytes(codec_block, BLOCK_CODEC_HEADER_SIZE) != BLOCK_CODEC_HEADER_SIZE) return false;
+            size_t payload = codec_block[4] << 8 | codec_block[5];
+            return payload <= BLOCK_CODEC_MAX_SIZE - BLOCK_CODEC_HEADER_SIZE
+                && readBytes(codec_block + BLOCK_CODEC_HEADER_SIZE, payload) == payload
+                && decoder.begin(codec_block, BLOCK_CODEC_HEADER_SIZE + payload)
+                && decoder.bytesPerSample() == snapshot_header.bytes_per_sample && decoder.sampleCount() > 0;
+        }
+
+        /// reads the next sample in the SUMP wire format
+        bool readValue(uint8_t *value) {
+            uint8_t bytes_per_sample = snapshot_header.bytes_per_sample;
+            switch(snapshot_header.encoding){
+                case SNAPSHOT_RAW:
+                    return readBytes(value, bytes_per_sample) == bytes_per_sample;
+                case SNAPSHOT_BLOCK:
+                    return decoder.read(value, 1) == 1 || (readCodecBlock() && decoder.read(value, 1) == 1);
+                default:
+                    if (run_count == 0 && (readBytes(run_value, bytes_per_sample) != bytes_per_sample || !readCount(run_count) || run_count == 0)){
+                        return false;
+                    }
+                    memcpy(value, run_value, bytes_per_sample);
+                    run_count--;
+                    return true;
+            }
+        }
+
+        /// converts a sample in the SUMP wire format of the stored channel groups to the PinBitArray
+        PinBitArray toSample(const uint8_t *value) {
+            uint32_t result = 0;
+            int pos = 0;
+            for (int g=0; g<4; g++){
+                if ((snapshot_header.channel_groups >> g) & 1) result |= (uint32_t)value[pos++] << (g * 8);
+            }
+            return result;
+        }
+
+        bool fillBlock() {
+            if (block_pos < block_len) return true;
+            block_pos = 0;
+            block_len = storage_ptr->read(block, STORAGE_BLOCK_SIZE);
+            return block_len > 0;
+        }
+
+        size_t readBytes(uint8_t *data, size_t len) {
+            size_t result = 0;
+            while (result < len && fillBlock()){
+                data[result++] = block[block_pos++];
+            }
+            return result;
+        }
+
+        /// reads a LEB128 count
+        bool readCount(uint32_t &count) {
+            count = 0;
+            for (int shift=0; shift<35; shift+=7){
+                uint8_t byte;
+                if (readBytes(&byte, 1) != 1) return false;
+                count |= (uint32_t)(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0) return true;
+            }
+            return false;
+        }
+};
+
+#if defined(__linux__) || defined(ESP32)
+
+/**
+ * @brief Storage which uses the C file API: on Linux this is a regular file and on the ESP32 any file system which is
+ * mounted in the VFS (e.g. LittleFS at /littlefs or SD at /sdcard). The name is appended to the directory.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class FileStorage : public CaptureStorage {
+    public:
+        /// Default Constructor
+        FileStorage(const char *directory="") {
+            this->directory = directory;
+        }
+
+        /// Destructor
+        ~FileStorage() {
+            close();
+        }
+
+        /// Opens the indicated file for writing or reading
+        bool open(const char *name, bool isWrite) {
+            close();
+            char path[128];
+            snprintf(path, sizeof(path), "%s%s", directory, name);
+            file = fopen(path, isWrite ? "wb" : "rb");
+            return file != nullptr;
+        }
+
+        /// Writes the data
+        size_t write(const uint8_t *data, size_t len) {
+            return file == nullptr ? 0 : fwrite(data, 1, len, file);
+        }
+
+        /// Reads up to len bytes
+        size_t read(uint8_t *data, size_t len) {
+            return file == nullptr ? 0 : fread(data, 1, len, file);
+        }
+
+        /// Closes the file
+        void close() {
+            if (file != nullptr){
+                fclose(file);
+                file = nullptr;
+            }
+        }
+
+    protected:
+        const char *directory;
+        FILE *file = nullptr;
+};
+
+#endif
+
+#if defined(ESP32) || defined(ESP8266)
+
+/**
+ * @brief Storage which uses an Arduino file system: e.g. LittleFS, SPIFFS, SD or SD_MMC
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class FSStorage : public CaptureStorage {
+    public:
+        /// Default Constructor: the file system must have been started with begin()
+        FSStorage(fs::FS &fileSystem) : file_system(fileSystem) {
+        }
+
+        /// Opens the indicated file for writing or reading
+        bool open(const char *name, bool isWrite) {
+            close();
+            file = file_system.open(name, isWrite ? "w" : "r");
+            return (bool) file;
+        }
+
+        /// Writes the data
+        size_t write(const uint8_t *data, size_t len) {
+            return file.write(data, len);
+        }
+
+        /// Reads up to len bytes
+        size_t read(uint8_t *data, size_t len) {
+            return file.read(data, len);
+        }
+
+        /// Closes the file
+        void close() {
+            if (file){
+                file.close();
+            }
+        }
+
+    protected:
+        fs::FS &file_system;
+        fs::File file;
+};
+
+#endif
+
+} // namespace
@@ -0,0 +1,84 @@
+/**
+ * @file test_pattern.h
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Internal test pattern generator which replaces the GPIO pins: this can be used to measure and verify the
+ * capturing and the transport w/o any external signals.
+ */
+#pragma once
+
+#include "Arduino.h"
+#include "config.h"
+
+// Start value of the PRBS generator (must not be 0)
+#ifndef TEST_PATTERN_PRBS_SEED
+#define TEST_PATTERN_PRBS_SEED 0x7FFF
+#endif
+
+namespace logic_analyzer {
+
+/// Test patterns: COUNTER increments the value, WALKING_ONES moves a single high bit and PRBS is the PRBS-15 bit stream
+enum TestPatternMode : uint8_t {TEST_PATTERN_OFF, TEST_PATTERN_COUNTER, TEST_PATTERN_WALKING_ONES, TEST_PATTERN_PRBS};
+
+/**
+ * @brief Generates the test pattern with the same interface as the PinReader. The PRBS is the PRBS-15 (x^15 + x^14 + 1)
+ * bit stream: each group of 8 channels contains the next 8 bits (oldest bit in the MSB), so the SUMP data with all
+ * groups enabled is the bit stream itself. A receiver can synchronize after 15 bits and verify all following bits.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class TestPatternGenerator {
+    public:
+        /// Selects the pattern and restarts it
+        void begin(TestPatternMode mode) {
+            this->mode = mode;
+            value = mode == TEST_PATTERN_WALKING_ONES ? 1 : 0;
+            lfsr = TEST_PATTERN_PRBS_SEED;
+        }
+
+        /// Returns true if a pattern is active
+        bool isActive() {
+            return mode != TEST_PATTERN_OFF;
+        }
+
+        /// Provides the actual pattern
+        TestPatternMode testPattern() {
+            return mode;
+        }
+
+        /// Provides the next value of the pattern
+        inline PinBitArray readAll() {
+            PinBitArray result = value;
+            switch(mode){
+                case TEST_PATTERN_COUNTER:
+                    value++;
+                    break;
+                case TEST_PATTERN_WALKING_ONES:
+                    value = value << 1 | value >> (sizeof(PinBitArray) * 8 - 1);
+                    break;
+                case TEST_PATTERN_PRBS:
+                    result = 0;
+                    for (int group=0; group<(int)sizeof(PinBitArray); group++){
+                        result |= (PinBitArray) nextPRBSByte() << (group * 8);
+                    }
+                    break;
+                default:
+                    break;
+            }
+            return result;
+        }
+
+    protected:
+        TestPatternMode mode = TEST_PATTERN_OFF;
+        PinBitArray value = 0;
+        uint16_t lfsr = TEST_PATTERN_PRBS_SEED;
+
+        /// the last 15 bits are in lfsr (newest in bit 0): b[n] = b[n-15] ^ b[n-14], so we get 8 new bits at once
+        inline uint8_t nextPRBSByte() {
+            uint8_t result = ((lfsr >> 7) ^ (lfsr >> 6)) & 0xFF;
+            lfsr = ((lfsr << 8) | result) & 0x7FFF;
+            return result;
+        }
+};
+
+} // namespace
@@ -0,0 +1,296 @@
+/**
+ * @file transport.h
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Abstract transport for the SUMP protocol with a non-blocking send queue: the dump encoder writes directly into
+ * buffers which are loaned from the queue, so the data is not copied before it is sent.
+ */
+#pragma once
+
+#include "Arduino.h"
+#include "config.h"
+#include "logger.h"
+
+// Size of each send buffer: ideally a multiple of the TCP MSS
+#ifndef TRANSPORT_BUFFER_SIZE
+#define TRANSPORT_BUFFER_SIZE 1460
+#endif
+
+// Number of send buffers which can be loaned
+#ifndef TRANSPORT_BUFFER_COUNT
+#define TRANSPORT_BUFFER_COUNT 4
+#endif
+
+// Max number of entries in the send queue (loaned buffers and references to external memory)
+#ifndef TRANSPORT_QUEUE_SIZE
+#define TRANSPORT_QUEUE_SIZE 8
+#endif
+
+// Size of the receive buffer for the SUMP commands
+#ifndef TRANSPORT_RECEIVE_SIZE
+#define TRANSPORT_RECEIVE_SIZE 32
+#endif
+
+// Max time in ms that we wait for the client to accept more data before we close the connection
+#ifndef TRANSPORT_TIMEOUT_MS
+#define TRANSPORT_TIMEOUT_MS 5000
+#endif
+
+namespace logic_analyzer {
+
+/**
+ * @brief Abstract Transport: a Stream with a non-blocking send queue. The queue contains either buffers which have
+ * been loaned with loan() and committed with commit() or references to external memory which were added with queue().
+ * Sending never blocks: poll() sends as much as the connection accepts. We only wait for the connection when all
+ * buffers are in use or in flush(). If the connection is lost, the queued data is discarded. If the client does not
+ * accept any data for TRANSPORT_TIMEOUT_MS, we close the connection, so that a stalled client can't block the device.
+ * Subclasses just need to implement sendData(), receiveData(), isConnected() and closeClient().
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class Transport : public Stream {
+    public:
+        /// Destructor
+        virtual ~Transport() {
+        }
+
+        /// Returns true if a client is connected
+        bool connected() {
+            return isConnected();
+        }
+
+        /// Provides a free send buffer of len bytes which is sent in the queue order after commit(): we wait if all buffers are in use
+        uint8_t *loan(size_t &len) {
+            commitOpen();
+            int idx;
+            while ((idx = freeBuffer()) < 0 || isQueueFull()){
+                if (!poll()) waitForClient();
+            }
+            loaned_buffer = idx;
+            len = TRANSPORT_BUFFER_SIZE;
+            return buffers[idx];
+        }
+
+        /// Adds the first len bytes of the loaned buffer to the send queue
+        void commit(size_t len) {
+            if (loaned_buffer < 0) return;
+            int idx = loaned_buffer;
+            loaned_buffer = -1;
+            if (len == 0) return;
+            buffer_used |= 1 << idx;
+            push(buffers[idx], len, idx);
+            poll();
+        }
+
+        /// Adds a reference to external memory to the send queue: the memory must stay valid until flush() has been called
+        void queue(const uint8_t *data, size_t len) {
+            commitOpen();
+            if (len == 0) return;
+            while (isQueueFull()){
+                if (!poll()) waitForClient();
+            }
+            push(data, len, -1);
+            poll();
+        }
+
+        /// Sends as much of the queued data as possible w/o blocking: returns true if the queue is empty
+        bool poll() {
+            if (!isConnected()){
+                // nobody is listening: discard the data
+                discard();
+                return true;
+            }
+            while (queue_count > 0){
+                SendEntry &entry = entries[queue_head];
+                int result = sendData(entry.data + send_pos, entry.len - send_pos);
+                if (result < 0){
+                    discard();
+                    return true;
+                }
+                if (result == 0) {
+                    // the connection does not accept any more data
+                    return false;
+                }
+                send_pos += result;
+                last_send_ms = millis();
+                if (send_pos == entry.len){
+                    pop();
+                }
+            }
+            return true;
+        }
+
+        /// Number of bytes which can be written w/o waiting
+        int availableForWrite() {
+            if (isQueueFull()) return 0;
+            int free = 0;
+            for (int j=0; j<TRANSPORT_BUFFER_COUNT; j++){
+                if (((buffer_used >> j) & 1) == 0 && j != open_buffer) free += TRANSPORT_BUFFER_SIZE;
+            }
+            if (open_buffer >= 0) free += TRANSPORT_BUFFER_SIZE - open_len;
+            return free;
+        }
+
+        /// Copies a single byte to the send buffer
+        size_t write(uint8_t value) {
+            return write(&value, 1);
+        }
+
+        /// Copies the data to the send buffer: small writes are collected until the buffer is full or flush() is called
+        size_t write(const uint8_t *data, size_t len) {
+            size_t written = 0;
+            while (written < len){
+                if (open_buffer < 0){
+                    size_t size;
+                    loan(size);
+                    open_buffer = loaned_buffer;
+                    loaned_buffer = -1;
+                    open_len = 0;
+                }
+                size_t n = TRANSPORT_BUFFER_SIZE - open_len;
+                if (n > len - written) n = len - written;
+                memcpy(buffers[open_buffer] + open_len, data + written, n);
+                open_len += n;
+                written += n;
+                if (open_len == TRANSPORT_BUFFER_SIZE){
+                    commitOpen();
+                }
+            }
+            return written;
+        }
+
+        /// Sends all queued data: afterwards the external memory which was added with queue() is not used any more
+        void flush() {
+            commitOpen();
+            while (!poll()){
+                waitForClient();
+            }
+        }
+
+        /// Number of received bytes
+        int available() {
+            fillReceive();
+            return receive_len - receive_pos;
+        }
+
+        /// Reads a received byte: returns -1 if no data is available
+        int read() {
+            if (available() == 0) return -1;
+            return receive_buffer[receive_pos++];
+        }
+
+        /// Provides the next received byte w/o removing it: returns -1 if no data is available
+        int peek() {
+            if (available() == 0) return -1;
+            return receive_buffer[receive_pos];
+        }
+
+    protected:
+        struct SendEntry {
+            const uint8_t *data;
+            size_t len;
+            int buffer;
+        };
+        uint8_t buffers[TRANSPORT_BUFFER_COUNT][TRANSPORT_BUFFER_SIZE];
+        SendEntry entries[TRANSPORT_QUEUE_SIZE];
+        uint8_t receive_buffer[TRANSPORT_RECEIVE_SIZE];
+        uint32_t buffer_used = 0;
+        int loaned_buffer = -1;
+        int open_buffer = -1;
+        size_t open_len = 0;
+        int queue_head = 0;
+        int queue_count = 0;
+        size_t send_pos = 0;
+        int receive_pos = 0;
+        int receive_len = 0;
+        uint32_t last_send_ms = 0;
+
+        /// Sends the data w/o blocking: returns the number of bytes which were sent, 0 if we need to try later or -1 if the connection was lost
+        virtual int sendData(const uint8_t *data, size_t len) = 0;
+
+        /// Reads the available data w/o blocking: returns the number of bytes, 0 if there is no data or -1 if the connection was lost
+        virtual int receiveData(uint8_t *data, size_t len) = 0;
+
+        /// Returns true if a client is connected
+        virtual bool isConnected() = 0;
+
+        /// Closes the connection to the actual client
+        virtual void closeClient() = 0;
+
+        /// Resets the send queue and the receive buffer: to be called by subclasses when a new client has connected
+        void reset() {
+            discard();
+            open_buffer = -1;
+            open_len = 0;
+            receive_pos = 0;
+            receive_len = 0;
+        }
+
+        bool isQueueFull() {
+            return queue_count == TRANSPORT_QUEUE_SIZE;
+        }
+
+        /// determines a buffer which is not used
+        int freeBuffer() {
+            for (int j=0; j<TRANSPORT_BUFFER_COUNT; j++){
+                if (((buffer_used >> j) & 1) == 0 && j != open_buffer && j != loaned_buffer) return j;
+            }
+            return -1;
+        }
+
+        /// adds the partially filled buffer of write() to the queue
+        void commitOpen() {
+            if (open_buffer < 0) return;
+            loaned_buffer = open_buffer;
+            open_buffer = -1;
+            commit(open_len);
+            open_len = 0;
+        }
+
+        /// called while the client does not accept any data: we close the connection after the timeout, which discards the queue
+        void waitForClient() {
+            if (millis() - last_send_ms > TRANSPORT_TIMEOUT_MS){
+                logError("Transport timeout: client does not accept any data");
+                closeClient();
+                discard();
+                return;
+            }
+            yield();
+        }
+
+        void push(const uint8_t *data, size_t len, int buffer) {
+            // the timeout starts when the queue gets data
+            if (queue_count == 0) last_send_ms = millis();
+            SendEntry &entry = entries[(queue_head + queue_count) % TRANSPORT_QUEUE_SIZE];
+            entry.data = data;
+            entry.len = len;
+            entry.buffer = buffer;
+            queue_count++;
+        }
+
+        void pop() {
+            SendEntry &entry = entries[queue_head];
+            if (entry.buffer >= 0) buffer_used &= ~(1 << entry.buffer);
+            queue_head = (queue_head + 1) % TRANSPORT_QUEUE_SIZE;
+            queue_count--;
+            send_pos = 0;
+        }
+
+        /// removes all entries from the send queue
+        void discard() {
+            while (queue_count > 0){
+                pop();
+            }
+        }
+
+        void fillReceive() {
+            if (receive_pos < receive_len) return;
+            receive_pos = 0;
+            receive_len = 0;
+            if (!isConnected()) return;
+            int result = receiveData(receive_buffer, TRANSPORT_RECEIVE_SIZE);
+            if (result > 0) receive_len = result;
+        }
+};
+
+} // namespace
@@ -0,0 +1,210 @@
+/**
+ * @file transport_tcp.h
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief TCP server transports for network attached logic analyzers: sigrok can connect with the OLS driver using
+ * conn=tcp-raw/host/port. We use the BSD socket API on Linux and the ESP32 and the WiFiServer on the ESP8266.
+ */
+#pragma once
+
+#include "transport.h"
+
+// Default TCP port of the server
+#ifndef TRANSPORT_TCP_PORT
+#define TRANSPORT_TCP_PORT 5555
+#endif
+
+#if defined(__linux__) || defined(ESP32)
+// use the conversion functions of the network stack
+#undef htons
+#undef ntohs
+#undef htonl
+#undef ntohl
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace logic_analyzer {
+
+/**
+ * @brief TCP server which accepts one client at a time. All sockets are non-blocking, so a slow client never blocks the
+ * caller: the data stays in the send queue until the socket accepts it.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class TCPServerTransport : public Transport {
+    public:
+        /// Destructor
+        ~TCPServerTransport() {
+            end();
+        }
+
+        /// Starts the server on the indicated port: returns false if the port can't be used
+        bool begin(uint16_t port=TRANSPORT_TCP_PORT) {
+            end();
+            server_fd = socket(AF_INET, SOCK_STREAM, 0);
+            if (server_fd < 0){
+                logError("socket failed: %d", errno);
+                return false;
+            }
+            int on = 1;
+            setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+            struct sockaddr_in address;
+            memset(&address, 0, sizeof(address));
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = INADDR_ANY;
+            address.sin_port = htons(port);
+            if (bind(server_fd, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(server_fd, 1) < 0){
+                logError("bind to port %d failed: %d", port, errno);
+                end();
+                return false;
+            }
+            setNonBlocking(server_fd);
+            logDebug("TCPServerTransport port %d", port);
+            return true;
+        }
+
+        /// Closes the client and the server socket
+        void end() {
+            closeClient();
+            if (server_fd >= 0){
+                close(server_fd);
+                server_fd = -1;
+            }
+        }
+
+        /// Closes the connection to the actual client
+        void closeClient() {
+            if (client_fd >= 0){
+                logDebug("TCPServerTransport client closed");
+                close(client_fd);
+                client_fd = -1;
+            }
+        }
+
+    protected:
+        int server_fd = -1;
+        int client_fd = -1;
+
+        static void setNonBlocking(int fd) {
+            int flags = fcntl(fd, F_GETFL, 0);
+            fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+        }
+
+        static bool isWouldBlock() {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+
+        /// Accepts a new client if we are not connected
+        bool isConnected() {
+            if (client_fd >= 0) return true;
+            if (server_fd < 0) return false;
+            int fd = accept(server_fd, nullptr, nullptr);
+            if (fd < 0) return false;
+            setNonBlocking(fd);
+            // the SUMP commands and the metadata are small: don't wait for more data
+            int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            client_fd = fd;
+            reset();
+            logDebug("TCPServerTransport client connected");
+            return true;
+        }
+
+        int sendData(const uint8_t *data, size_t len) {
+            int result = send(client_fd, data, len, MSG_NOSIGNAL);
+            if (result < 0){
+                if (isWouldBlock()) return 0;
+                closeClient();
+                return -1;
+            }
+            return result;
+        }
+
+        int receiveData(uint8_t *data, size_t len) {
+            int result = recv(client_fd, data, len, 0);
+            if (result > 0) return result;
+            if (result < 0 && isWouldBlock()) return 0;
+            // 0: the client has closed the connection
+            closeClient();
+            return -1;
+        }
+};
+
+} // namespace
+
+#elif defined(ESP8266)
+#include <ESP8266WiFi.h>
+
+namespace logic_analyzer {
+
+/**
+ * @brief TCP server based on the WiFiServer which accepts one client at a time. We only write what fits into the
+ * available TCP window, so that the WiFiClient never blocks.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class TCPServerTransport : public Transport {
+    public:
+        /// Starts the server on the indicated port
+        bool begin(uint16_t port=TRANSPORT_TCP_PORT) {
+            server.begin(port);
+            server.setNoDelay(true);
+            logDebug("TCPServerTransport port %d", port);
+            return true;
+        }
+
+        /// Closes the client and the server
+        void end() {
+            closeClient();
+            server.stop();
+        }
+
+        /// Closes the connection to the actual client
+        void closeClient() {
+            if (client){
+                client.stop();
+            }
+        }
+
+    protected:
+        WiFiServer server{TRANSPORT_TCP_PORT};
+        WiFiClient client;
+
+        /// Accepts a new client if we are not connected
+        bool isConnected() {
+            if (client && client.connected()) return true;
+            WiFiClient new_client = server.available();
+            if (!new_client) return false;
+            client = new_client;
+            client.setNoDelay(true);
+            reset();
+            logDebug("TCPServerTransport client connected");
+            return true;
+        }
+
+        int sendData(const uint8_t *data, size_t len) {
+            if (!client.connected()) return -1;
+            size_t free = client.availableForWrite();
+            if (free == 0) return 0;
+            return client.write(data, len < free ? len : free);
+        }
+
+        int receiveData(uint8_t *data, size_t len) {
+            if (!client.connected()) return -1;
+            int available = client.available();
+            if (available <= 0) return 0;
+            return client.read(data, (size_t)available < len ? available : len);
+        }
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,147 @@
+/**
+ * @file trigger_interrupt.h
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Waiting for a trigger with the help of an interrupt, so that the capturing core is not busy while it is
+ * waiting for the trigger.
+ */
+#pragma once
+
+#include "Arduino.h"
+#include "config.h"
+#include "logger.h"
+
+// Max time in microseconds we wait for the trigger interrupt before we check for a cancellation
+#ifndef TRIGGER_WAIT_TIMEOUT_US
+#define TRIGGER_WAIT_TIMEOUT_US 10000
+#endif
+
+// Pin which is set to high when the trigger has been detected, so that the trigger latency can be measured with a scope: -1 = not used
+#ifndef TRIGGER_TEST_PIN
+#define TRIGGER_TEST_PIN -1
+#endif
+
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
+#ifdef ARDUINO_ARCH_RP2040
+#include "pico/time.h"
+#endif
+
+namespace logic_analyzer {
+
+/**
+ * @brief Abstract source of a trigger interrupt: the capturing only uses begin(), wait() and end(), so you can provide
+ * your own implementation e.g. for a different interrupt source or a simulation on the host.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class TriggerInterrupt {
+    public:
+        /// Destructor
+        virtual ~TriggerInterrupt() {
+        }
+
+        /// Activates the interrupt which is raised when the pin changes to the indicated level: returns false if the pin is not supported
+        virtual bool begin(uint8_t pin, bool level) = 0;
+
+        /// Sleeps until the interrupt has been raised or the timeout has passed: returns true if the interrupt has been raised
+        virtual bool wait(uint32_t timeout_us) = 0;
+
+        /// Deactivates the interrupt
+        virtual void end() = 0;
+};
+
+// The interrupt service routine is a plain function, so the state of the active TriggerInterruptGPIO is process wide:
+// we use function local statics, so that the header can be included in multiple translation units. The accessors are
+// in IRAM, because they are called by the interrupt service routine.
+
+/// Set by the GPIO interrupt
+IRAM_ATTR inline volatile bool &triggerInterruptRaised() {
+    static volatile bool trigger_interrupt_raised = false;
+    return trigger_interrupt_raised;
+}
+
+#ifdef ESP32
+/// Task which is waiting for the GPIO interrupt
+IRAM_ATTR inline TaskHandle_t &triggerInterruptTask() {
+    static TaskHandle_t trigger_interrupt_task = nullptr;
+    return trigger_interrupt_task;
+}
+#endif
+
+/**
+ * @brief TriggerInterrupt which uses the Arduino attachInterrupt() on a GPIO pin. On the ESP32 the waiting task is
+ * suspended until the interrupt is raised and on the RP2040 the core sleeps with wfe until the interrupt (or the timeout)
+ * wakes it up. On the other processors we just check a flag and call yield(), so the core stays busy. Only one
+ * instance can be active at the same time.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class TriggerInterruptGPIO : public TriggerInterrupt {
+    public:
+        /// Activates the interrupt which is raised when the pin changes to the indicated level: returns false if the pin is not supported
+        bool begin(uint8_t pin, bool level) {
+            int irq = digitalPinToInterrupt(pin);
+            if (irq==NOT_AN_INTERRUPT){
+                logWarning("No interrupt for pin %d", pin);
+                return false;
+            }
+            logDebug("TriggerInterruptGPIO pin %d level %d", pin, level);
+            triggerInterruptRaised() = false;
+#ifdef ESP32
+            triggerInterruptTask() = xTaskGetCurrentTaskHandle();
+            // ignore old notifications
+            ulTaskNotifyTake(pdTRUE, 0);
+#endif
+            active_pin = pin;
+            attachInterrupt(irq, onInterrupt, level ? RISING : FALLING);
+            return true;
+        }
+
+        /// Sleeps until the interrupt has been raised or the timeout has passed: returns true if the interrupt has been raised
+        bool wait(uint32_t timeout_us) {
+#ifdef ESP32
+            if (!triggerInterruptRaised()){
+                TickType_t ticks = pdMS_TO_TICKS(timeout_us / 1000);
+                ulTaskNotifyTake(pdTRUE, ticks == 0 ? 1 : ticks);
+            }
+#elif defined(ARDUINO_ARCH_RP2040)
+            // the interrupt is raised on the core which called begin(), so it wakes up the wfe
+            absolute_time_t until = make_timeout_time_us(timeout_us);
+            while (!triggerInterruptRaised() && !best_effort_wfe_or_timeout(until));
+#else
+            uint32_t start = micros();
+            while (!triggerInterruptRaised() && micros() - start < timeout_us){
+                yield();
+            }
+#endif
+            return triggerInterruptRaised();
+        }
+
+        /// Deactivates the interrupt
+        void end() {
+            if (active_pin>=0){
+                detachInterrupt(digitalPinToInterrupt(active_pin));
+                active_pin = -1;
+            }
+        }
+
+    protected:
+        int active_pin = -1;
+
+        /// Interrupt service routine
+        static void IRAM_ATTR onInterrupt() {
+            triggerInterruptRaised() = true;
+#ifdef ESP32
+            BaseType_t is_woken = pdFALSE;
+            vTaskNotifyGiveFromISR(triggerInterruptTask(), &is_woken);
+            if (is_woken) {
+                portYIELD_FROM_ISR();
+            }
+#endif
+        }
+};
+
+} // namespace
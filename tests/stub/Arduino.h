@@ -0,0 +1,146 @@
+/**
+ * @file Arduino.h
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Minimal replacement of the Arduino API and of the platform configuration, so that the library can be
+ * compiled and tested on the host. The PinBitArray can be defined with HOST_PIN_BIT_ARRAY.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <chrono>
+#include <thread>
+
+typedef uint8_t byte;
+
+#define INPUT 0
+#define OUTPUT 1
+#define LOW 0
+#define HIGH 1
+#define DEC 10
+#define HEX 16
+#define BIN 2
+#define RISING 1
+#define FALLING 2
+#define CHANGE 3
+#define LED_BUILTIN 13
+#define NOT_AN_INTERRUPT -1
+
+inline unsigned long micros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+inline unsigned long millis() { return micros() / 1000; }
+inline void delay(unsigned long ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+inline void delayMicroseconds(unsigned int us) { std::this_thread::sleep_for(std::chrono::microseconds(us)); }
+inline void yield() {}
+inline void noInterrupts() {}
+inline void interrupts() {}
+inline void pinMode(int, int) {}
+inline void digitalWrite(int, int) {}
+inline int digitalRead(int) { return 0; }
+inline void analogWrite(int, int) {}
+inline void attachInterrupt(int, void (*)(), int) {}
+inline void detachInterrupt(int) {}
+inline int digitalPinToInterrupt(int pin) { return pin; }
+
+/// Output with the number formatting of the Arduino Print class
+class Print {
+    public:
+        virtual ~Print() {}
+        virtual size_t write(uint8_t c) = 0;
+        virtual size_t write(const uint8_t *data, size_t len) {
+            size_t result = 0;
+            for (size_t j = 0; j < len; j++) result += write(data[j]);
+            return result;
+        }
+        size_t write(const char *data, size_t len) { return write((const uint8_t *)data, len); }
+        size_t write(const char *str) { return write(str, strlen(str)); }
+        virtual int availableForWrite() { return 0; }
+        virtual void flush() {}
+
+        size_t print(const char *str) { return write(str); }
+        size_t print(char c) { return write((uint8_t)c); }
+        size_t print(int value, int base = DEC) { return print((long)value, base); }
+        size_t print(unsigned value, int base = DEC) { return print((unsigned long)value, base); }
+        size_t print(long value, int base = DEC) { return value < 0 && base == DEC ? print('-') + print((unsigned long)-value, base) : print((unsigned long)value, base); }
+        size_t print(unsigned long value, int base = DEC) {
+            char tmp[40];
+            snprintf(tmp, sizeof(tmp), base == HEX ? "%lx" : "%lu", value);
+            return write(tmp);
+        }
+        size_t print(double value, int digits = 2) {
+            char tmp[64];
+            snprintf(tmp, sizeof(tmp), "%.*f", digits, value);
+            return write(tmp);
+        }
+        size_t println() { return write("\n"); }
+        template <typename T> size_t println(T value) { return print(value) + println(); }
+        template <typename T> size_t println(T value, int format) { return print(value, format) + println(); }
+};
+
+/// Input with the blocking reads of the Arduino Stream class
+class Stream : public Print {
+    public:
+        virtual int available() = 0;
+        virtual int read() = 0;
+        virtual int peek() { return -1; }
+        void setTimeout(unsigned long) {}
+        size_t readBytes(uint8_t *data, size_t len) {
+            size_t j = 0;
+            for (; j < len; j++) {
+                int c = read();
+                if (c < 0) break;
+                data[j] = c;
+            }
+            return j;
+        }
+        size_t readBytes(char *data, size_t len) { return readBytes((uint8_t *)data, len); }
+};
+
+#ifndef HOST_PIN_BIT_ARRAY
+#define HOST_PIN_BIT_ARRAY uint8_t
+#endif
+
+#define MAX_CAPTURE_SIZE 1000
+#define SERIAL_SPEED 921600
+#define SERIAL_TIMEOUT 50
+#define MAX_FREQ 1000000
+#define MAX_FREQ_THRESHOLD 500000
+#define START_PIN 0
+#define PIN_COUNT (sizeof(HOST_PIN_BIT_ARRAY) * 8)
+#define DESCRIPTION "Host"
+
+namespace logic_analyzer {
+
+typedef HOST_PIN_BIT_ARRAY PinBitArray;
+
+/// Value which is provided by the PinReader
+inline PinBitArray &hostPins() {
+    static PinBitArray pins = 0;
+    return pins;
+}
+
+/// Reads the pins which have been defined with hostPins()
+class PinReader {
+    public:
+        PinReader(int startPin) { start_pin = startPin; }
+        inline PinBitArray readAll() { return hostPins(); }
+
+    protected:
+        int start_pin;
+};
+
+/// Simulated cycle counter with 1 MHz which advances by 1 tick on each call
+inline uint32_t cycleCount() {
+    static uint32_t count = 0;
+    return ++count;
+}
+
+inline uint32_t cycleFrequency() { return 1000000; }
+
+} // namespace
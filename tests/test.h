@@ -0,0 +1,67 @@
+/**
+ * @file test.h
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Minimal test support for the host tests: the failed checks are reported and counted and the test program
+ * returns the number of failures.
+ */
+#pragma once
+
+#include <stdio.h>
+#include <string>
+#include "Arduino.h"
+
+/// Number of failed checks
+inline int &testFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+/// Reports a failure if the condition is false
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            testFailures()++; \
+        } \
+    } while (0)
+
+/// Reports the result and provides the exit code of the test program
+inline int testResult(const char *name) {
+    printf("%s: %s (%d failures)\n", name, testFailures() == 0 ? "ok" : "FAILED", testFailures());
+    return testFailures() == 0 ? 0 : 1;
+}
+
+/**
+ * @brief Stream which provides the input from a string and collects the output
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MemoryStream : public Stream {
+    public:
+        std::string input;
+        std::string output;
+        size_t input_pos = 0;
+
+        size_t write(uint8_t c) {
+            output += (char) c;
+            return 1;
+        }
+
+        size_t write(const uint8_t *data, size_t len) {
+            output.append((const char *)data, len);
+            return len;
+        }
+
+        int availableForWrite() {
+            return 1024;
+        }
+
+        int available() {
+            return input.size() - input_pos;
+        }
+
+        int read() {
+            return input_pos < input.size() ? (uint8_t) input[input_pos++] : -1;
+        }
+};
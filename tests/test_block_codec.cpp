@@ -0,0 +1,181 @@
+/**
+ * @file test_block_codec.cpp
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Round trip of the BlockCodec with the test patterns, a compressed continuous capture with active statistics
+ * which must end the stream only once, the hand off of the blocks to a second thread and the measured encoder
+ * throughput with the Benchmark.
+ */
+#include <vector>
+#include <thread>
+#include <atomic>
+#include "test.h"
+#include "logic_analyzer.h"
+#include "benchmark.h"
+
+using namespace logic_analyzer;
+
+static const size_t count = 3000;
+
+/// Provides the sample in the SUMP wire format for the enabled groups
+void append(std::string &result, PinBitArray sample, uint8_t groups) {
+    for (int g = 0; g < 4; g++) {
+        if ((groups >> g) & 1) result += (char)(g < (int) sizeof(PinBitArray) ? sample >> (g * 8) : 0);
+    }
+}
+
+/// Decodes all blocks: returns the SUMP wire format and counts the blocks and the end markers
+std::string decode(const std::string &data, int &blocks, int &ends) {
+    std::string result;
+    BlockDecoder decoder;
+    size_t pos = 0;
+    blocks = 0;
+    ends = 0;
+    while (pos + BLOCK_CODEC_HEADER_SIZE <= data.size()) {
+        const uint8_t *block = (const uint8_t *) data.data() + pos;
+        if (!decoder.begin(block, data.size() - pos)) break;
+        blocks++;
+        if (decoder.sampleCount() == 0) ends++;
+        std::vector<uint8_t> samples(decoder.sampleCount() * decoder.bytesPerSample());
+        size_t n = decoder.read(samples.data(), decoder.sampleCount());
+        result.append((const char *) samples.data(), n * decoder.bytesPerSample());
+        pos += BLOCK_CODEC_HEADER_SIZE + (block[4] << 8 | block[5]);
+    }
+    CHECK(pos == data.size());
+    return result;
+}
+
+/// Encodes the test pattern and compares the decoded data with the SUMP wire format
+void testRoundTrip(TestPatternMode mode, uint8_t groups) {
+    static BlockCodec codec;
+    TestPatternGenerator generator;
+    generator.begin(mode);
+    codec.begin(groups);
+    std::string encoded;
+    std::string expected;
+    size_t len;
+    for (size_t j = 0; j < count; j++) {
+        PinBitArray sample = generator.readAll();
+        append(expected, sample, groups);
+        if (codec.add(sample)) {
+            const uint8_t *block = codec.encodeBlock(len);
+            encoded.append((const char *) block, len);
+        }
+    }
+    for (int j = 0; j < 2; j++) {
+        // open block and end marker
+        const uint8_t *block = codec.encodeBlock(len);
+        encoded.append((const char *) block, len);
+    }
+    int blocks, ends;
+    CHECK(decode(encoded, blocks, ends) == expected);
+    CHECK(ends == 1);
+    CHECK(codec.sampleCount() == count);
+}
+
+/// Continuous capture with the statistics, which get the samples in blocks: the stream must be ended only once
+void testContinuous() {
+    MemoryStream stream;
+    LogicAnalyzer la;
+    Capture capture(MAX_FREQ, MAX_FREQ_THRESHOLD);
+    static BlockCodec codec;
+    SignalStatistics statistics;
+    la.begin(stream, &capture, MAX_CAPTURE_SIZE, 0, 8);
+    la.setBlockCodec(codec);
+    la.setStatistics(statistics);
+    la.setChannelGroups(1);
+    la.setTestPattern(TEST_PATTERN_COUNTER);
+    la.setContinuousCapture(true);
+    la.setStatus(TRIGGERED);
+    capture.state().beginCapture(capture.state().armedConfig());
+    for (size_t j = 0; j < count; j++) {
+        capture.captureSampleFastContinuous(capture.state().testPatternGenerator());
+    }
+    capture.state().endContinuous();
+    int blocks, ends;
+    std::string data = decode(stream.output, blocks, ends);
+    CHECK(ends == 1);
+    CHECK(data.size() == count);
+    int errors = 0;
+    for (size_t j = 1; j < data.size(); j++) {
+        errors += (uint8_t) data[j] != (uint8_t)(data[j - 1] + 1);
+    }
+    CHECK(errors == 0);
+}
+
+/// Continuous capture where the full blocks are encoded and sent by a second thread: w/o the thread the capturing 
+/// needs to send them itself, which is counted as stall
+void testHandOff(bool withThread) {
+    const size_t samples = 100000;
+    MemoryStream stream;
+    LogicAnalyzer la;
+    Capture capture(MAX_FREQ, MAX_FREQ_THRESHOLD);
+    static BlockCodec codec;
+    la.begin(stream, &capture, MAX_CAPTURE_SIZE, 0, 8);
+    la.setBlockCodec(codec);
+    la.setChannelGroups(1);
+    la.setTestPattern(TEST_PATTERN_COUNTER);
+    la.setContinuousCapture(true);
+    la.setStatus(TRIGGERED);
+    LogicAnalyzerState &state = capture.state();
+    state.beginCapture(state.armedConfig());
+    std::atomic<bool> is_done(false);
+    std::thread sender([&]() {
+        while (withThread && !is_done) state.writePendingBlock();
+    });
+    for (size_t j = 0; j < samples; j++) {
+        capture.captureSampleFastContinuous(state.testPatternGenerator());
+        // the sampling rate is limited like on a device: the thread has time to encode a block while the next one is filled
+        if (withThread && j % BLOCK_CODEC_SAMPLES == 0) std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+    state.endContinuous();
+    is_done = true;
+    sender.join();
+    int blocks, ends;
+    std::string data = decode(stream.output, blocks, ends);
+    CHECK(ends == 1);
+    CHECK(data.size() == samples);
+    int errors = 0;
+    for (size_t j = 1; j < data.size(); j++) {
+        errors += (uint8_t) data[j] != (uint8_t)(data[j - 1] + 1);
+    }
+    CHECK(errors == 0);
+    CHECK(codec.sampleCount() == samples);
+    // w/o the thread each block after the first one needs to send the previous one
+    if (!withThread) CHECK(codec.stallCount() == samples / BLOCK_CODEC_SAMPLES - 1);
+    // the thread takes the blocks (we allow some stalls for the scheduling of the host)
+    if (withThread) CHECK(codec.stallCount() < samples / BLOCK_CODEC_SAMPLES / 4);
+    printf("hand off %s thread: %lu stalls for %lu blocks\n", withThread ? "with" : "w/o", (unsigned long) codec.stallCount(), (unsigned long) (samples / BLOCK_CODEC_SAMPLES));
+}
+
+/// Measures the encoder throughput with the test patterns and prints the result
+void testThroughput() {
+    MemoryStream out;
+    LogicAnalyzer la;
+    Capture capture(MAX_FREQ, MAX_FREQ_THRESHOLD);
+    static BlockCodec codec;
+    Benchmark benchmark(la, out);
+    benchmark.begin(capture, 100000, 0, 16);
+    for (TestPatternMode mode : {TEST_PATTERN_COUNTER, TEST_PATTERN_PRBS}) {
+        la.setTestPattern(mode);
+        benchmark.setLabel(mode == TEST_PATTERN_COUNTER ? "counter" : "prbs");
+        for (uint16_t pins : {8, 16}) {
+            BenchmarkResult result = benchmark.compression(capture, codec, pins, 100000);
+            CHECK(result.values.mean() > 0);
+            CHECK(codec.sampleCount() == 100000);
+        }
+    }
+    printf("%s", out.output.c_str());
+}
+
+int main() {
+    for (int mode = TEST_PATTERN_COUNTER; mode <= TEST_PATTERN_PRBS; mode++) {
+        testRoundTrip((TestPatternMode) mode, 1);
+        testRoundTrip((TestPatternMode) mode, 3);
+    }
+    testContinuous();
+    testHandOff(false);
+    testHandOff(true);
+    testThroughput();
+    return testResult("test_block_codec");
+}
@@ -0,0 +1,178 @@
+/**
+ * @file test_decoder.cpp
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Decodes synthetic UART, SPI and I2C waveforms and compares the frames with the encoded values: SPI in all
+ * modes with and w/o chip select, UART with different oversampling ratios and an invalid stop bit and I2C with
+ * START, address, ACK, NACK and STOP.
+ */
+#include <vector>
+#include "test.h"
+#include "logic_analyzer.h"
+
+using namespace logic_analyzer;
+
+typedef std::vector<PinBitArray> Samples;
+
+/// Decodes the samples in small blocks (so that the state must be kept between the blocks) and returns the frames
+std::vector<DecodedFrame> decode(Decoder &decoder, const Samples &samples) {
+    MemoryStream out;
+    decoder.setOutput(out);
+    decoder.reset();
+    for (size_t pos = 0; pos < samples.size(); pos += 7) {
+        size_t len = samples.size() - pos < 7 ? samples.size() - pos : 7;
+        decoder.decode(samples.data() + pos, len);
+    }
+    std::vector<DecodedFrame> result;
+    const uint8_t *data = (const uint8_t *) out.output.data();
+    for (size_t pos = 0; pos + 6 <= out.output.size(); pos += 6) {
+        DecodedFrame frame;
+        frame.type = data[pos];
+        frame.value = data[pos + 1];
+        frame.timestamp = (uint32_t) data[pos + 2] << 24 | data[pos + 3] << 16 | data[pos + 4] << 8 | data[pos + 5];
+        result.push_back(frame);
+    }
+    CHECK(out.output.size() == result.size() * 6);
+    CHECK(decoder.frameCount() == result.size());
+    return result;
+}
+
+/// Adds count samples with the indicated value
+void add(Samples &samples, PinBitArray value, int count = 1) {
+    for (int j = 0; j < count; j++) samples.push_back(value);
+}
+
+/// UART on channel 0: the last byte gets an invalid stop bit
+void testUART(float samplesPerBit) {
+    const uint8_t values[] = {0x55, 0x00, 0xFF, 0xA3};
+    Samples samples;
+    std::vector<uint32_t> starts;
+    // the bits are generated with the exact (fractional) bit time
+    std::vector<int> bits;
+    for (int j = 0; j < 3; j++) bits.push_back(1);
+    for (size_t v = 0; v < sizeof(values); v++) {
+        starts.push_back(bits.size());
+        bits.push_back(0);
+        for (int b = 0; b < 8; b++) bits.push_back((values[v] >> b) & 1);
+        bits.push_back(v == sizeof(values) - 1 ? 0 : 1);
+        bits.push_back(1);
+    }
+    for (int j = 0; j < 3; j++) bits.push_back(1);
+    size_t count = bits.size() * samplesPerBit;
+    for (size_t j = 0; j < count; j++) add(samples, bits[(size_t)(j / samplesPerBit)]);
+
+    UARTDecoder decoder(0, samplesPerBit);
+    std::vector<DecodedFrame> frames = decode(decoder, samples);
+    CHECK(frames.size() == sizeof(values));
+    for (size_t j = 0; j < frames.size() && j < sizeof(values); j++) {
+        CHECK(frames[j].type == (j == sizeof(values) - 1 ? FRAME_ERROR : FRAME_DATA));
+        CHECK(frames[j].value == values[j]);
+        // the frame starts at the first sample of the start bit
+        uint32_t start = starts[j] * samplesPerBit;
+        CHECK(frames[j].timestamp >= start && frames[j].timestamp <= start + 1);
+    }
+}
+
+/// SPI with CLK=0, MOSI=1, MISO=2 and CS=3: the data changes with the shift edge and is stable at the sample edge
+void testSPI(uint8_t mode, bool withCS) {
+    const uint8_t mosi[] = {0xA5, 0x3C, 0x01};
+    const uint8_t miso[] = {0x5A, 0xC3, 0x80};
+    PinBitArray idle = (mode & 2) ? 1 : 0;
+    PinBitArray active = idle ^ 1;
+    bool cpha = mode & 1;
+    PinBitArray cs = withCS ? 0b1000 : 0;
+    Samples samples;
+    add(samples, idle | cs, 4);
+    if (withCS) add(samples, idle, 2);
+    for (size_t v = 0; v < sizeof(mosi); v++) {
+        for (int b = 7; b >= 0; b--) {
+            PinBitArray data = ((mosi[v] >> b) & 1) << 1 | ((miso[v] >> b) & 1) << 2;
+            if (cpha) {
+                add(samples, active | data, 2);
+                add(samples, idle | data, 2);
+            } else {
+                add(samples, idle | data, 2);
+                add(samples, active | data, 2);
+            }
+        }
+    }
+    add(samples, idle, 2);
+    add(samples, idle | cs, 4);
+
+    SPIDecoder decoder(0, 1, 2, withCS ? 3 : -1, mode);
+    std::vector<DecodedFrame> frames = decode(decoder, samples);
+    size_t expected = sizeof(mosi) * 2 + (withCS ? 2 : 0);
+    CHECK(frames.size() == expected);
+    if (frames.size() != expected) return;
+    size_t pos = 0;
+    if (withCS) {
+        CHECK(frames[pos].type == FRAME_START);
+        CHECK(frames[pos++].timestamp == 4);
+    }
+    for (size_t v = 0; v < sizeof(mosi); v++) {
+        CHECK(frames[pos].type == FRAME_DATA);
+        CHECK(frames[pos++].value == mosi[v]);
+        CHECK(frames[pos].type == FRAME_MISO);
+        CHECK(frames[pos++].value == miso[v]);
+    }
+    if (withCS) {
+        CHECK(frames[pos].type == FRAME_STOP);
+        CHECK(frames[pos].timestamp == samples.size() - 4);
+    }
+}
+
+/// I2C bit with SCL=0 and SDA=1: SDA changes while SCL is low
+void addI2CBit(Samples &samples, bool bit) {
+    PinBitArray sda = bit ? 0b10 : 0;
+    add(samples, sda, 2);
+    add(samples, sda | 0b01, 2);
+    add(samples, sda, 2);
+}
+
+/// I2C byte followed by the acknowledge bit
+void addI2CByte(Samples &samples, uint8_t value, bool ack) {
+    for (int b = 7; b >= 0; b--) addI2CBit(samples, (value >> b) & 1);
+    addI2CBit(samples, !ack);
+}
+
+/// I2C write of 2 bytes to the address 0x50: the last byte is not acknowledged
+void testI2C() {
+    Samples samples;
+    add(samples, 0b11, 4);
+    // START: SDA falls while SCL is high
+    add(samples, 0b01, 2);
+    add(samples, 0b00, 2);
+    addI2CByte(samples, 0x50 << 1, true);
+    addI2CByte(samples, 0x3C, true);
+    addI2CByte(samples, 0xFF, false);
+    // STOP: SDA rises while SCL is high
+    add(samples, 0b00, 2);
+    add(samples, 0b01, 2);
+    add(samples, 0b11, 4);
+
+    I2CDecoder decoder(0, 1);
+    std::vector<DecodedFrame> frames = decode(decoder, samples);
+    const uint8_t types[] = {FRAME_START, FRAME_ADDRESS, FRAME_ACK, FRAME_DATA, FRAME_ACK, FRAME_DATA, FRAME_NACK, FRAME_STOP};
+    const uint8_t values[] = {0, 0xA0, 0, 0x3C, 0, 0xFF, 0, 0};
+    CHECK(frames.size() == sizeof(types));
+    for (size_t j = 0; j < frames.size() && j < sizeof(types); j++) {
+        CHECK(frames[j].type == types[j]);
+        CHECK(frames[j].value == values[j]);
+    }
+    if (frames.size() == sizeof(types)) {
+        CHECK(frames[0].timestamp == 4);
+        CHECK(frames[7].timestamp == samples.size() - 4);
+    }
+}
+
+int main() {
+    for (float samplesPerBit : {3.0f, 4.5f, 8.0f, 16.0f}) {
+        testUART(samplesPerBit);
+    }
+    for (uint8_t mode = 0; mode < 4; mode++) {
+        testSPI(mode, false);
+        testSPI(mode, true);
+    }
+    testI2C();
+    return testResult("test_decoder");
+}
@@ -0,0 +1,155 @@
+/**
+ * @file test_framed_dump.cpp
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Sends a framed dump of the counter test pattern through a FaultInjectingStream and requests the corrupted 
+ * frames again with NAKs like receive_framed_dump.py: the received payload must be exactly the SUMP data.
+ */
+#include <map>
+#include <vector>
+#include "test.h"
+#include "logic_analyzer.h"
+
+using namespace logic_analyzer;
+
+static const size_t count = 1000;
+
+/// Collects the valid frames: corrupted data is skipped until the next magic byte
+class FrameReceiver {
+    public:
+        std::map<uint16_t, std::string> blocks;
+        int block_count = -1;
+        int crc_errors = 0;
+
+        void add(const std::string &received) {
+            data += received;
+            while (data.size() >= FRAMED_HEADER_SIZE + FRAMED_CRC_SIZE) {
+                const uint8_t *d = (const uint8_t *) data.data();
+                if (d[0] != FRAMED_MAGIC) {
+                    resync();
+                    continue;
+                }
+                uint16_t seq = d[1] << 8 | d[2];
+                size_t len = d[3] << 8 | d[4];
+                size_t size = FRAMED_HEADER_SIZE + len + FRAMED_CRC_SIZE;
+                if (data.size() < size) {
+                    // the link is idle: an incomplete frame can only be the result of a corrupted length
+                    resync();
+                    continue;
+                }
+                uint32_t crc = (uint32_t) d[size - 4] << 24 | (uint32_t) d[size - 3] << 16 | d[size - 2] << 8 | d[size - 1];
+                if (crc != CRC32::update(0, d, size - FRAMED_CRC_SIZE)) {
+                    crc_errors++;
+                    resync();
+                    continue;
+                }
+                if (len == 0) {
+                    block_count = seq;
+                } else {
+                    blocks[seq] = data.substr(FRAMED_HEADER_SIZE, len);
+                }
+                data.erase(0, size);
+            }
+            data.clear();
+        }
+
+        /// Sequence numbers which need to be requested again: w/o end frame we request the end frame
+        std::vector<uint16_t> missing() {
+            std::vector<uint16_t> result;
+            if (block_count < 0) {
+                result.push_back(0xFFFF);
+                return result;
+            }
+            for (int seq = 0; seq < block_count; seq++) {
+                if (blocks.find(seq) == blocks.end()) result.push_back(seq);
+            }
+            return result;
+        }
+
+        std::string result() {
+            std::string result;
+            for (int seq = 0; seq < block_count; seq++) result += blocks[seq];
+            return result;
+        }
+
+    protected:
+        std::string data;
+
+        void resync() {
+            size_t next = data.find((char) FRAMED_MAGIC, 1);
+            data.erase(0, next == std::string::npos ? data.size() : next);
+        }
+};
+
+/// Adds a SUMP command with a 32 bit argument
+void command(MemoryStream &stream, uint8_t cmd, uint32_t value) {
+    stream.input += (char) cmd;
+    for (int j = 0; j < 4; j++) stream.input += (char) (value >> (j * 8));
+}
+
+void processCommands(LogicAnalyzer &la, MemoryStream &stream) {
+    while (stream.available()) la.processCommand();
+    stream.input.clear();
+    stream.input_pos = 0;
+}
+
+int main() {
+    // SUMP data of the counter in the wire format of 2 channel groups
+    std::string expected;
+    for (size_t j = 0; j < count; j++) {
+        expected += (char) (j & 0xFF);
+        expected += (char) (j >> 8);
+    }
+
+    for (uint32_t seed = 1; seed <= 5; seed++) {
+        MemoryStream link;
+        FaultInjectingStream stream(link, 3000, seed);
+        LogicAnalyzer la;
+        Capture capture(MAX_FREQ, MAX_FREQ_THRESHOLD);
+        FramedDump framed_dump;
+        la.begin(stream, &capture, MAX_CAPTURE_SIZE, 0, 16);
+        la.setFramedDump(framed_dump);
+        la.setTestPattern(TEST_PATTERN_COUNTER);
+        command(link, SUMP_SET_DIVIDER, 99);
+        command(link, SUMP_SET_READ_DELAY_COUNT, (count / 4 - 1) | (count / 4 - 1) << 16);
+        link.input += (char) SUMP_ARM;
+        processCommands(la, link);
+        CHECK(la.framedDump() == &framed_dump);
+        CHECK(framed_dump.isPending());
+        CHECK(framed_dump.blockCount() == (count * 2 + FRAMED_BLOCK_SIZE - 1) / FRAMED_BLOCK_SIZE);
+
+        FrameReceiver receiver;
+        int rounds = 0;
+        while (true) {
+            receiver.add(link.output);
+            link.output.clear();
+            std::vector<uint16_t> missing = receiver.missing();
+            if (missing.empty() || ++rounds > 100) break;
+            for (uint16_t seq : missing) command(link, SUMP_FRAMED_NAK, seq);
+            processCommands(la, link);
+        }
+        CHECK(stream.errors() > 0);
+        CHECK(receiver.crc_errors > 0);
+        CHECK(framed_dump.retransmitCount() > 0);
+        CHECK(receiver.missing().empty());
+        CHECK(receiver.result() == expected);
+
+        // the ACK releases the samples
+        CHECK(la.buffer().available() == count);
+        link.input += (char) SUMP_FRAMED_ACK;
+        processCommands(la, link);
+        CHECK(!framed_dump.isPending());
+        CHECK(la.buffer().available() == 0);
+    }
+
+    // w/o FramedDump the host can't activate it
+    MemoryStream link;
+    LogicAnalyzer la;
+    Capture capture(MAX_FREQ, MAX_FREQ_THRESHOLD);
+    la.begin(link, &capture, MAX_CAPTURE_SIZE, 0, 8);
+    link.input += (char) SUMP_FRAMED_DUMP;
+    processCommands(la, link);
+    CHECK(!la.isFramedDump());
+    CHECK(la.framedDump() == nullptr);
+    return testResult("test_framed_dump");
+}
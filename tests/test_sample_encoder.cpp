@@ -0,0 +1,71 @@
+/**
+ * @file test_sample_encoder.cpp
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Checks the encoding of the channel groups for all 16 group masks against the expansion of sigrok, which
+ * reads 1 byte for each enabled group starting with the lowest group and sets the disabled groups to 0.
+ */
+#include "test.h"
+#include "sample_encoder.h"
+
+using namespace logic_analyzer;
+
+static const size_t count = 64;
+
+/// Expands the received bytes like the sigrok ols driver: the flags disable the groups with the bits 2-5
+size_t sigrokExpand(const uint8_t *data, size_t len, uint8_t flags, uint32_t *samples) {
+    size_t result = 0;
+    size_t pos = 0;
+    while (pos < len) {
+        uint32_t sample = 0;
+        for (int group = 0; group < 4; group++) {
+            if ((flags >> 2) & (1 << group)) continue;
+            sample |= (uint32_t)data[pos++] << (8 * group);
+        }
+        samples[result++] = sample;
+    }
+    return result;
+}
+
+int main() {
+    static_assert(sizeof(PinBitArray) == 4, "the test needs 32 bit samples");
+    CHECK(SampleEncoder::defaultGroups() == 0x0F);
+
+    PinBitArray samples[count];
+    uint32_t state = 0x12345678;
+    for (size_t j = 0; j < count; j++) {
+        state = state * 1664525 + 1013904223;
+        samples[j] = state;
+    }
+
+    SampleEncoder encoder;
+    CHECK(encoder.groups() == 0x0F);
+    CHECK(encoder.bytesPerSample() == 4);
+
+    for (uint8_t groups = 0; groups < 16; groups++) {
+        // pulseview disables the groups with the flags
+        uint8_t flags = (~groups & 0x0F) << 2;
+        CHECK(SampleEncoder::groupsFromFlags(flags) == groups);
+        // w/o enabled group we send group 0
+        uint8_t sent = groups == 0 ? 1 : groups;
+        encoder.setGroups(groups);
+        CHECK(encoder.groups() == sent);
+        CHECK(encoder.bytesPerSample() == __builtin_popcount(sent));
+
+        uint8_t data[count * 4];
+        size_t len = encoder.encode(samples, count, data);
+        CHECK(len == count * encoder.bytesPerSample());
+
+        uint32_t mask = 0;
+        for (int group = 0; group < 4; group++) {
+            if (sent & (1 << group)) mask |= 0xFFul << (8 * group);
+        }
+        uint32_t expanded[count];
+        uint8_t sent_flags = (~sent & 0x0F) << 2;
+        CHECK(sigrokExpand(data, len, sent_flags, expanded) == count);
+        for (size_t j = 0; j < count; j++) {
+            CHECK(expanded[j] == (samples[j] & mask));
+        }
+    }
+    return testResult("test_sample_encoder");
+}
@@ -0,0 +1,98 @@
+/**
+ * @file test_statistics.cpp
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Compares the SignalStatistics (transpose and popcount of blocks of 8 samples) with a naive evaluation of
+ * each sample. The samples are provided in blocks of different sizes, so that we also get partial blocks. The test
+ * is built with a PinBitArray of 8 and 32 bits.
+ */
+#include <vector>
+#include <algorithm>
+#include "test.h"
+#include "statistics.h"
+
+using namespace logic_analyzer;
+
+static const size_t count = 5000;
+static const int channels = sizeof(PinBitArray) * 8;
+
+/// Naive statistics of a single channel
+ChannelStatistics naive(const std::vector<PinBitArray> &samples, int ch) {
+    ChannelStatistics stat;
+    for (size_t j = 0; j < samples.size(); j++) {
+        bool level = (samples[j] >> ch) & 1;
+        stat.high_count += level;
+        // the first sample is not an edge
+        bool previous = j > 0 ? (samples[j - 1] >> ch) & 1 : level;
+        if (level == previous) continue;
+        if (level) stat.rising_edges++;
+        else stat.falling_edges++;
+        uint32_t width = j - stat.last_edge;
+        if (stat.has_edge && level) {
+            stat.min_low_width = std::min(stat.min_low_width, width);
+            stat.max_low_width = std::max(stat.max_low_width, width);
+        }
+        if (stat.has_edge && !level) {
+            stat.min_high_width = std::min(stat.min_high_width, width);
+            stat.max_high_width = std::max(stat.max_high_width, width);
+        }
+        if (level) {
+            if (!stat.has_rising) stat.first_rising = j;
+            stat.has_rising = true;
+            stat.last_rising = j;
+        }
+        stat.has_edge = true;
+        stat.last_edge = j;
+    }
+    return stat;
+}
+
+/// Random samples: channel n toggles with a probability of 1/(n+1), so that we get short and long pulses
+std::vector<PinBitArray> generate(uint32_t seed) {
+    std::vector<PinBitArray> samples;
+    PinBitArray value = 0;
+    for (size_t j = 0; j < count; j++) {
+        for (int ch = 0; ch < channels; ch++) {
+            seed = seed * 1103515245 + 12345;
+            if ((seed >> 16) % (ch + 1) == 0) value ^= (PinBitArray) 1 << ch;
+        }
+        samples.push_back(value);
+    }
+    return samples;
+}
+
+/// Updates the statistics with the indicated block size and compares each channel with the naive evaluation
+void testStatistics(uint32_t seed, size_t blockSize) {
+    std::vector<PinBitArray> samples = generate(seed);
+    static SignalStatistics statistics;
+    statistics.clear();
+    for (size_t pos = 0; pos < samples.size(); pos += blockSize) {
+        size_t len = samples.size() - pos < blockSize ? samples.size() - pos : blockSize;
+        statistics.update(samples.data() + pos, len);
+    }
+    CHECK(statistics.size() == samples.size());
+    for (int ch = 0; ch < channels; ch++) {
+        ChannelStatistics expected = naive(samples, ch);
+        ChannelStatistics &stat = statistics.channel(ch);
+        CHECK(stat.high_count == expected.high_count);
+        CHECK(stat.rising_edges == expected.rising_edges);
+        CHECK(stat.falling_edges == expected.falling_edges);
+        CHECK(stat.min_high_width == expected.min_high_width);
+        CHECK(stat.max_high_width == expected.max_high_width);
+        CHECK(stat.min_low_width == expected.min_low_width);
+        CHECK(stat.max_low_width == expected.max_low_width);
+        CHECK(stat.first_rising == expected.first_rising);
+        CHECK(stat.last_rising == expected.last_rising);
+        CHECK(stat.last_edge == expected.last_edge);
+    }
+}
+
+int main() {
+    // full blocks only, partial blocks at the end, misaligned blocks and single samples
+    for (size_t blockSize : {8, 64, 4096, 1, 3, 13, 100}) {
+        testStatistics(1, blockSize);
+        testStatistics(4711, blockSize);
+    }
+    printf("PinBitArray with %d bits\n", channels);
+    return testResult("test_statistics");
+}
@@ -0,0 +1,123 @@
+/**
+ * @file test_storage.cpp
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Writes snapshots with all encodings to the FileStorage and reads them back. The replay must convert the 
+ * stored samples to the channel groups, the read count and the compression of the actual session.
+ */
+#include "test.h"
+#include "logic_analyzer.h"
+
+using namespace logic_analyzer;
+
+static const char *name = "test_storage.sump";
+static const size_t count = 600;
+static PinBitArray samples[count];
+
+/// Encodes the samples in the SUMP wire format of the indicated groups
+std::string wireFormat(uint8_t groups, size_t len) {
+    SampleEncoder encoder;
+    encoder.setGroups(groups);
+    std::string result;
+    uint8_t data[4];
+    for (size_t j = 0; j < len; j++) {
+        PinBitArray value = samples[j < count ? j : count - 1];
+        result.append((const char *)data, encoder.encode(&value, 1, data));
+    }
+    return result;
+}
+
+/// Stores the samples with 2 channel groups
+void save(FileStorage &storage, SnapshotEncoding encoding, BlockCodec &codec) {
+    SnapshotHeader header;
+    header.encoding = encoding;
+    header.channel_groups = 3;
+    header.sample_count = count;
+    SnapshotWriter writer(storage, &codec);
+    CHECK(writer.begin(name, header));
+    writer.write(samples, count);
+    CHECK(writer.end());
+}
+
+/// Decodes the blocks of a compressed stream into the SUMP wire format
+std::string decodeBlocks(const std::string &data) {
+    std::string result;
+    BlockDecoder decoder;
+    size_t pos = 0;
+    while (pos + BLOCK_CODEC_HEADER_SIZE <= data.size()) {
+        const uint8_t *block = (const uint8_t *)data.data() + pos;
+        size_t len = BLOCK_CODEC_HEADER_SIZE + (block[4] << 8 | block[5]);
+        if (!decoder.begin(block, len) || decoder.sampleCount() == 0) break;
+        uint8_t out[64];
+        size_t n;
+        while ((n = decoder.read(out, sizeof(out) / decoder.bytesPerSample())) > 0) {
+            result.append((const char *)out, n * decoder.bytesPerSample());
+        }
+        pos += len;
+    }
+    return result;
+}
+
+int main() {
+    // slow signals on the low byte and fast ones on the high byte, so that all encodings have some work
+    for (size_t j = 0; j < count; j++) {
+        samples[j] = ((j / 25) & 0xFF) | ((j * 7) & 0xFF) << 8;
+    }
+    FileStorage storage;
+    BlockCodec codec;
+
+    for (int encoding = SNAPSHOT_RAW; encoding <= SNAPSHOT_BLOCK; encoding++) {
+        save(storage, (SnapshotEncoding) encoding, codec);
+
+        // replay w/o conversion
+        SnapshotReader reader(storage);
+        CHECK(reader.begin(name));
+        CHECK(reader.header().encoding == encoding);
+        CHECK(reader.header().channel_groups == 3);
+        MemoryStream out;
+        CHECK(reader.replay(out) == count);
+        CHECK(out.output == wireFormat(3, count));
+
+        // read the samples
+        CHECK(reader.begin(name));
+        PinBitArray values[count];
+        size_t len = 0, n;
+        while ((n = reader.read(values + len, 64)) > 0) len += n;
+        reader.end();
+        CHECK(len == count);
+        CHECK(memcmp(values, samples, sizeof(values)) == 0);
+
+        // replay with the format of the session
+        MemoryStream stream;
+        LogicAnalyzer la;
+        Capture capture(MAX_FREQ, MAX_FREQ_THRESHOLD);
+        la.begin(stream, &capture, MAX_CAPTURE_SIZE, 0, 16);
+        la.setStorage(storage, name);
+        struct Session { uint8_t groups; size_t read_count; bool compressed; } sessions[] = {
+            {3, count, false}, {1, count, false}, {2, 200, false}, {3, 800, false}, {1, 300, true}, {3, count, true},
+        };
+        for (Session &session : sessions) {
+            la.setChannelGroups(session.groups);
+            la.setReadCount(session.read_count);
+            if (session.compressed) la.setBlockCodec(codec);
+            else la.clearBlockCodec();
+            stream.output.clear();
+            size_t replayed = la.replay();
+            CHECK(replayed == (session.read_count < count ? session.read_count : count));
+            std::string expected = wireFormat(session.groups, session.read_count);
+            CHECK((session.compressed ? decodeBlocks(stream.output) : stream.output) == expected);
+        }
+
+        // replay on arm
+        la.clearBlockCodec();
+        la.setChannelGroups(1);
+        la.setReadCount(count);
+        la.setReplayOnArm(true);
+        stream.output.clear();
+        stream.input = std::string(1, (char) SUMP_ARM);
+        while (stream.available()) la.processCommand();
+        CHECK(stream.output == wireFormat(1, count));
+    }
+    remove(name);
+    return testResult("test_storage");
+}
@@ -0,0 +1,74 @@
+/**
+ * @file test_test_pattern.cpp
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Captures the test patterns with the SUMP commands at max speed and with a delay between the samples, and 
+ * verifies the received data. W/o test pattern we must get the pins.
+ */
+#include <vector>
+#include "test.h"
+#include "logic_analyzer.h"
+
+using namespace logic_analyzer;
+
+static const size_t count = 200;
+
+/// Captures count samples with the indicated SUMP divider
+std::string capture(TestPatternMode mode, uint16_t divider) {
+    MemoryStream stream;
+    LogicAnalyzer la;
+    Capture capture(MAX_FREQ, MAX_FREQ_THRESHOLD);
+    la.begin(stream, &capture, MAX_CAPTURE_SIZE, 0, 8);
+    la.setTestPattern(mode);
+    uint16_t counts = count / 4 - 1;
+    const char commands[] = {
+        (char) SUMP_SET_DIVIDER, (char) (divider & 0xFF), (char) (divider >> 8), 0, 0,
+        (char) SUMP_SET_READ_DELAY_COUNT, (char) (counts & 0xFF), (char) (counts >> 8), (char) (counts & 0xFF), (char) (counts >> 8),
+        (char) SUMP_ARM,
+    };
+    stream.input = std::string(commands, sizeof(commands));
+    while (stream.available()) la.processCommand();
+    return stream.output;
+}
+
+/// Counts the samples which do not follow the pattern
+int errors(TestPatternMode mode, const std::string &data) {
+    const uint8_t *d = (const uint8_t *) data.data();
+    int result = 0;
+    if (mode == TEST_PATTERN_PRBS) {
+        // PRBS-15 bit stream with the oldest bit in the MSB
+        std::vector<int> bits;
+        for (size_t j = 0; j < data.size(); j++) {
+            for (int b = 7; b >= 0; b--) bits.push_back((d[j] >> b) & 1);
+        }
+        for (size_t k = 15; k < bits.size(); k++) result += bits[k] != (bits[k - 15] ^ bits[k - 14]);
+        return result;
+    }
+    for (size_t j = 1; j < data.size(); j++) {
+        switch (mode) {
+            case TEST_PATTERN_COUNTER:
+                result += d[j] != (uint8_t)(d[j - 1] + 1);
+                break;
+            case TEST_PATTERN_WALKING_ONES:
+                result += d[j] != (uint8_t)(d[j - 1] << 1 | d[j - 1] >> 7);
+                break;
+            default:
+                result += d[j] != hostPins();
+                break;
+        }
+    }
+    return result;
+}
+
+int main() {
+    hostPins() = 0x5A;
+    // 1 MHz is captured at max speed and 100 kHz with a delay
+    for (uint16_t divider : {99, 999}) {
+        for (int mode = TEST_PATTERN_OFF; mode <= TEST_PATTERN_PRBS; mode++) {
+            std::string data = capture((TestPatternMode) mode, divider);
+            CHECK(data.size() == count);
+            CHECK(errors((TestPatternMode) mode, data) == 0);
+        }
+    }
+    return testResult("test_test_pattern");
+}
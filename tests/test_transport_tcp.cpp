@@ -0,0 +1,93 @@
+/**
+ * @file test_transport_tcp.cpp
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @brief Loopback test of the TCPServerTransport: a client sends the SUMP ID command and must get the device id. A
+ * client which does not read the data must be disconnected after the TRANSPORT_TIMEOUT_MS.
+ */
+#include "test.h"
+#include "logic_analyzer.h"
+#include "transport_tcp.h"
+#include <arpa/inet.h>
+
+using namespace logic_analyzer;
+
+/// Starts the server on the first free port starting from TRANSPORT_TCP_PORT: returns the port or 0
+uint16_t beginServer(TCPServerTransport &tcp) {
+    for (uint16_t port = TRANSPORT_TCP_PORT; port < TRANSPORT_TCP_PORT + 100; port++) {
+        if (tcp.begin(port)) return port;
+    }
+    return 0;
+}
+
+/// Connects a client socket to the server on the local host: returns -1 if this failed
+int connectClient(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = inet_addr("127.0.0.1");
+    address.sin_port = htons(port);
+    if (fd >= 0 && connect(fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/// The SUMP ID command is answered with 1ALS
+void testId() {
+    static TCPServerTransport tcp;
+    uint16_t port = beginServer(tcp);
+    CHECK(port != 0);
+    LogicAnalyzer la;
+    Capture capture(MAX_FREQ, MAX_FREQ_THRESHOLD);
+    la.begin(tcp, &capture, MAX_CAPTURE_SIZE, 0, 8);
+    int fd = connectClient(port);
+    CHECK(fd >= 0);
+    if (fd < 0) return;
+    uint8_t command = SUMP_ID;
+    CHECK(send(fd, &command, 1, 0) == 1);
+    std::string reply;
+    unsigned long start = millis();
+    while (reply.size() < 4 && millis() - start < 2000) {
+        la.processCommand();
+        char data[8];
+        int len = recv(fd, data, sizeof(data), MSG_DONTWAIT);
+        if (len > 0) reply.append(data, len);
+    }
+    CHECK(reply == "1ALS");
+    close(fd);
+    tcp.end();
+}
+
+/// A client which does not read the data must not block the writer: it is disconnected after the timeout
+void testStalledClient() {
+    static TCPServerTransport tcp;
+    uint16_t port = beginServer(tcp);
+    CHECK(port != 0);
+    int fd = connectClient(port);
+    CHECK(fd >= 0);
+    if (fd < 0) return;
+    CHECK(tcp.connected());
+    static uint8_t data[1024 * 1024];
+    unsigned long start = millis();
+    // the socket buffers of the host are much smaller than 256 MB
+    for (int j = 0; j < 256 && tcp.connected(); j++) {
+        tcp.write(data, sizeof(data));
+    }
+    tcp.flush();
+    unsigned long duration = millis() - start;
+    CHECK(!tcp.connected());
+    CHECK(duration >= TRANSPORT_TIMEOUT_MS);
+    CHECK(duration < TRANSPORT_TIMEOUT_MS * 10);
+    printf("stalled client disconnected after %lu ms\n", duration);
+    close(fd);
+    tcp.end();
+}
+
+int main() {
+    testId();
+    testStalledClient();
+    return testResult("test_transport_tcp");
+}
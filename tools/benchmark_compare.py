@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+"""
+Reads the results of the benchmark harness (examples/logic-analyzer-test) as CSV or JSON lines from the serial port,
+a file or stdin. The results can be stored as baseline and compared with a stored baseline: a benchmark is flagged as
+regression if its mean is more than the tolerance below the baseline. For durations (unit ns, e.g. the longest sample
+interval of the isolation benchmarks) lower is better, so they are flagged if they are more than the tolerance above.
+The exit code is 1 if we found a regression.
+Examples:
+
+    benchmark_compare.py --port /dev/ttyACM0 --save baseline.json
+    benchmark_compare.py --port /dev/ttyACM0 --baseline baseline.json --tolerance 0.05
+    benchmark_compare.py results.csv --baseline baseline.json
+"""
+import argparse
+import json
+import sys
+import time
+
+FIELDS = ["label", "benchmark", "frequency", "pins", "samples", "repeats", "mean", "stddev", "min", "max", "unit"]
+KEY_FIELDS = ["label", "benchmark", "frequency", "pins", "samples"]
+END_MARKER = "benchmark-end"
+
+
+def parse_line(line):
+    """Returns the result of a CSV or JSON line or None if the line is not a result"""
+    line = line.strip()
+    if line.startswith("{"):
+        try:
+            result = json.loads(line)
+        except ValueError:
+            return None
+        return result if all(field in result for field in FIELDS) else None
+    values = line.split(",")
+    if len(values) != len(FIELDS) or values[0] == FIELDS[0]:
+        return None
+    result = dict(zip(FIELDS, values))
+    try:
+        for field in ["frequency", "pins", "samples", "repeats"]:
+            result[field] = int(result[field])
+        for field in ["mean", "stddev", "min", "max"]:
+            result[field] = float(result[field])
+    except ValueError:
+        return None
+    return result
+
+
+def key(result):
+    return "/".join(str(result[field]) for field in KEY_FIELDS)
+
+
+def is_lower_better(result):
+    return result["unit"] == "ns"
+
+
+def read_lines(args):
+    """Provides the lines from the serial port (until the end marker or the timeout), the files or stdin"""
+    if args.port:
+        import serial
+        connection = serial.Serial(args.port, args.baud, timeout=1)
+        end = time.time() + args.timeout
+        while time.time() < end:
+            line = connection.readline().decode("ascii", errors="ignore")
+            if line.strip() == END_MARKER:
+                break
+            if line:
+                if args.verbose:
+                    print(line.rstrip())
+                yield line
+        return
+    if not args.files:
+        yield from sys.stdin
+    for name in args.files:
+        with open(name) as file:
+            yield from file
+
+
+def compare(results, baseline, tolerance):
+    """Prints the comparison and returns the number of regressions"""
+    regressions = 0
+    print("%-50s %15s %15s %8s" % ("benchmark", "baseline", "actual", "change"))
+    for name, result in results.items():
+        base = baseline.get(name)
+        if base is None:
+            print("%-50s %15s %15.1f %8s" % (name, "-", result["mean"], "new"))
+            continue
+        change = (result["mean"] - base["mean"]) / base["mean"] if base["mean"] else 0.0
+        if is_lower_better(result):
+            is_regression = result["mean"] > base["mean"] * (1.0 + tolerance)
+        else:
+            is_regression = result["mean"] < base["mean"] * (1.0 - tolerance)
+        regressions += is_regression
+        print("%-50s %15.1f %15.1f %+7.1f%% %s" % (name, base["mean"], result["mean"], change * 100.0,
+                                                 "REGRESSION" if is_regression else ""))
+    for name in baseline:
+        if name not in results:
+            print("%-50s %15.1f %15s %8s" % (name, baseline[name]["mean"], "-", "missing"))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compares the benchmark results with a baseline")
+    parser.add_argument("files", nargs="*", help="files with the benchmark output (default: stdin)")
+    parser.add_argument("--port", help="serial port of the device")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--timeout", type=float, default=300.0, help="max seconds to wait for the end of the benchmark")
+    parser.add_argument("--baseline", help="json file with the baseline")
+    parser.add_argument("--save", help="stores the results as baseline")
+    parser.add_argument("--tolerance", type=float, default=0.05, help="allowed relative change of the mean")
+    parser.add_argument("--verbose", action="store_true", help="prints the received lines")
+    args = parser.parse_args()
+
+    results = {}
+    for line in read_lines(args):
+        result = parse_line(line)
+        if result is not None:
+            results[key(result)] = result
+    if not results:
+        print("no benchmark results found")
+        return 2
+
+    if args.save:
+        with open(args.save, "w") as file:
+            json.dump(results, file, indent=2)
+        print("saved %d results to %s" % (len(results), args.save))
+
+    if args.baseline:
+        with open(args.baseline) as file:
+            baseline = json.load(file)
+        regressions = compare(results, baseline, args.tolerance)
+        print("%d regressions" % regressions)
+        return 1 if regressions else 0
+
+    if not args.save:
+        for name, result in results.items():
+            print("%-50s %15.1f +/- %.1f %s" % (name, result["mean"], result["stddev"], result["unit"]))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+"""
+Measures the compression of the BlockCodec with recorded captures (sigrok sessions, stored snapshots or raw SUMP
+data) and compares it with the raw SUMP data and the RLE of the snapshots. The effective transfer rate is the number
+of samples per second which can be sent over a link with the indicated speed. All files are decoded again to verify
+that the compression is lossless. Examples:
+
+    block_codec_benchmark.py spi.sr i2c.sr uart.sr --baud 921600
+    block_codec_benchmark.py capture.bin --channels 16 --csv > results.csv
+"""
+import argparse
+import os
+import sys
+import time
+
+from decode_block_stream import read_capture, encode_stream, read_blocks, groups_of
+
+
+def rle_size(samples, bytes_per_sample):
+    """Size of the RLE of the snapshots: each value followed by the LEB128 number of repetitions"""
+    size = 0
+    last = None
+    count = 0
+    for value in samples + [None]:
+        if value == last:
+            count += 1
+            continue
+        if count > 0:
+            size += bytes_per_sample + max(1, (count.bit_length() + 6) // 7)
+        last = value
+        count = 1
+    return size
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("files", nargs="+", help="recorded captures")
+    parser.add_argument("--channels", type=int, default=8, help="number of channels of raw SUMP data")
+    parser.add_argument("--baud", type=int, default=921600, help="speed of the link with 10 bits per byte")
+    parser.add_argument("--csv", action="store_true", help="prints the results in the format of the benchmark harness")
+    args = parser.parse_args()
+    link_rate = args.baud / 10.0
+
+    if args.csv:
+        print("label,benchmark,frequency,pins,samples,repeats,mean,stddev,min,max,unit")
+    else:
+        print("%-24s %10s %10s %10s %10s %8s %8s %14s %14s" % ("capture", "samples", "raw", "rle", "block", "rle x",
+                                                              "block x", "raw samples/s", "block samples/s"))
+    errors = 0
+    for name in args.files:
+        samples, bytes_per_sample, frequency = read_capture(name, args.channels)
+        raw = len(samples) * bytes_per_sample
+        start = time.time()
+        encoded = encode_stream(samples, groups_of(bytes_per_sample))
+        seconds = time.time() - start
+        _, decoded, _, _ = read_blocks(encoded)
+        if decoded != samples:
+            print("%s: the decoded samples are different" % name)
+            errors += 1
+        rle = rle_size(samples, bytes_per_sample)
+        ratio = raw / len(encoded) if encoded else 0.0
+        raw_rate = link_rate / bytes_per_sample
+        label = os.path.basename(name)
+        if args.csv:
+            for benchmark, value, unit in (("block-ratio", ratio, "ratio"), ("block-rate", raw_rate * ratio, "samples/s"),
+                                           ("rle-ratio", raw / rle if rle else 0.0, "ratio")):
+                print("%s,%s,%d,%d,%d,1,%.2f,0.0,%.2f,%.2f,%s" % (label, benchmark, frequency, bytes_per_sample * 8,
+                                                                  len(samples), value, value, value, unit))
+        else:
+            print("%-24s %10d %10d %10d %10d %8.2f %8.2f %14.0f %14.0f" % (
+                label[:24], len(samples), raw, rle, len(encoded), raw / rle if rle else 0.0, ratio, raw_rate,
+                raw_rate * ratio))
+            print("%-24s python encoder: %.0f samples/s" % ("", len(samples) / seconds if seconds > 0 else 0))
+    return 1 if errors else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,387 @@
+#!/usr/bin/env python3
+"""
+Decodes the compressed captures of the BlockCodec and writes them as sigrok session (.sr), which can be opened with
+PulseView or sigrok-cli, or as raw SUMP data. The input is either captured from the device with the
+SUMP_COMPRESSED_DUMP command or read from a file with the compressed stream or a stored snapshot. Examples:
+
+    decode_block_stream.py --port /dev/ttyACM0 --baud 921600 --samples 65535 --frequency 1000000 --output capture.sr
+    decode_block_stream.py --tcp 192.168.1.44:5555 --samples 100000 --channels 16 --output capture.sr
+    decode_block_stream.py --input capture.sump --output capture.sr
+
+Each block consists of 0xCB, the enabled channel groups, the sample count (16 bit), the payload length (16 bit, all
+big endian) and the payload: the first sample followed by the bit stream of each channel. A block w/o samples marks
+the end of the stream.
+"""
+import argparse
+import struct
+import sys
+import time
+import zipfile
+
+from verify_test_pattern import (SerialConnection, TCPConnection, command, SUMP_RESET, SUMP_ARM, SUMP_DIVIDER,
+                                 SUMP_READ_DELAY_COUNT, SUMP_SET_FLAGS, SUMP_CLOCK)
+
+SUMP_COMPRESSED_DUMP = 0x38
+BLOCK_MAGIC = 0xCB
+HEADER_SIZE = 6
+BLOCK_SAMPLES = 1024
+PLANE_CONST, PLANE_RAW, PLANE_GAPS, PLANE_DELTAS = range(4)
+SNAPSHOT_RAW, SNAPSHOT_RLE, SNAPSHOT_BLOCK = range(3)
+
+
+def zigzag(value):
+    return -2 * value - 1 if value < 0 else 2 * value
+
+
+def unzigzag(value):
+    return -((value + 1) >> 1) if value & 1 else value >> 1
+
+
+class BitWriter:
+    def __init__(self):
+        self.bits = []
+
+    def write(self, value, bits):
+        self.bits.append(format(value, "0%db" % bits) if bits else "")
+
+    def write_rice(self, value, k):
+        self.bits.append("1" * (value >> k) + "0")
+        self.write(value & ((1 << k) - 1), k)
+
+    def write_gamma(self, value):
+        bits = value.bit_length()
+        self.write(0, bits - 1)
+        self.write(value, bits)
+
+    def to_bytes(self):
+        bits = "".join(self.bits)
+        bits += "0" * (-len(bits) % 8)
+        return int(bits, 2).to_bytes(len(bits) // 8, "big") if bits else b""
+
+
+class BitReader:
+    def __init__(self, data, pos=0):
+        self.bits = "".join(format(byte, "08b") for byte in data)
+        self.pos = pos
+
+    def read(self, bits):
+        if self.pos + bits > len(self.bits):
+            raise ValueError("block is truncated")
+        value = int(self.bits[self.pos:self.pos + bits], 2) if bits else 0
+        self.pos += bits
+        return value
+
+    def read_rice(self, k):
+        end = self.bits.find("0", self.pos)
+        if end < 0:
+            raise ValueError("block is truncated")
+        q = end - self.pos
+        self.pos = end + 1
+        return q << k | self.read(k)
+
+    def read_gamma(self):
+        end = self.bits.find("1", self.pos)
+        if end < 0:
+            raise ValueError("block is truncated")
+        zeros = end - self.pos
+        self.pos = end
+        return self.read(zeros + 1)
+
+
+def best_rice(values):
+    """Returns the bits and k of the Rice coding of the values: we test the k values near the log2 of the mean"""
+    n = len(values)
+    total = sum(values)
+    k0 = 0
+    while k0 < 15 and n << (k0 + 1) <= total:
+        k0 += 1
+    result = None
+    for k in range(max(k0 - 1, 0), min(k0 + 1, 15) + 1):
+        cost = n * (1 + k) + sum(v >> k for v in values)
+        if result is None or cost < result[0]:
+            result = (cost, k)
+    return result
+
+
+def encode_block(samples, groups):
+    """Encodes the samples (integers in the wire order of the enabled groups) like the BlockCodec on the device"""
+    groups = groups & 0x0F or 1
+    bytes_per_sample = bin(groups).count("1")
+    count = len(samples)
+    payload = b""
+    if count > 0:
+        payload = samples[0].to_bytes(bytes_per_sample, "little")
+        changes = [samples[j] ^ samples[j - 1] for j in range(1, count)]
+        changed = 0
+        for value in changes:
+            changed |= value
+        writer = BitWriter()
+        for plane in range(bytes_per_sample * 8):
+            if not (changed >> plane) & 1:
+                writer.write(PLANE_CONST, 2)
+                continue
+            bits = [(value >> plane) & 1 for value in changes]
+            gaps = []
+            last = 0
+            for j, bit in enumerate(bits, 1):
+                if bit:
+                    gaps.append(j - last - 1)
+                    last = j
+            deltas = [zigzag(gap - prev) for gap, prev in zip(gaps, [0] + gaps)]
+            cost_gaps, k_gaps = best_rice(gaps)
+            cost_deltas, k_deltas = best_rice(deltas)
+            cost_header = 4 + 2 * len(gaps).bit_length() - 1
+            if count - 1 <= cost_header + min(cost_gaps, cost_deltas):
+                writer.write(PLANE_RAW, 2)
+                writer.bits.append("".join("1" if bit else "0" for bit in bits))
+                continue
+            is_delta = cost_deltas < cost_gaps
+            k = k_deltas if is_delta else k_gaps
+            writer.write(PLANE_DELTAS if is_delta else PLANE_GAPS, 2)
+            writer.write(k, 4)
+            writer.write_gamma(len(gaps))
+            for value in deltas if is_delta else gaps:
+                writer.write_rice(value, k)
+        payload += writer.to_bytes()
+    return struct.pack(">BBHH", BLOCK_MAGIC, groups, count, len(payload)) + payload
+
+
+def decode_block(data):
+    """Decodes a block: returns the enabled groups and the samples as integers in the wire order"""
+    magic, groups, count, length = struct.unpack(">BBHH", data[:HEADER_SIZE])
+    if magic != BLOCK_MAGIC or groups == 0 or len(data) < HEADER_SIZE + length:
+        raise ValueError("invalid block")
+    if count == 0:
+        return groups, []
+    bytes_per_sample = bin(groups).count("1")
+    payload = data[HEADER_SIZE:HEADER_SIZE + length]
+    toggles = [0] * count
+    toggles[0] = int.from_bytes(payload[:bytes_per_sample], "little")
+    reader = BitReader(payload, bytes_per_sample * 8)
+    for plane in range(bytes_per_sample * 8):
+        mask = 1 << plane
+        mode = reader.read(2)
+        if mode == PLANE_RAW:
+            bits = reader.bits[reader.pos:reader.pos + count - 1]
+            reader.read(count - 1)
+            pos = bits.find("1")
+            while pos >= 0:
+                toggles[pos + 1] ^= mask
+                pos = bits.find("1", pos + 1)
+        elif mode in (PLANE_GAPS, PLANE_DELTAS):
+            k = reader.read(4)
+            n = reader.read_gamma()
+            last = prev = 0
+            for _ in range(n):
+                value = reader.read_rice(k)
+                if mode == PLANE_DELTAS:
+                    value = prev + unzigzag(value)
+                prev = value
+                last += value + 1
+                if last >= count:
+                    raise ValueError("invalid transition")
+                toggles[last] ^= mask
+    value = 0
+    for j in range(count):
+        value ^= toggles[j]
+        toggles[j] = value
+    return groups, toggles
+
+
+def read_blocks(data, pos=0):
+    """Decodes the blocks: returns the groups, the samples, the position after the stream and True if we found the
+    end marker"""
+    samples = []
+    groups = 1
+    while pos + HEADER_SIZE <= len(data):
+        length, = struct.unpack(">H", data[pos + 4:pos + HEADER_SIZE])
+        groups, values = decode_block(data[pos:pos + HEADER_SIZE + length])
+        pos += HEADER_SIZE + length
+        if not values:
+            return groups, samples, pos, True
+        samples += values
+    return groups, samples, pos, False
+
+
+def encode_stream(samples, groups, block_samples=BLOCK_SAMPLES):
+    """Compresses all samples into blocks followed by the end marker"""
+    result = bytearray()
+    for start in range(0, len(samples), block_samples):
+        result += encode_block(samples[start:start + block_samples], groups)
+    return bytes(result + encode_block([], groups))
+
+
+def groups_of(bytes_per_sample):
+    return (1 << bytes_per_sample) - 1
+
+
+def to_samples(data, bytes_per_sample):
+    """Converts the SUMP wire format into integers"""
+    return [int.from_bytes(data[j:j + bytes_per_sample], "little")
+            for j in range(0, len(data) - bytes_per_sample + 1, bytes_per_sample)]
+
+
+def to_bytes(samples, bytes_per_sample):
+    return b"".join(value.to_bytes(bytes_per_sample, "little") for value in samples)
+
+
+def read_snapshot(data):
+    """Reads a snapshot of the CaptureStorage: returns the samples, the bytes per sample and the frequency"""
+    version, encoding, bytes_per_sample, groups = data[4:8]
+    frequency, sample_count = struct.unpack(">II", data[8:16])
+    body = data[32:]
+    if encoding == SNAPSHOT_BLOCK:
+        _, samples, _, _ = read_blocks(body)
+    elif encoding == SNAPSHOT_RLE:
+        samples = []
+        pos = 0
+        while pos < len(body) and len(samples) < sample_count:
+            value = int.from_bytes(body[pos:pos + bytes_per_sample], "little")
+            pos += bytes_per_sample
+            count = shift = 0
+            while True:
+                byte = body[pos]
+                pos += 1
+                count |= (byte & 0x7F) << shift
+                shift += 7
+                if not byte & 0x80:
+                    break
+            samples += [value] * count
+    else:
+        samples = to_samples(body, bytes_per_sample)
+    return samples[:sample_count], bytes_per_sample, frequency
+
+
+def read_sigrok(name):
+    """Reads the logic data of a sigrok session: returns the samples, the bytes per sample and the frequency"""
+    with zipfile.ZipFile(name) as archive:
+        metadata = archive.read("metadata").decode()
+        values = dict(line.split("=", 1) for line in metadata.splitlines() if "=" in line)
+        bytes_per_sample = int(values.get("unitsize", "1"))
+        frequency = parse_rate(values.get("samplerate", "0"))
+        capture_file = values.get("capturefile", "logic-1")
+        chunks = sorted((name for name in archive.namelist() if name.startswith(capture_file)),
+                        key=lambda name: int(name.rsplit("-", 1)[1]) if name != capture_file else 0)
+        data = b"".join(archive.read(chunk) for chunk in chunks)
+    return to_samples(data, bytes_per_sample), bytes_per_sample, frequency
+
+
+def parse_rate(text):
+    units = {"hz": 1, "khz": 1000, "mhz": 1000000, "ghz": 1000000000}
+    parts = text.strip().split()
+    if len(parts) == 2 and parts[1].lower() in units:
+        return int(float(parts[0]) * units[parts[1].lower()])
+    return int(float(parts[0])) if parts else 0
+
+
+def format_rate(frequency):
+    for unit, factor in (("GHz", 1000000000), ("MHz", 1000000), ("kHz", 1000)):
+        if frequency >= factor and frequency % factor == 0:
+            return "%d %s" % (frequency // factor, unit)
+    return "%d Hz" % frequency
+
+
+def write_sigrok(name, samples, bytes_per_sample, frequency, chunk_size=4 * 1024 * 1024):
+    """Writes the samples as sigrok session (version 2)"""
+    channels = bytes_per_sample * 8
+    metadata = ["[global]", "sigrok version=0.5.2", "", "[device 1]", "capturefile=logic-1",
+                "total probes=%d" % channels, "samplerate=%s" % format_rate(frequency), "total analog=0"]
+    metadata += ["probe%d=D%d" % (j + 1, j) for j in range(channels)]
+    metadata += ["unitsize=%d" % bytes_per_sample, ""]
+    data = to_bytes(samples, bytes_per_sample)
+    with zipfile.ZipFile(name, "w", zipfile.ZIP_DEFLATED) as archive:
+        archive.writestr("version", "2")
+        archive.writestr("metadata", "\n".join(metadata))
+        for j, start in enumerate(range(0, max(len(data), 1), chunk_size), 1):
+            archive.writestr("logic-1-%d" % j, data[start:start + chunk_size])
+
+
+def read_capture(name, channels=8):
+    """Reads a recorded capture: sigrok session, snapshot, compressed stream or raw SUMP data"""
+    with open(name, "rb") as file:
+        data = file.read()
+    if data[:2] == b"PK":
+        return read_sigrok(name)
+    if data[:4] == b"LASN":
+        return read_snapshot(data)
+    if data[:1] == bytes([BLOCK_MAGIC]):
+        groups, samples, _, _ = read_blocks(data)
+        return samples, bin(groups).count("1"), 0
+    bytes_per_sample = (channels + 7) // 8
+    return to_samples(data, bytes_per_sample), bytes_per_sample, 0
+
+
+def capture(connection, args):
+    """Requests a compressed dump and receives the blocks until the end marker"""
+    groups = (args.channels + 7) // 8
+    for _ in range(5):
+        command(connection, SUMP_RESET)
+    time.sleep(0.1)
+    count = args.samples // 4 - 1
+    command(connection, SUMP_READ_DELAY_COUNT, count | count << 16)
+    command(connection, SUMP_DIVIDER, SUMP_CLOCK // args.frequency - 1)
+    disabled = (0x0F << groups) & 0x0F
+    command(connection, SUMP_SET_FLAGS, disabled << 2)
+    command(connection, SUMP_COMPRESSED_DUMP)
+    command(connection, SUMP_ARM)
+    data = bytearray()
+    start = time.time()
+    last = start
+    while time.time() - last < args.timeout:
+        received = connection.receive(4096)
+        if received:
+            data += received
+            last = time.time()
+            try:
+                if read_blocks(data)[3]:
+                    break
+            except (ValueError, IndexError, struct.error):
+                pass
+    return bytes(data), time.time() - start
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", help="serial port")
+    parser.add_argument("--baud", type=int, default=921600)
+    parser.add_argument("--tcp", help="host:port of a TCPServerTransport")
+    parser.add_argument("--input", help="file with the compressed stream or a stored snapshot")
+    parser.add_argument("--samples", type=int, default=10000)
+    parser.add_argument("--channels", type=int, default=8)
+    parser.add_argument("--frequency", type=int, default=1000000)
+    parser.add_argument("--timeout", type=float, default=3.0, help="max idle time in seconds")
+    parser.add_argument("--output", help="sigrok session (.sr)")
+    parser.add_argument("--raw", help="file for the decoded SUMP data")
+    args = parser.parse_args()
+
+    if args.input:
+        samples, bytes_per_sample, frequency = read_capture(args.input, args.channels)
+        frequency = frequency or args.frequency
+    else:
+        if args.tcp:
+            connection = TCPConnection(args.tcp)
+        elif args.port:
+            connection = SerialConnection(args.port, args.baud)
+        else:
+            parser.error("--port, --tcp or --input is required")
+        data, seconds = capture(connection, args)
+        groups, samples, _, is_complete = read_blocks(data)
+        bytes_per_sample = bin(groups).count("1")
+        frequency = args.frequency
+        print("received: %d bytes in %.3f s for %d samples (ratio %.2f)" % (
+            len(data), seconds, len(samples), len(samples) * bytes_per_sample / len(data) if data else 0))
+        if not is_complete:
+            print("incomplete stream: the end marker is missing")
+            return 1
+
+    print("samples: %d / channels: %d / frequency: %d" % (len(samples), bytes_per_sample * 8, frequency))
+    if args.output:
+        write_sigrok(args.output, samples, bytes_per_sample, frequency)
+    if args.raw:
+        with open(args.raw, "wb") as file:
+            file.write(to_bytes(samples, bytes_per_sample))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
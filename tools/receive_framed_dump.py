@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+"""
+Captures with the framed dump: the SUMP data is received in frames with a sequence number and a CRC32 and the
+corrupted or missing frames are requested again (NAK) from the buffer of the device, which is released with an ACK
+at the end. Each frame consists of 0xF5, the sequence number (16 bit), the payload length (16 bit), the payload and
+the CRC32 of the preceding bytes (all big endian). The end frame has no payload and its sequence number is the
+number of blocks. Examples:
+
+    receive_framed_dump.py --port /dev/ttyACM0 --baud 3000000 --samples 65535 --output capture.bin
+    receive_framed_dump.py --tcp 192.168.1.44:5555 --samples 100000 --channels 16 --verify counter
+"""
+import argparse
+import struct
+import sys
+import time
+import zlib
+
+from verify_test_pattern import (SerialConnection, TCPConnection, command, verify_counter, verify_prbs,
+                                 verify_walking_ones, SUMP_RESET, SUMP_ARM, SUMP_DIVIDER, SUMP_READ_DELAY_COUNT,
+                                 SUMP_SET_FLAGS, SUMP_CLOCK, FLAG_TEST_MODE)
+
+SUMP_FRAMED_DUMP = 0x36
+SUMP_FRAMED_ACK = 0x37
+SUMP_FRAMED_NAK = 0xA0
+FRAMED_MAGIC = 0xF5
+HEADER_SIZE = 5
+CRC_SIZE = 4
+END_OF_DUMP = 0xFFFF
+
+
+class FrameReceiver:
+    """Collects the valid frames: corrupted data is skipped until the next valid frame"""
+
+    def __init__(self):
+        self.data = bytearray()
+        self.blocks = {}
+        self.block_count = None
+        self.crc_errors = 0
+
+    def add(self, received):
+        self.data += received
+        while len(self.data) >= HEADER_SIZE + CRC_SIZE:
+            if self.data[0] != FRAMED_MAGIC:
+                self.resync()
+                continue
+            seq, length = struct.unpack(">HH", self.data[1:HEADER_SIZE])
+            size = HEADER_SIZE + length + CRC_SIZE
+            if len(self.data) < size:
+                return
+            crc, = struct.unpack(">I", self.data[size - CRC_SIZE:size])
+            if crc != zlib.crc32(bytes(self.data[:size - CRC_SIZE])):
+                self.crc_errors += 1
+                self.resync()
+                continue
+            if length == 0:
+                self.block_count = seq
+            else:
+                self.blocks[seq] = bytes(self.data[HEADER_SIZE:size - CRC_SIZE])
+            del self.data[:size]
+
+    def drain(self):
+        """The link is idle: an incomplete frame can only be the result of a corrupted length"""
+        while self.data:
+            self.resync()
+            self.add(b"")
+
+    def resync(self):
+        next_magic = self.data.find(bytes([FRAMED_MAGIC]), 1)
+        del self.data[:next_magic if next_magic > 0 else len(self.data)]
+
+    def missing(self):
+        if self.block_count is None:
+            return None
+        return [seq for seq in range(self.block_count) if seq not in self.blocks]
+
+    def result(self):
+        return b"".join(self.blocks[seq] for seq in range(self.block_count))
+
+
+def receive(connection, receiver, timeout):
+    """Receives until the link is idle for the timeout or all frames are available"""
+    last = time.time()
+    while time.time() - last < timeout:
+        received = connection.receive(4096)
+        if received:
+            receiver.add(received)
+            last = time.time()
+        if receiver.missing() == []:
+            return
+    receiver.drain()
+
+
+def capture(connection, args):
+    groups = (args.channels + 7) // 8
+    for _ in range(5):
+        command(connection, SUMP_RESET)
+    time.sleep(0.1)
+    count = args.samples // 4 - 1
+    command(connection, SUMP_READ_DELAY_COUNT, count | count << 16)
+    command(connection, SUMP_DIVIDER, SUMP_CLOCK // args.frequency - 1)
+    disabled = (0x0F << groups) & 0x0F
+    flags = disabled << 2 | (FLAG_TEST_MODE if args.verify else 0)
+    command(connection, SUMP_SET_FLAGS, flags)
+    command(connection, SUMP_FRAMED_DUMP)
+    command(connection, SUMP_ARM)
+
+    receiver = FrameReceiver()
+    start = time.time()
+    receive(connection, receiver, args.timeout)
+    naks = 0
+    for _ in range(args.retries):
+        missing = receiver.missing()
+        if missing == []:
+            break
+        # without the end frame we don't know the number of blocks
+        for seq in missing if missing is not None else [END_OF_DUMP]:
+            command(connection, SUMP_FRAMED_NAK, seq)
+            naks += 1
+        receive(connection, receiver, args.timeout)
+    seconds = time.time() - start
+    if receiver.missing() == []:
+        command(connection, SUMP_FRAMED_ACK)
+    return receiver, naks, seconds, groups
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", help="serial port")
+    parser.add_argument("--baud", type=int, default=921600)
+    parser.add_argument("--tcp", help="host:port of a TCPServerTransport")
+    parser.add_argument("--samples", type=int, default=10000)
+    parser.add_argument("--channels", type=int, default=8)
+    parser.add_argument("--frequency", type=int, default=1000000)
+    parser.add_argument("--timeout", type=float, default=1.0, help="idle time in seconds after which we request the missing frames")
+    parser.add_argument("--retries", type=int, default=10, help="max number of NAK rounds")
+    parser.add_argument("--output", help="file for the received SUMP data")
+    parser.add_argument("--verify", choices=["counter", "walking-ones", "prbs"], help="verifies the test pattern")
+    args = parser.parse_args()
+
+    if args.tcp:
+        connection = TCPConnection(args.tcp)
+    elif args.port:
+        connection = SerialConnection(args.port, args.baud)
+    else:
+        parser.error("--port or --tcp is required")
+
+    receiver, naks, seconds, groups = capture(connection, args)
+    missing = receiver.missing()
+    print("blocks: %s / crc errors: %d / naks: %d" % (receiver.block_count, receiver.crc_errors, naks))
+    if missing != []:
+        print("incomplete dump: %s blocks missing" % ("all" if missing is None else len(missing)))
+        return 1
+
+    data = receiver.result()
+    print("bytes: %d in %.3f s = %.0f bytes/s" % (len(data), seconds, len(data) / seconds if seconds > 0 else 0))
+    if args.output:
+        with open(args.output, "wb") as file:
+            file.write(data)
+    if args.verify:
+        samples = [int.from_bytes(data[j:j + groups], "little") for j in range(0, len(data) - groups + 1, groups)]
+        if args.verify == "counter":
+            errors = verify_counter(samples, groups * 8)
+        elif args.verify == "walking-ones":
+            errors = verify_walking_ones(samples, groups * 8)
+        else:
+            errors = verify_prbs(data)
+        print("errors: %d" % errors)
+        return 1 if errors else 0
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
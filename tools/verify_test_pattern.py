@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+"""
+Captures the internal test pattern of the logic analyzer with the SUMP protocol and verifies the received data.
+
+The pattern is selected on the device with logicAnalyzer.setTestPattern() or (counter) with the SUMP test mode flag
+which is always sent by this script. Examples:
+
+    verify_test_pattern.py --port /dev/ttyACM0 --pattern counter
+    verify_test_pattern.py --tcp 192.168.1.44:5555 --pattern prbs --samples 100000 --channels 16
+"""
+import argparse
+import socket
+import struct
+import sys
+import time
+
+SUMP_RESET = 0x00
+SUMP_ARM = 0x01
+SUMP_DIVIDER = 0x80
+SUMP_READ_DELAY_COUNT = 0x81
+SUMP_SET_FLAGS = 0x82
+SUMP_CLOCK = 100000000
+FLAG_TEST_MODE = 1 << 11
+
+
+class SerialConnection:
+    def __init__(self, port, baud):
+        import serial
+        self.serial = serial.Serial(port, baud, timeout=1)
+
+    def send(self, data):
+        self.serial.write(data)
+
+    def receive(self, size):
+        return self.serial.read(size)
+
+
+class TCPConnection:
+    def __init__(self, address):
+        host, port = address.rsplit(":", 1)
+        self.socket = socket.create_connection((host, int(port)))
+        self.socket.settimeout(1)
+
+    def send(self, data):
+        self.socket.sendall(data)
+
+    def receive(self, size):
+        try:
+            return self.socket.recv(size)
+        except socket.timeout:
+            return b""
+
+
+def command(connection, cmd, value=None):
+    data = bytes([cmd])
+    if value is not None:
+        data += struct.pack("<I", value)
+    connection.send(data)
+
+
+def capture(connection, samples, channels, frequency, timeout):
+    groups = (channels + 7) // 8
+    for _ in range(5):
+        command(connection, SUMP_RESET)
+    time.sleep(0.1)
+    count = samples // 4 - 1
+    command(connection, SUMP_READ_DELAY_COUNT, count | count << 16)
+    command(connection, SUMP_DIVIDER, SUMP_CLOCK // frequency - 1)
+    # bits 2-5 disable the channel groups
+    disabled = (0x0F << groups) & 0x0F
+    command(connection, SUMP_SET_FLAGS, disabled << 2 | FLAG_TEST_MODE)
+    command(connection, SUMP_ARM)
+    expected = samples * groups
+    data = bytearray()
+    start = time.time()
+    last = start
+    while len(data) < expected and time.time() - last < timeout:
+        received = connection.receive(expected - len(data))
+        if received:
+            data += received
+            last = time.time()
+    return bytes(data), time.time() - start, groups
+
+
+def verify_counter(samples, bits):
+    mask = (1 << bits) - 1
+    return sum(1 for j in range(1, len(samples)) if samples[j] != (samples[j - 1] + 1) & mask)
+
+
+def verify_walking_ones(samples, bits):
+    mask = (1 << bits) - 1
+    rotate = lambda v: ((v << 1) | (v >> (bits - 1))) & mask
+    return sum(1 for j in range(1, len(samples)) if samples[j] != rotate(samples[j - 1]))
+
+
+def verify_prbs(data):
+    # the data is the PRBS-15 bit stream (MSB first): b[n] = b[n-15] ^ b[n-14]
+    bits = [(byte >> bit) & 1 for byte in data for bit in range(7, -1, -1)]
+    return sum(1 for n in range(15, len(bits)) if bits[n] != bits[n - 15] ^ bits[n - 14])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", help="serial port")
+    parser.add_argument("--baud", type=int, default=921600)
+    parser.add_argument("--tcp", help="host:port of a TCPServerTransport")
+    parser.add_argument("--pattern", choices=["counter", "walking-ones", "prbs"], default="counter")
+    parser.add_argument("--samples", type=int, default=10000)
+    parser.add_argument("--channels", type=int, default=8)
+    parser.add_argument("--frequency", type=int, default=1000000)
+    parser.add_argument("--timeout", type=float, default=5.0)
+    args = parser.parse_args()
+
+    if args.tcp:
+        connection = TCPConnection(args.tcp)
+    elif args.port:
+        connection = SerialConnection(args.port, args.baud)
+    else:
+        parser.error("--port or --tcp is required")
+
+    data, seconds, groups = capture(connection, args.samples, args.channels, args.frequency, args.timeout)
+    samples = [int.from_bytes(data[j:j + groups], "little") for j in range(0, len(data) - groups + 1, groups)]
+    if args.pattern == "counter":
+        errors = verify_counter(samples, groups * 8)
+    elif args.pattern == "walking-ones":
+        errors = verify_walking_ones(samples, groups * 8)
+    else:
+        errors = verify_prbs(data)
+
+    print("samples: %d of %d" % (len(samples), args.samples))
+    print("bytes: %d in %.3f s = %.0f bytes/s" % (len(data), seconds, len(data) / seconds if seconds > 0 else 0))
+    print("errors: %d" % errors)
+    return 0 if errors == 0 and len(samples) == args.samples else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())